@@ -6,6 +6,8 @@
  *
  * MIT licence.
  *
+ * Oct. '26 The DS parameter and vendor IE header are built at compile time (wifi_ie.h).
+ *
  * 21/01/xx Modified so that it will transmit operator ID or serial number.
  *          Floats changed to doubles.
  *          Calculation of m/deg moved to common support library.
@@ -65,7 +67,7 @@ ID_France::ID_France() {
   UAS_operator = (char *) dummy;
   UAV_id       = (char *) dummy;
 
-  wifi_channel = 6; // Do not change.
+  wifi_channel = ID_FRANCE_CHANNEL;
 
   memset(wifi_mac_addr,0,6);
   memset(ssid,0,sizeof(ssid));
@@ -106,7 +108,6 @@ void ID_France::init(const char *op,const char *uav) {
   char           text[128];
   double         lat_d, long_d;
   int8_t         max_power = 0;
-  const uint32_t wifi_oui = ID_FRANCE_OUI;
   wifi_config_t  wifi_config;
 
 
@@ -154,9 +155,8 @@ void ID_France::init(const char *op,const char *uav) {
   header->interval[1]       = 0x0b;
   header->capability[0]     = 0x21;
   header->capability[1]     = 0x04;
-  header->ds_parameter[0]   = 0x03;
-  header->ds_parameter[1]   = 0x01;
-  header->ds_parameter[2]   = wifi_channel;
+
+  fid_ds::copy(header->ds_parameter,0);
 
   String address = WiFi.macAddress();
 
@@ -195,13 +195,7 @@ void ID_France::init(const char *op,const char *uav) {
   frame_length = offset + sizeof(struct fid_payload);
   payload      = (struct fid_payload *) &wifi_frame[offset]; 
 
-  payload->preamble[0] = 0xdd;
-  payload->preamble[1] = sizeof(struct fid_payload) - 2; // ?
-
-  payload->preamble[2] = (wifi_oui >> 16) & 0xff;
-  payload->preamble[3] = (wifi_oui >>  8) & 0xff;
-  payload->preamble[4] =  wifi_oui        & 0xff;
-  payload->preamble[5] = 0x01; // Vendor specific type.
+  fid_vendor_head::copy(payload->preamble,0);
 
   payload->T1      = 0x01;
   payload->L1      = sizeof(payload->version);
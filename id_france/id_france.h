@@ -16,6 +16,7 @@
 #define ID_FRANCE_OUI 0x6a5c35
 
 #include "utm.h"
+#include "wifi_ie.h"
 
 struct __attribute__((__packed__)) fid_header {
 
@@ -63,6 +64,14 @@ struct __attribute__((__packed__)) fid_payload {
   uint8_t heading[2];
 };
 
+#define ID_FRANCE_CHANNEL 6 // Do not change.
+
+typedef WiFi_IE_DS<ID_FRANCE_CHANNEL> fid_ds;
+typedef WiFi_IE_vendor_head<sizeof(struct fid_payload) - 2,ID_FRANCE_OUI,0x01> fid_vendor_head;
+
+static_assert(fid_ds::size == sizeof(((struct fid_header *) 0)->ds_parameter),"fid_header DS parameter");
+static_assert(fid_vendor_head::size == sizeof(((struct fid_payload *) 0)->preamble),"fid_payload preamble");
+
 //
 
 class ID_France {
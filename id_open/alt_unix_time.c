@@ -1,10 +1,20 @@
 /* -*- tab-width: 2; mode: c; -*-
- * 
- * Seconds since 1/1/1970 for systems that don't have the unix time() function. 
- * 
- * The Julian day algorithm is from Jean Meeus's Astronomical Algorithms
- * as are the two test dates.
- * 
+ *
+ * Seconds since 1/1/1970 for systems that don't have the unix time() function.
+ *
+ * Oct. '26: Integer days from civil (alt_unix_time.h) replaces the floating
+ *           point Julian day. The Julian day algorithm, from Jean Meeus's
+ *           Astronomical Algorithms as are the two test dates, is kept for
+ *           the host test.
+ *
+ * Host test
+ *
+ *   cc -O2 -o alt_unix_time alt_unix_time.c -lm && ./alt_unix_time [-x]
+ *
+ * Checks alt_unix_secs() against timegm() for every day from 1970 to 2106,
+ * at the second boundaries at the start and end of each hour, and times it
+ * against the Julian day version. -x checks every second (takes a while).
+ *
  */
 
 #if defined(ARDUINO)
@@ -13,18 +23,20 @@
 
 #else
 
+#define _DEFAULT_SOURCE // timegm()
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <math.h>
 
 #endif
 
-#include <math.h>
+#include "alt_unix_time.h"
 
 uint64_t      alt_unix_secs(int,int,int,int,int,int);
-static double julian_day(int,int,float,int);
-
 
 /*
  *
@@ -32,19 +44,30 @@ static double julian_day(int,int,float,int);
 
 #ifndef ARDUINO
 
+static double   julian_day(int,int,float,int);
+static uint64_t julian_unix_secs(int,int,int,int,int,int);
+static int      check(time_t);
+static double   nsecs(void);
+
 int main(int argc,char *argv[]) {
 
-  uint64_t   alt_secs;
-  time_t     unix_secs;
+  int        i, all = 0, errors = 0, hour, sec;
+  double     t0, t1, t2;
+  uint64_t   alt_secs, sum1 = 0, sum2 = 0;
+  time_t     unix_secs, day;
   struct tm *gmt;
-  
+  const int  loops = 1000000;
+  const time_t end = (time_t) 0xffffffffLL; // 2106-02-07 06:28:15
+
+  all = ((argc > 1)&&(!strcmp(argv[1],"-x"))) ? 1: 0;
+
   time(&unix_secs);
 
   gmt = gmtime(&unix_secs);
-  
+
   alt_secs = alt_unix_secs(1900 + gmt->tm_year,1 + gmt->tm_mon,gmt->tm_mday,
                            gmt->tm_hour,gmt->tm_min,gmt->tm_sec);
-  
+
   printf("\nunix: %10lu\n",(unsigned long int) unix_secs);
   printf(  "alt:  %10lu\n",(unsigned long int) alt_secs);
   printf(  "      %10d\n",(int) ((int64_t) unix_secs - (int64_t) alt_secs));
@@ -52,9 +75,91 @@ int main(int argc,char *argv[]) {
   printf("\nJD 27/1/333: %10.2f\n",julian_day(333,1,27.5,0));
   printf(  "JD Sputnik:  %10.2f\n",julian_day(1957,10,4.81,1));
 
+  printf(  "JD Sputnik:  %10.2f (integer)\n",
+         (double) alt_days_from_civil(1957,10,4) + 2440587.5 + 0.81);
+
+  // Against timegm().
+
+  if (all) {
+
+    for (unix_secs = 0; unix_secs <= end; ++unix_secs) {
+
+      errors += check(unix_secs);
+    }
+
+  } else {
+
+    for (day = 0; day <= end; day += 86400) {
+
+      for (hour = 0; hour < 24; ++hour) {
+
+        for (sec = 0; sec < 2; ++sec) {
+
+          if ((unix_secs = day + (hour * 3600) + (sec * 3599)) <= end) {
+
+            errors += check(unix_secs);
+          }
+        }
+      }
+    }
+  }
+
+  printf("\n%s: %d errors\n",(all) ? "every second": "every hour",errors);
+
+  // Against the Julian day version.
+
+  t0 = nsecs();
+
+  for (i = 0; i < loops; ++i) {
+
+    sum1 += alt_unix_secs(1970 + (i % 136),1 + (i % 12),1 + (i % 28),i % 24,i % 60,i % 60);
+  }
+
+  t1 = nsecs();
+
+  for (i = 0; i < loops; ++i) {
+
+    sum2 += julian_unix_secs(1970 + (i % 136),1 + (i % 12),1 + (i % 28),i % 24,i % 60,i % 60);
+  }
+
+  t2 = nsecs();
+
+  printf("\nalt_unix_secs() %6.1f ns, Julian day %6.1f ns%s\n\n",
+         (t1 - t0) / (double) loops,(t2 - t1) / (double) loops,
+         (sum1 == sum2) ? "": ", results differ");
+
+  return (errors) ? 1: 0;
+}
+
+//
+
+int check(time_t unix_secs) {
+
+  struct tm *gmt;
+
+  gmt = gmtime(&unix_secs);
+
+  if (alt_unix_secs(1900 + gmt->tm_year,1 + gmt->tm_mon,gmt->tm_mday,
+                    gmt->tm_hour,gmt->tm_min,gmt->tm_sec) != (uint64_t) timegm(gmt)) {
+
+    printf("%lu\n",(unsigned long int) unix_secs);
+    return 1;
+  }
+
   return 0;
 }
 
+//
+
+double nsecs() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((double) ts.tv_sec * 1e9) + (double) ts.tv_nsec;
+}
+
 #endif
 
 /*
@@ -64,6 +169,18 @@ int main(int argc,char *argv[]) {
 uint64_t alt_unix_secs(int year,int month,int mday,
                        int hour,int minute,int second) {
 
+  return (uint64_t) alt_secs_from_civil(year,month,mday,hour,minute,second);
+}
+
+/*
+ * The original, floating point, version.
+ */
+
+#ifndef ARDUINO
+
+uint64_t julian_unix_secs(int year,int month,int mday,
+                          int hour,int minute,int second) {
+
   uint64_t        secs = 0;
   static uint64_t jd_1970 = 0;
 
@@ -71,7 +188,7 @@ uint64_t alt_unix_secs(int year,int month,int mday,
 
     jd_1970 = (uint64_t) julian_day(1970,1,1,1) * (uint64_t) 86400;
   }
-  
+
   secs  = (uint64_t) julian_day(year,month,mday,1) * (uint64_t) 86400;
   secs += (uint64_t) (((uint32_t) hour   * 3600) +
                       ((uint32_t) minute *   60) +
@@ -81,10 +198,7 @@ uint64_t alt_unix_secs(int year,int month,int mday,
   return secs;
 }
 
-
-/*
- *
- */
+//
 
 double julian_day(int year,int month,float mday,int gregorian) {
 
@@ -105,15 +219,16 @@ double julian_day(int year,int month,float mday,int gregorian) {
   y = (double) (year  + 4716);
   m = (double) (month + 1);
   d = (double) mday;
-  
+
   jday = floor(365.25  * y) +
          floor(30.6001 * m) +
          d + b - 1524.5;
-  
+
   return jday;
 }
-  
+
+#endif
+
 /*
  *
  */
-
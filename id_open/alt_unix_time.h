@@ -0,0 +1,66 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Days since 1/1/1970 from a Gregorian date, in integer arithmetic.
+ *
+ * Howard Hinnant's days_from_civil() algorithm. The year is counted from
+ * March so that the leap day is at the end, and split into 400 year eras.
+ * Good for any date that fits in an int32_t of days.
+ *
+ * Each function is a single expression so that, in C++, they are constexpr
+ * (C++11) and fixed dates can be checked by the compiler.
+ *
+ */
+
+#ifndef ALT_UNIX_TIME_H
+#define ALT_UNIX_TIME_H
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+#define ALT_CONSTEXPR constexpr
+#else
+#define ALT_CONSTEXPR static inline
+#endif
+
+// Day of the year, from the 1st of March.
+
+ALT_CONSTEXPR int32_t alt_day_of_year(int month,int mday) {
+
+  return ((153 * (month + ((month > 2) ? -3: 9)) + 2) / 5) + mday - 1;
+}
+
+ALT_CONSTEXPR int32_t alt_era(int32_t year) {
+
+  return ((year >= 0) ? year: year - 399) / 400;
+}
+
+ALT_CONSTEXPR int32_t alt_day_of_era(int32_t year_of_era,int32_t day_of_year) {
+
+  return (year_of_era * 365) + (year_of_era / 4) - (year_of_era / 100) + day_of_year;
+}
+
+// year starting in March.
+
+ALT_CONSTEXPR int32_t alt_days_from_march(int32_t year,int month,int mday) {
+
+  return (alt_era(year) * 146097) +
+         alt_day_of_era(year - (alt_era(year) * 400),alt_day_of_year(month,mday)) - 719468;
+}
+
+ALT_CONSTEXPR int32_t alt_days_from_civil(int year,int month,int mday) {
+
+  return alt_days_from_march(year - ((month <= 2) ? 1: 0),month,mday);
+}
+
+ALT_CONSTEXPR int64_t alt_secs_from_civil(int year,int month,int mday,
+                                          int hour,int minute,int second) {
+
+  return ((int64_t) alt_days_from_civil(year,month,mday) * 86400) +
+         (hour * 3600) + (minute * 60) + second;
+}
+
+#endif
+
+/*
+ *
+ */
@@ -0,0 +1,59 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Just enough of the Arduino API to build id_open on a Linux host.
+ * The clock can be replaced so that a programme can run in simulated time.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ */
+
+#ifndef ID_OPEN_HOST_ARDUINO_H
+#define ID_OPEN_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define PROGMEM
+#define memcpy_P memcpy
+
+uint32_t millis(void);
+uint32_t micros(void);
+void     delay(uint32_t);
+
+// Returns usecs. NULL restores the default, CLOCK_MONOTONIC.
+
+void     host_set_clock(uint64_t (*)(void));
+uint64_t host_usecs(void);
+
+char    *dtostrf(double,signed char,unsigned char,char *);
+
+//
+
+class Stream {
+
+public:
+                 Stream(FILE * = stdout);
+  virtual size_t write(const uint8_t *,size_t);
+  size_t         print(const char *);
+  size_t         print(int);
+  void           begin(unsigned long);
+
+private:
+
+  FILE          *file;
+};
+
+extern Stream Serial;
+
+#endif
+
+/*
+ *
+ */
@@ -0,0 +1,669 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Benchmark for ID_OpenDrone::transmit() on a Linux host.
+ *
+ * The library runs in simulated time, transmit() being called every loop_ms
+ * as it would be from an Arduino loop(). The wall clock time of each call
+ * is measured, as are the CPU cycles of the calls that sent a WiFi frame
+ * and the bytes of the beacon frame that were written for each frame.
+ * With ID_OD_ASYNC_TX, the frames are sent (recorded) by the radio thread.
+ * In engine mode (-e), transmit() is called by the engine thread and the
+ * calls timed are to the update_*() functions, made at the GNSS rate.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * Usage: bench_transmit [-s sim_secs] [-l loop_ms] [-w wifi.pcap] [-b ble.pcap] [-n]
+ *                       [-g stall_ms] [-c] [-r] [-v] [-t kbps] [-e] [-p policy] [-u legacy,coded]
+ *                       [-a wifi,ble] [-x nan,beacon,ble,ext] [-q frames]
+ *
+ * -g  Stop calling transmit() for stall_ms every 5 seconds, e.g. a long GNSS parse.
+ * -c  Use the catch up scheduler policy rather than skip.
+ * -r  Report the achieved BLE scheduler intervals against their targets and
+ *     the Location and System encodes performed and skipped and the beacon
+ *     pack rebuilds and message copies and the TX queue's depth, drops and
+ *     enqueue cycles and the BLE controller calls, advertising off time and
+ *     airtime for each PHY and the library's own airtime for each transport
+ *     and the rate plan's achieved intervals and the time a call with the
+ *     null backend, which sends nothing, and the stack that its calls use
+ *     and the outcomes of the frames handed to the backend.
+ * -v  Hover rather than wander around.
+ * -t  WiFi rate in kbit/s for the airtime that frame buffers are held, 0 releases them at once.
+ * -e  Engine mode, start() and update_location()/update_time() every GNSS_MS.
+ * -p  BLE interleaving preset, 0 legacy, 1 alternate, 2 location legacy and the rest coded.
+ * -u  BLE budgets, adverts per second on the legacy and coded PHYs (0 for no limit).
+ * -a  Airtime budgets, 1/1000ths of each second for WiFi and BLE (0 for no limit).
+ * -x  Rate plan, the NAN, beacon, legacy and extended BLE periods in ms (0 for off).
+ * -q  WiFi frames that the driver will take at once, more are dropped.
+ *
+ * See README.md for building.
+ *
+ */
+
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include <Arduino.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "id_open.h"
+#include "id_open_host.h"
+
+#define GNSS_MS     200
+#define STACK_PAINT 8192
+
+static ID_OpenDrone          squitter;
+static ID_OpenDrone_T<ID_OD_Null> null_squitter;
+static UTM_Utilities         utm_utils;
+
+static struct UTM_parameters utm_parameters;
+static struct UTM_data       utm_data;
+
+static volatile uint64_t     sim_usecs = 0; // Read by the radio thread.
+
+static uint64_t sim_clock(void);
+static uint64_t wall_nsecs(void);
+static void     fly(double,double,double,double);
+static uint64_t null_nsecs(int,int,double,double,struct UTM_data *,uint32_t * = NULL);
+static void     stack_paint(void);
+static uint32_t stack_depth(void);
+
+/*
+ *
+ */
+
+int main(int argc,char *argv[]) {
+
+  int           c, i, header = 1, loop_ms = 10, sim_secs = 60, stall_ms = 0, report = 0;
+  int           hover = 0, engine = 0, budget[ID_OD_PHYS] = {0,0};
+  int           air_budget[ID_OD_AIRS] = {0,0}, plan_ms[ID_OD_TRANSPORTS] = {-1,-1,-1,-1};
+  char          config[64], name[16];
+  struct UTM_data start_data;
+  double        m_deg_lat = 0.0, m_deg_long = 0.0;
+  uint32_t      calls = 0, wifi_queued = 0, beacons = 0, stack[2] = {0,0};
+  uint64_t      t0, t1, c0, c1, beacon_cycles = 0, nsecs, total_nsecs = 0, max_nsecs = 0, end_usecs, stall_usecs = 0;
+  const char   *wifi_file = NULL, *ble_file = NULL;
+  const struct host_tx_stats *stats;
+  struct ID_OD_schedule_stats sched;
+  struct ID_OD_encode_stats   encodes;
+  struct ID_OD_beacon_stats   beacon, nan;
+  struct ID_OD_pack_stats     packs;
+  struct ID_OD_tx_stats       tx;
+  struct ID_OD_engine_stats   engine_stats;
+  struct ID_OD_ble_phy_stats  phy_stats;
+  struct ID_OD_airtime_stats  air;
+  struct ID_OD_rate_plan      plan;
+  struct ID_OD_transport_stats transport;
+  static const char          *slot_names[ID_OD_SLOT_AUTH] = {"location","system","basic id 0","basic id 1",
+                                                             "self id","operator id"};
+  static const char          *transport_names[ID_OD_TRANSPORTS] = {"nan","beacon","ble","ble ext"};
+
+  while ((c = getopt(argc,argv,"s:l:w:b:ng:crvt:ep:u:a:x:q:")) != -1) {
+
+    switch (c) {
+
+    case 's': sim_secs  = atoi(optarg); break;
+    case 'l': loop_ms   = atoi(optarg); break;
+    case 'w': wifi_file = optarg;       break;
+    case 'b': ble_file  = optarg;       break;
+    case 'n': header    = 0;            break;
+    case 'g': stall_ms  = atoi(optarg); break;
+    case 'c': squitter.set_schedule_policy(ID_OD_SCHED_CATCH_UP); break;
+    case 'r': report    = 1;            break;
+    case 'v': hover     = 1;            break;
+    case 't': host_set_tx_rate(atoi(optarg)); break;
+    case 'e': engine    = 1;            break;
+    case 'p': squitter.set_ble_policy(atoi(optarg)); break;
+    case 'u': sscanf(optarg,"%d,%d",&budget[ID_OD_PHY_LEGACY],&budget[ID_OD_PHY_CODED]); break;
+    case 'a': sscanf(optarg,"%d,%d",&air_budget[ID_OD_AIR_WIFI],&air_budget[ID_OD_AIR_BLE]); break;
+    case 'x': sscanf(optarg,"%d,%d,%d,%d",&plan_ms[0],&plan_ms[1],&plan_ms[2],&plan_ms[3]); break;
+    case 'q': host_set_tx_depth(atoi(optarg)); break;
+
+    default:
+
+      fprintf(stderr,"usage: %s [-s sim_secs] [-l loop_ms] [-w wifi.pcap] [-b ble.pcap] [-n] [-g stall_ms] [-c] [-r] [-v] [-t kbps] [-e] [-p policy] [-u legacy,coded] [-a wifi,ble] [-x nan,beacon,ble,ext] [-q frames]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  if ((loop_ms < 1)||(sim_secs < 1)) {
+
+    return 1;
+  }
+
+  host_set_clock(sim_clock);
+
+  if ((wifi_file)||(ble_file)) {
+
+    host_pcap_open(wifi_file,ble_file);
+  }
+
+  //
+
+  memset(&utm_parameters,0,sizeof(utm_parameters));
+
+  strcpy(utm_parameters.UAS_operator,"GBR-OP-HOST");
+  strcpy(utm_parameters.UAV_id,"HOST1234567890");
+
+  utm_parameters.ID_type     = 1;
+  utm_parameters.region      = 1;
+  utm_parameters.EU_category = 1;
+  utm_parameters.EU_class    = 5;
+
+  squitter.init(&utm_parameters);
+
+  for (i = 0; i < ID_OD_PHYS; ++i) {
+
+    squitter.set_ble_budget(i,budget[i]);
+  }
+
+  for (i = 0; i < ID_OD_AIRS; ++i) {
+
+    squitter.set_airtime_budget(i,air_budget[i]);
+  }
+
+  squitter.get_rate_plan(&plan);
+
+  for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+    if (plan_ms[i] >= 0) {
+
+      plan.period_ms[i] = plan_ms[i];
+    }
+  }
+
+  if (squitter.set_rate_plan(&plan) != 0) {
+
+    fprintf(stderr,"%s: the rate plan has a transport that isn't in this build\n",argv[0]);
+  }
+
+  squitter.set_auth((char *) "Host benchmark authentication data, three pages.");
+
+  memset(&utm_data,0,sizeof(utm_data));
+
+  //  52°46'49.89"N 0°42'26.26"W, Buckminster.
+
+  utm_data.base_latitude  = 52.0 + (46.0 / 60.0) + (49.89 / 3600.0);
+  utm_data.base_longitude =  0.0 - (42.0 / 60.0) - (26.26 / 3600.0);
+  utm_data.base_alt_m     = 137.0;
+  utm_data.base_valid     = 1;
+  utm_data.satellites     = 8;
+  utm_data.speed_kn       = (hover) ? 0: 40;
+  utm_data.years          = 2026;
+  utm_data.months         = 10;
+  utm_data.days           = 17;
+  utm_data.hours          = 10;
+
+  utm_utils.calc_m_per_deg(utm_data.base_latitude,&m_deg_lat,&m_deg_long);
+
+  srand(1);
+  host_reset_stats();
+
+  end_usecs  = (uint64_t) sim_secs * 1000000ULL;
+  start_data = utm_data;
+
+  if (engine) {
+
+    squitter.update_operator_location(utm_data.base_latitude,utm_data.base_longitude,utm_data.base_alt_m);
+    squitter.update_time(utm_data.years,utm_data.months,utm_data.days,
+                         utm_data.hours,utm_data.minutes,utm_data.seconds,utm_data.csecs);
+
+    if (squitter.start() != 0) {
+
+      fprintf(stderr,"%s: engine mode isn't available in this build\n",argv[0]);
+      return 1;
+    }
+  }
+
+  for (sim_usecs = 0; sim_usecs < end_usecs; sim_usecs += (uint64_t) loop_ms * 1000) {
+
+    fly((double) sim_usecs * 1e-6,(double) loop_ms * 1e-3,m_deg_lat,m_deg_long);
+
+    if ((stall_ms)&&((sim_usecs % 5000000ULL) < ((uint64_t) loop_ms * 1000))) {
+
+      stall_usecs = sim_usecs + ((uint64_t) stall_ms * 1000);
+    }
+
+    if (sim_usecs < stall_usecs) {
+
+      continue;
+    }
+
+    if (engine) {
+
+      if ((sim_usecs % (GNSS_MS * 1000)) < ((uint64_t) loop_ms * 1000)) {
+
+        t0 = wall_nsecs();
+        squitter.update_location(utm_data.latitude_d,utm_data.longitude_d,utm_data.alt_msl_m,utm_data.alt_agl_m,
+                                 utm_data.speed_kn,utm_data.heading,utm_data.satellites);
+        squitter.update_time(utm_data.years,utm_data.months,utm_data.days,
+                             utm_data.hours,utm_data.minutes,utm_data.seconds,utm_data.csecs);
+        t1 = wall_nsecs();
+
+        nsecs        = t1 - t0;
+        total_nsecs += nsecs;
+
+        if (nsecs > max_nsecs) {
+
+          max_nsecs = nsecs;
+        }
+
+        ++calls;
+      }
+
+      sched_yield(); // Let the engine thread see the new time.
+      continue;
+    }
+
+#if !ID_OD_ASYNC_TX
+    host_tx_poll();
+#endif
+
+    squitter.get_tx_stats(&tx);
+    wifi_queued = tx.wifi;
+
+    t0 = wall_nsecs();
+    c0 = host_cycles();
+    squitter.transmit(&utm_data);
+    c1 = host_cycles();
+    t1 = wall_nsecs();
+
+    squitter.get_tx_stats(&tx);
+
+    if (tx.wifi != wifi_queued) {
+
+      beacon_cycles += c1 - c0;
+      ++beacons;
+    }
+
+    nsecs        = t1 - t0;
+    total_nsecs += nsecs;
+
+    if (nsecs > max_nsecs) {
+
+      max_nsecs = nsecs;
+    }
+
+    ++calls;
+
+#if ID_OD_ASYNC_TX
+    sched_yield(); // Simulated time runs faster than the radio thread, give it a chance.
+#endif
+  }
+
+  if (engine) {
+
+    usleep(20000); // Let a tick in progress finish.
+  }
+
+  squitter.flush_tx();
+  host_pcap_close();
+
+  //
+
+  stats = host_stats();
+
+  squitter.get_beacon_stats(&beacon);
+  squitter.get_nan_stats(&nan);
+  squitter.get_tx_stats(&tx);
+  squitter.get_engine_stats(&engine_stats);
+
+  sprintf(config,"%s%s%s%s%s%s%s%s%s%s",
+          (ID_OD_WIFI_BEACON && !USE_BEACON_FUNC) ? "BEACON ": "",
+          (ID_OD_WIFI_BEACON &&  USE_BEACON_FUNC) ? "BEACON_FUNC ": "",
+          (ID_OD_WIFI_NAN) ? "NAN ": "",
+          (ID_OD_BT)       ? "BT ": "",
+          (ID_OD_BT && ID_OD_BLE_PACK) ? "PACK ": "",
+          (ID_OD_CACHED_PACK) ? "": "UNCACHED ",
+          (ID_OD_WIFI_BURST > 1) ? "BURST ": "",
+          (ID_OD_WIFI_STATIC_MS) ? "": "ALL ",
+          (ID_OD_ASYNC_TX) ? "": "SYNC ",
+          (engine) ? "ENGINE ": "");
+
+  if (header) {
+
+    printf("%-20s %8s %8s %8s %10s %9s %8s %7s %8s %9s %8s\n",
+           "config","calls","ns/call","max ns","cyc/beacon","wifi fr/s","B/frame","B/s","B writ.","ble fr/s","B/frame");
+  }
+
+  printf("%-20s %8u %8u %8u %10u %9.2f %8u %7.0f %8.1f %9.2f %8u\n",
+         config,calls,(unsigned int) (total_nsecs / calls),(unsigned int) max_nsecs,
+         (unsigned int) ((beacons) ? beacon_cycles / beacons: 0),
+         (double) stats->wifi_frames / (double) sim_secs,
+         (unsigned int) ((stats->wifi_frames) ? stats->wifi_bytes / stats->wifi_frames: 0),
+         (double) stats->wifi_bytes / (double) sim_secs,
+         (beacon.frames + nan.frames) ?
+         (double) (beacon.bytes_written + nan.bytes_written) / (double) (beacon.frames + nan.frames): 0.0,
+         (double) stats->ble_frames / (double) sim_secs,
+         (unsigned int) ((stats->ble_frames) ? stats->ble_bytes / stats->ble_frames: 0));
+
+  if (report) {
+
+    printf("\n%-12s %6s %9s %6s %6s %7s\n","slot","target","achieved","sent","late","skipped");
+
+    for (i = 0; i < ID_OD_SLOTS; ++i) {
+
+      squitter.get_schedule_stats(i,&sched);
+
+      if (sched.sent) {
+
+        if (i < ID_OD_SLOT_AUTH) {
+
+          strcpy(name,slot_names[i]);
+
+        } else {
+
+          sprintf(name,"auth %d",i - ID_OD_SLOT_AUTH);
+        }
+
+        printf("%-12s %6u %9.1f %6u %6u %7u\n",
+               name,sched.target_ms,sched.achieved_ms,sched.sent,sched.late,sched.skipped);
+      }
+    }
+
+    squitter.get_encode_stats(&encodes);
+
+    printf("\n%-12s %8s %8s %8s\n","message","encoded","patched","skipped");
+    printf("%-12s %8u %8u %8u\n","location",
+           encodes.location_encodes,encodes.location_patches,encodes.location_skipped);
+    printf("%-12s %8u %8u %8u\n\n","system",
+           encodes.system_encodes,encodes.system_patches,encodes.system_skipped);
+
+    if (beacon.frames) {
+
+      printf("%-12s %8s %8s %8s %8s\n","beacon","frames","rebuilds","locn cp","sys cp");
+      printf("%-12s %8u %8u %8u %8u\n\n","",
+             beacon.frames,beacon.rebuilds,beacon.location_copies,beacon.system_copies);
+    }
+
+    if (nan.frames) {
+
+      printf("%-12s %8s %8s %8s %8s\n","nan","frames","rebuilds","locn cp","sys cp");
+      printf("%-12s %8u %8u %8u %8u\n\n","",
+             nan.frames,nan.rebuilds,nan.location_copies,nan.system_copies);
+    }
+
+    if (stats->ble_frames) {
+
+      printf("%-12s %8s %8s\n","ble adv","calls/s","off ms/s");
+      printf("%-12s %8.2f %8.2f\n\n","",
+             (double) stats->ble_calls / (double) sim_secs,
+             (double) stats->ble_off_usecs * 1e-3 / (double) sim_secs);
+
+      squitter.get_ble_phy_stats(&phy_stats);
+
+      printf("%-12s %8s %8s %8s %8s %8s\n","ble phy","legacy","coded","div. l","div. c","dropped");
+      printf("%-12s %8u %8u %8u %8u %8u\n\n","",
+             phy_stats.sent[ID_OD_PHY_LEGACY],phy_stats.sent[ID_OD_PHY_CODED],
+             phy_stats.diverted[ID_OD_PHY_LEGACY],phy_stats.diverted[ID_OD_PHY_CODED],phy_stats.dropped);
+
+      printf("%-12s %8s %8s %8s %8s\n","ble airtime","adv/s","1M ms/s","2M ms/s","S8 ms/s");
+      printf("%-12s %8.2f %8.2f %8s %8s\n","legacy",
+             (double) (stats->ble_frames - stats->ble_ext_frames) / (double) sim_secs,
+             (double) stats->ble_legacy_usecs * 1e-3 / (double) sim_secs,"-","-");
+      printf("%-12s %8.2f %8.2f %8.2f %8.2f\n\n","extended",
+             (double) stats->ble_ext_frames / (double) sim_secs,
+             (double) stats->ble_ext_usecs[HOST_PHY_1M]    * 1e-3 / (double) sim_secs,
+             (double) stats->ble_ext_usecs[HOST_PHY_2M]    * 1e-3 / (double) sim_secs,
+             (double) stats->ble_ext_usecs[HOST_PHY_CODED] * 1e-3 / (double) sim_secs);
+    }
+
+    if (stats->wifi_frames) {
+
+      printf("%-12s %8s %8s %8s %8s\n","wifi ring","max tx","busy","reclaim","stale");
+      printf("%-12s %8u %8u %8u %8u\n\n","",
+             stats->wifi_in_flight_max,beacon.busy,beacon.reclaimed,beacon.stale);
+
+      printf("%-12s %8s %8s %8s %8s %8s %8s %8s\n","wifi packs","statics","rotation","fr/s","st/frame","max ms","late","deferred");
+
+      for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+        squitter.get_pack_stats(i,&packs);
+
+        if (packs.frames) {
+
+          printf("%-12s %8u %8u %8.2f %8.2f %8u %8u %8u\n",transport_names[i],
+                 packs.statics,packs.rotation,(double) packs.frames / (double) sim_secs,
+                 (double) packs.messages / (double) packs.frames,packs.static_max_ms,packs.late,packs.deferred);
+        }
+      }
+
+      printf("\n");
+    }
+
+    printf("%-12s %8s %8s %8s %8s %8s %8s\n","airtime","budget","frames","ms/s","last ms","max ms","stretch");
+
+    for (i = 0; i < ID_OD_AIRS; ++i) {
+
+      squitter.get_airtime_stats(i,&air);
+
+      if (air.frames) {
+
+        printf("%-12s %8u %8u %8.2f %8.2f %8.2f %8u\n",(i == ID_OD_AIR_WIFI) ? "wifi": "ble",
+               air.budget,air.frames,(double) air.total_usecs * 1e-3 / (double) sim_secs,
+               air.ms_per_sec,air.max_ms_per_sec,air.stretched);
+      }
+    }
+
+    printf("\n");
+
+    printf("%-12s %8s %8s %8s %8s\n","transport","plan ms","ms","sent","held");
+
+    for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+      squitter.get_transport_stats(i,&transport);
+
+      if (transport.built) {
+
+        printf("%-12s %8u %8.1f %8u %8u\n",transport_names[i],
+               transport.period_ms,transport.achieved_ms,transport.sent,transport.held);
+      }
+    }
+
+    printf("\n");
+
+    printf("%-12s %8s %8s %8s %8s %8s\n","tx queue","frames","max dep.","dropped","enq. cyc","max cyc");
+    printf("%-12s %8u %8u %8u %8u %8u\n\n","",
+           tx.wifi + tx.ble,tx.depth_max,tx.dropped,
+           (unsigned int) ((tx.wifi + tx.ble) ? tx.enqueue_total / (tx.wifi + tx.ble): 0),tx.enqueue_max);
+
+    if (tx.wifi + tx.ble) {
+
+      printf("%-12s %8s %8s %8s %8s\n","tx outcome","sent","dropped","failed","ble fail");
+      printf("%-12s %8u %8u %8u %8u\n\n","",
+             tx.wifi_sent,tx.wifi_dropped,tx.wifi_failed,tx.ble_failed);
+    }
+
+    if (engine_stats.ticks) {
+
+      printf("%-12s %8s %8s %8s %8s %8s\n","engine","ticks","updates","retries","late us","max us");
+      printf("%-12s %8u %8u %8u %8u %8u\n\n","",
+             engine_stats.ticks,engine_stats.updates,engine_stats.retries,
+             (unsigned int) (engine_stats.late_total_us / engine_stats.ticks),engine_stats.late_max_us);
+    }
+
+    if (!engine) {
+
+      printf("%-12s %8s %8s\n","backend","host ns","null ns");
+      printf("%-12s %8u %8u\n\n","",(unsigned int) (total_nsecs / calls),
+             (unsigned int) null_nsecs(sim_secs,loop_ms,m_deg_lat,m_deg_long,&start_data));
+
+      null_nsecs(sim_secs,loop_ms,m_deg_lat,m_deg_long,&start_data,stack);
+
+      printf("%-12s %8s %8s\n","stack","wifi B","max B");
+      printf("%-12s %8u %8u\n\n","",stack[0],stack[1]);
+    }
+  }
+
+  // Every static message sent at least every ID_OD_WIFI_STATIC_MS, unless
+  // transmit() was stalled.
+
+  for (i = 0; (i < ID_OD_TRANSPORTS)&&(!stall_ms); ++i) {
+
+    squitter.get_pack_stats(i,&packs);
+
+    if (packs.late) {
+
+      fprintf(stderr,"%s: %s- %s statics late %u times, %u ms at most\n",
+              argv[0],config,transport_names[i],packs.late,packs.static_max_ms);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * A wander around the field, as random_flight does.
+ */
+
+void fly(double t,double dt,double m_deg_lat,double m_deg_long) {
+
+  double        rads, speed_m;
+  static double x = 0.0, y = 0.0, z = 100.0;
+
+  if (utm_data.speed_kn) {
+
+    utm_data.heading   = (utm_data.heading + (rand() % 11) - 5 + 360) % 360;
+  }
+
+  speed_m              = 0.514444 * (double) utm_data.speed_kn * dt;
+  rads                 = (4.0 * atan(1.0) / 180.0) * (double) utm_data.heading;
+
+  x                   += speed_m * sin(rads);
+  y                   += speed_m * cos(rads);
+
+  utm_data.latitude_d  = utm_data.base_latitude  + (y / m_deg_lat);
+  utm_data.longitude_d = utm_data.base_longitude + (x / m_deg_long);
+  utm_data.alt_agl_m   = z;
+  utm_data.alt_msl_m   = utm_data.base_alt_m + z;
+
+  utm_data.minutes     = ((int) t / 60) % 60;
+  utm_data.seconds     =  (int) t % 60;
+  utm_data.csecs       = ((int) (t * 100.0)) % 100;
+
+  return;
+}
+
+/*
+ * The same flight with the null backend, for the time taken by the library
+ * on its own. Returns ns a call. With stack, the calls aren't timed, the
+ * deepest stack of the calls that queued WiFi frames and of all of them is
+ * measured instead.
+ */
+
+uint64_t null_nsecs(int sim_secs,int loop_ms,double m_deg_lat,double m_deg_long,struct UTM_data *start,
+                    uint32_t *stack) {
+
+  uint32_t calls = 0, depth, wifi;
+  uint64_t t0, total_nsecs = 0, end_usecs;
+  struct ID_OD_tx_stats tx;
+
+  utm_data  = *start;
+  end_usecs = (uint64_t) sim_secs * 1000000ULL;
+
+  sim_usecs = 0;
+  null_squitter.init(&utm_parameters);
+  null_squitter.set_auth((char *) "Host benchmark authentication data, three pages.");
+
+  srand(1);
+
+  for (sim_usecs = 0; sim_usecs < end_usecs; sim_usecs += (uint64_t) loop_ms * 1000) {
+
+    fly((double) sim_usecs * 1e-6,(double) loop_ms * 1e-3,m_deg_lat,m_deg_long);
+
+    if (stack) {
+
+      null_squitter.get_tx_stats(&tx);
+      wifi = tx.wifi;
+
+      stack_paint();
+      null_squitter.transmit(&utm_data);
+      depth = stack_depth();
+
+      null_squitter.get_tx_stats(&tx);
+
+      if ((tx.wifi != wifi)&&(depth > stack[0])) {
+
+        stack[0] = depth;
+      }
+
+      if (depth > stack[1]) {
+
+        stack[1] = depth;
+      }
+
+      continue;
+    }
+
+    t0 = wall_nsecs();
+    null_squitter.transmit(&utm_data);
+    total_nsecs += wall_nsecs() - t0;
+
+    ++calls;
+  }
+
+  return (calls) ? total_nsecs / calls: 0;
+}
+
+/*
+ * Stack high water mark. The area below the caller's frame is painted and,
+ * after the call being measured, the deepest byte that it wrote is found.
+ * Both have to be called from the function that makes the call, so that
+ * their frames are where its is. Approximate, to a few words.
+ */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+void __attribute__((noinline)) stack_paint(void) {
+
+  volatile uint8_t area[STACK_PAINT];
+
+  for (int i = 0; i < STACK_PAINT; ++i) {
+
+    area[i] = 0xa5;
+  }
+
+  return;
+}
+
+uint32_t __attribute__((noinline)) stack_depth(void) {
+
+  int              i;
+  volatile uint8_t area[STACK_PAINT];
+
+  for (i = 0; (i < STACK_PAINT)&&(area[i] == 0xa5); ++i) {
+    ;
+  }
+
+  return STACK_PAINT - i;
+}
+
+#pragma GCC diagnostic pop
+
+//
+
+uint64_t sim_clock() {
+
+  return sim_usecs;
+}
+
+//
+
+uint64_t wall_nsecs() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ *
+ */
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Builds and runs bench_transmit for each transport configuration.
+#
+# Needs opendroneid.c, opendroneid.h, odid_wifi.h and wifi.c in the id_open
+# directory (as for the Arduino build) or in $ODID_DIR.
+#
+# Usage: host/run_bench.sh [bench_transmit options]
+#
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+ODID_DIR=${ODID_DIR:-.}
+OUT=${OUT:-/tmp/id_open_host}
+CC=${CC:-cc}
+CXX=${CXX:-c++}
+CFLAGS=${CFLAGS:--O2}
+
+mkdir -p "$OUT"
+
+ODID_OBJS=""
+
+for f in opendroneid.c wifi.c; do
+  if [ -f "$ODID_DIR/$f" ]; then
+    $CC $CFLAGS -I"$ODID_DIR" -c "$ODID_DIR/$f" -o "$OUT/${f%.c}.o"
+    ODID_OBJS="$ODID_OBJS $OUT/${f%.c}.o"
+  fi
+done
+
+HEADER=""
+
+for config in "-DID_OD_WIFI_BEACON=1" \
+              "-DID_OD_WIFI_BEACON=1 -DID_OD_CACHED_PACK=0" \
+              "-DID_OD_WIFI_BEACON=1 -DID_OD_WIFI_BURST=2 -DID_OD_WIFI_STATIC_MS=0" \
+              "-DID_OD_WIFI_BEACON=1 -DID_OD_ASYNC_TX=0" \
+              "-DID_OD_WIFI_BEACON=0 -DID_OD_WIFI_NAN=1" \
+              "-DID_OD_WIFI_BEACON=0 -DID_OD_BT=1" \
+              "-DID_OD_WIFI_BEACON=0 -DID_OD_BT=1 -DID_OD_BLE_PACK=1" \
+              "-DID_OD_WIFI_NAN=1 -DID_OD_BT=1 -DID_OD_BLE_PACK=1" \
+              "-DID_OD_WIFI_BEACON=1 -DUSE_BEACON_FUNC=1"; do
+
+  $CXX $CFLAGS -std=gnu++11 $config -Ihost -I. -I../utm -I"$ODID_DIR" \
+       host/bench_transmit.cpp id_open.cpp id_open_beacon.cpp id_open_host.cpp ../utm/utm.cpp \
+       $ODID_OBJS -lpthread -o "$OUT/bench_transmit"
+
+  "$OUT/bench_transmit" $HEADER "$@"
+
+  HEADER="-n"
+done
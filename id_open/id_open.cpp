@@ -4,6 +4,27 @@
  *
  * Copyright (c) 2020-2022, Steve Jack.
  *
+ * Oct. '26:    Builds on a Linux host with the recording backend (id_open_host.cpp).
+ *              Table driven BLE scheduler with deadlines replaces the 40 phase switch.
+ *              Location and System messages are only re-encoded when their data changes.
+ *              WiFi message packs are assembled from the messages encoded for BLE.
+ *              The beacon frame is a template, only the volatile bytes are patched.
+ *              WiFi frames are built in a ring of buffers released by the backend.
+ *              Queued frame buffers are never reclaimed, late releases are ignored by generation.
+ *              Frames are queued for a radio task on the ESP32 (thread on the host).
+ *              Engine mode, start() and the update_*() functions.
+ *              UTC clock disciplined by the GNSS replaces alt_unix_secs() on every call.
+ *              Integer days from civil for the clock's date.
+ *              A BLE advert buffer per slot, only the counter is written for most adverts.
+ *              BT5 extended adverts carrying a message pack (ID_OD_BLE_PACK).
+ *              BT4/BT5 interleaving policy, ratios and budgets, moved from the nRF52 file.
+ *              Airtime of every frame and per transport duty cycle budgets.
+ *              ID_OpenDrone_T<Backend>, the processor specific functions are a template parameter.
+ *              Transports are picked at run time from a rate plan by one scheduler.
+ *              NAN frames are templates built in init(), patched as the beacon is.
+ *              WiFi packs rotate the static messages, as few as meet their refresh rate.
+ *              TX outcomes from the backends, statics deferred while the radio is busy.
+ *
  * Jan. '23:    Function to set the self ID.
  *
  * Nov. '22:    Moved the processor specific code to a separate file.
@@ -43,21 +64,30 @@
 
 #include <Arduino.h>
 
+#include <stddef.h>
 #include <time.h>
 #include <sys/time.h>
 
 extern "C" {
+#if defined(ARDUINO)
   int      clock_gettime(clockid_t,struct timespec *);
-  uint64_t alt_unix_secs(int,int,int,int,int,int);
+#endif
 }
 
 #include "id_open.h"
 
+#if !defined(ARDUINO)
+#include "id_open_host.h"
+#endif
+
+static inline uint32_t tx_cycles(void);
+
 /*
  *
  */
 
-ID_OpenDrone::ID_OpenDrone() {
+template <class Backend>
+ID_OpenDrone_T<Backend>::ID_OpenDrone_T() {
 
   int                i;
   static const char *dummy = "";
@@ -77,30 +107,75 @@ ID_OpenDrone::ID_OpenDrone() {
   
 #if ID_OD_WIFI_BEACON
 
-  // If ODID_PACK_MAX_MESSAGES == 10, then the potential size of the beacon message is > 255.
-  
-#if ODID_PACK_MAX_MESSAGES > 9
-#undef ODID_PACK_MAX_MESSAGES
-#define ODID_PACK_MAX_MESSAGES 9
-#endif
-  
-  memset(beacon_frame,0,BEACON_FRAME_SIZE);
-
 #if !USE_BEACON_FUNC
 
-  beacon_counter   =
-  beacon_length    =
-  beacon_timestamp =
-  beacon_seq       =
-  beacon_payload   = beacon_frame;
+  memset(beacon_frame,0,BEACON_TEMPLATE_SIZE);
+  memset(&beacon_patch,0,sizeof(beacon_patch));
+
+#endif
 
 #endif
 
+  memset(frame_ring,0,sizeof(frame_ring));
+
+  memset(wifi_packer,0,sizeof(wifi_packer));
+
+#if ID_OD_WIFI_NAN
+  memset(&nan_patch,0,sizeof(nan_patch));
+  memset(&nan_stats,0,sizeof(nan_stats));
 #endif
 
 #endif
 
   memset(msg_counter,0,sizeof(msg_counter));
+  memset(&encode_stats,0,sizeof(encode_stats));
+  memset(&beacon_stats,0,sizeof(beacon_stats));
+  memset(&tx_stats,0,sizeof(tx_stats));
+  memset(air,0,sizeof(air));
+  memset(&engine_data,0,sizeof(engine_data));
+  memset(&engine_snapshot,0,sizeof(engine_snapshot));
+  memset(&engine_stats,0,sizeof(engine_stats));
+
+#if ID_OD_BT
+  memset(&ble_phy_stats,0,sizeof(ble_phy_stats));
+  memset(ble_phy_acc,0,sizeof(ble_phy_acc));
+  memset(ble_tokens,0,sizeof(ble_tokens));
+  memset(&ble_policy,0,sizeof(ble_policy));
+
+  set_ble_policy((ID_OD_BLE_CODED) ? ID_OD_BLE_ALTERNATE: ID_OD_BLE_LEGACY);
+#endif
+
+#if ID_OD_BT && ID_OD_BLE_ADV_CACHE
+  memset(ble_adv,0,sizeof(ble_adv));
+  memset(ble_adv_gen,0xff,sizeof(ble_adv_gen)); // Not a generation yet.
+#endif
+
+  // The default rate plan is what the compile time options used to give.
+
+  memset(transport,0,sizeof(transport));
+
+  transport[ID_OD_TRANSPORT_BEACON].built  = ID_OD_WIFI_BEACON;
+  transport[ID_OD_TRANSPORT_NAN].built     = ID_OD_WIFI_NAN;
+  transport[ID_OD_TRANSPORT_BLE].built     = ID_OD_BT;
+  transport[ID_OD_TRANSPORT_BLE_EXT].built = ID_OD_BT && ID_OD_BLE_PACK;
+
+  transport[ID_OD_TRANSPORT_BLE].air       =
+  transport[ID_OD_TRANSPORT_BLE_EXT].air   = ID_OD_AIR_BLE;
+
+#if ID_OD_WIFI
+  transport[ID_OD_TRANSPORT_BEACON].period_ms  = (ID_OD_WIFI_BEACON) ? beacon_interval: 0;
+  transport[ID_OD_TRANSPORT_NAN].period_ms     = (ID_OD_WIFI_NAN)    ? beacon_interval: 0;
+#endif
+  transport[ID_OD_TRANSPORT_BLE].period_ms     = (ID_OD_BT && !ID_OD_BLE_PACK) ? ID_OD_BLE_SLOT_MS: 0;
+  transport[ID_OD_TRANSPORT_BLE_EXT].period_ms = (ID_OD_BT &&  ID_OD_BLE_PACK) ? ID_OD_BLE_EXT_MS:  0;
+
+#if ID_OD_ASYNC_TX
+  tx_head.store(0);
+  tx_tail.store(0);
+#endif
+#if ID_OD_ENGINE
+  engine_seq.store(0);
+#endif
   
   //
   // Below '// 0' indicates where we are setting 0 to 0 for clarity.
@@ -155,9 +230,11 @@ ID_OpenDrone::ID_OpenDrone() {
 
   operatorID_data->OperatorIdType   = ODID_OPERATOR_ID;
 
+  init_schedule(0);
+
   //
 
-  construct2();
+  Backend::construct();
   
   return;
 }
@@ -166,7 +243,8 @@ ID_OpenDrone::ID_OpenDrone() {
  *
  */
 
-void ID_OpenDrone::init(UTM_parameters *parameters) {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::init(UTM_parameters *parameters) {
 
   int  status, i;
   char text[128];
@@ -237,12 +315,24 @@ void ID_OpenDrone::init(UTM_parameters *parameters) {
 
   encodeBasicIDMessage(&basicID_enc[0],&UAS_data.BasicID[0]);
   encodeBasicIDMessage(&basicID_enc[1],&UAS_data.BasicID[1]);
-  encodeLocationMessage(&location_enc,location_data);
-  encodeAuthMessage(&auth_enc,auth_data[0]);
+  location_status = encodeLocationMessage(&location_enc,location_data);
+
+  for (i = 0; i < ODID_AUTH_MAX_PAGES; ++i) {
+
+    encodeAuthMessage(&auth_enc[i],auth_data[i]);
+  }
+
   encodeSelfIDMessage(&selfID_enc,selfID_data);
   encodeSystemMessage(&system_enc,system_data);
   encodeOperatorIDMessage(&operatorID_enc,operatorID_data);
 
+  location_dirty =
+  system_dirty   = 0;
+
+  ++static_gen;
+  ++location_gen;
+  ++system_gen;
+
   //
 
   if (UAS_operator[0]) {
@@ -252,7 +342,25 @@ void ID_OpenDrone::init(UTM_parameters *parameters) {
 
   ssid_length = strlen(ssid);
 
-  init2(ssid,ssid_length,WiFi_mac_addr,wifi_channel);
+  Backend::init(ssid,ssid_length,WiFi_mac_addr,wifi_channel);
+
+#if ID_OD_WIFI
+
+  // Management frames go at the lowest basic rate.
+
+  constexpr uint8_t lowest = wifi_lowest_basic_rate<typename Backend::rates>();
+
+  air_wifi_rate = (lowest != 0x7f) ? lowest: 2;
+#endif
+
+#if ID_OD_ASYNC_TX
+  if (!tx_async) {
+
+    tx_async = (Backend::start_tx_task(tx_task,this) == 0) ? 1: 0;
+  }
+#endif
+
+  init_schedule(msecs64());
 
 #if ID_OD_WIFI
 
@@ -261,28 +369,30 @@ void ID_OpenDrone::init(UTM_parameters *parameters) {
   init_beacon();
 
   // payload
-  beacon_payload      = &beacon_frame[beacon_offset];
-  beacon_offset      += 7;
-
-  *beacon_payload++   = 0xdd;
-  beacon_length       = beacon_payload++;
+  beacon_frame[beacon_offset++] = 0xdd;
+  beacon_patch.length           = beacon_offset++;
 
-  *beacon_payload++   = 0xfa;
-  *beacon_payload++   = 0x0b;
-  *beacon_payload++   = 0xbc;
+  beacon_frame[beacon_offset++] = 0xfa;
+  beacon_frame[beacon_offset++] = 0x0b;
+  beacon_frame[beacon_offset++] = 0xbc;
 
-  *beacon_payload++   = 0x0d;
-  beacon_counter      = beacon_payload++;
+  beacon_frame[beacon_offset++] = 0x0d;
+  beacon_patch.counter          = beacon_offset++;
+  beacon_patch.payload          = beacon_offset;
 
   beacon_max_packed   = BEACON_FRAME_SIZE - beacon_offset - 2;
 
-  if (beacon_max_packed > (ODID_PACK_MAX_MESSAGES * ODID_MESSAGE_SIZE)) {
+  if (beacon_max_packed > (ID_OD_PACK_MAX * ODID_MESSAGE_SIZE)) {
 
-    beacon_max_packed = (ODID_PACK_MAX_MESSAGES * ODID_MESSAGE_SIZE);
+    beacon_max_packed = (ID_OD_PACK_MAX * ODID_MESSAGE_SIZE);
   }
   
 #endif
 
+#if ID_OD_WIFI_NAN
+  init_nan();
+#endif
+
 #endif
 
   return;
@@ -292,12 +402,14 @@ void ID_OpenDrone::init(UTM_parameters *parameters) {
  *
  */
 
-void ID_OpenDrone::set_self_id(char *self_id) {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_self_id(char *self_id) {
 
   memset(selfID_data->Desc,0,ODID_STR_SIZE + 1);
   strncpy(selfID_data->Desc,self_id,ODID_STR_SIZE);
 
   encodeSelfIDMessage(&selfID_enc,selfID_data);
+  ++static_gen;
 
   return;
 }
@@ -307,7 +419,8 @@ void ID_OpenDrone::set_self_id(char *self_id) {
  *  comply with opendroneid release 2.0.
  */
 
-void ID_OpenDrone::set_auth(char *auth) {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_auth(char *auth) {
 
   set_auth((uint8_t *) auth,strlen(auth),0x0a);
 
@@ -316,7 +429,8 @@ void ID_OpenDrone::set_auth(char *auth) {
 
 //
 
-void ID_OpenDrone::set_auth(uint8_t *auth,short int len,uint8_t type) {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_auth(uint8_t *auth,short int len,uint8_t type) {
 
   int      i, j;
   char     text[160];
@@ -382,16 +496,23 @@ void ID_OpenDrone::set_auth(uint8_t *auth,short int len,uint8_t type) {
   auth_data[0]->LastPageIndex = (auth_page_count) ? auth_page_count - 1: 0;
   auth_data[0]->Length        = len;
 
-#if not defined(ARDUINO_ARCH_NRF52)
   time_t   secs;
 
-  time(&secs);
-  
-  auth_data[0]->Timestamp     = (uint32_t) (secs - ID_OD_AUTH_DATUM);
+#if ID_OD_GNSS_CLOCK
+  secs = utc_clock.unix_secs(millis());
 #else
-  auth_data[0]->Timestamp     = 0;
+  time(&secs);
 #endif
 
+  auth_data[0]->Timestamp     = (secs > (time_t) ID_OD_AUTH_DATUM) ? (uint32_t) (secs - ID_OD_AUTH_DATUM): 0;
+
+  for (i = 0; i < auth_page_count; ++i) {
+
+    encodeAuthMessage(&auth_enc[i],auth_data[i]);
+  }
+
+  ++static_gen;
+
   if (Debug_Serial) {
 
     sprintf(text,"%d pages\r\n",auth_page_count);
@@ -405,25 +526,30 @@ void ID_OpenDrone::set_auth(uint8_t *auth,short int len,uint8_t type) {
  *
  */
 
-int ID_OpenDrone::transmit(struct UTM_data *utm_data) {
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit(struct UTM_data *utm_data) {
 
-  int              i, status;
+  int              t, slot, status;
   char             text[128];
-  uint32_t         msecs;
+  uint32_t         done;
+  uint64_t         now;
   time_t           secs = 0;
-  static int       phase = 0;
-  static uint32_t  last_msecs = 2000;
 
   //
 
-  i       = 0;
+  status  = 0;
   text[0] = 0;
-  msecs   = millis();
+  now     = msecs64();
+
+  air_roll(now);
 
   // For the ODID 2.0 and auth timestamps.
-#if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_ESP8266)
-  secs = alt_unix_secs(utm_data->years,utm_data->months,utm_data->days,
-                       utm_data->hours,utm_data->minutes,utm_data->seconds);
+
+  utc_clock.discipline(utm_data->years,utm_data->months,utm_data->days,
+                       utm_data->hours,utm_data->minutes,utm_data->seconds,utm_data->csecs,
+                       (uint32_t) now);
+#if ID_OD_GNSS_CLOCK
+  secs = utc_clock.unix_secs((uint32_t) now);
   //  secs = ID_OD_AUTH_DATUM;
 #elif 0
   struct tm clock_tm;
@@ -444,409 +570,2780 @@ int ID_OpenDrone::transmit(struct UTM_data *utm_data) {
 
   if ((!system_data->OperatorLatitude)&&(utm_data->base_valid)) {
 
-    system_data->OperatorLatitude    = utm_data->base_latitude;
-    system_data->OperatorLongitude   = utm_data->base_longitude;
-    system_data->OperatorAltitudeGeo = utm_data->base_alt_m;
-
-    system_data->Timestamp           = (uint32_t) (secs - ID_OD_AUTH_DATUM);
+    id_od_update(system_data->OperatorLatitude,utm_data->base_latitude,&system_dirty,ID_OD_SYS_OPERATOR);
+    id_od_update(system_data->OperatorLongitude,utm_data->base_longitude,&system_dirty,ID_OD_SYS_OPERATOR);
+    id_od_update(system_data->OperatorAltitudeGeo,utm_data->base_alt_m,&system_dirty,ID_OD_SYS_OPERATOR);
+    id_od_update(system_data->Timestamp,(uint32_t) (secs - ID_OD_AUTH_DATUM),&system_dirty,ID_OD_SYS_TIMESTAMP);
 
-    encodeSystemMessage(&system_enc,system_data);
+    encode_system();
   }
 
-  // Periodically encode live data and advertise using Bluetooth. 
-
-  if ((msecs > last_msecs)&&
-      ((msecs - last_msecs) > 74)) {
+  // The transports that are due, longest due first.
 
-    last_msecs += 75;
+  for (done = 0; (t = next_transport(now,done)) >= 0; done |= 1 << t) {
 
-    switch (phase) {
+    switch (t) {
 
-    case  0: case  8: case 16: case 24: case 32:
-    case  4: case 12: case 20: case 28: case 36: // Every 300 ms.
+    case ID_OD_TRANSPORT_BLE: // Encode (if necessary) and advertise the next message.
 
-      if (utm_data->satellites >= SATS_LEVEL_2) {
+      if ((slot = next_slot(now)) >= 0) {
 
-        location_data->Status          = ODID_STATUS_UNDECLARED;
-        location_data->Direction       = (float) utm_data->heading;
-        location_data->SpeedHorizontal = 0.514444 * (float) utm_data->speed_kn;
-        location_data->SpeedVertical   = INV_SPEED_V;
-        location_data->Latitude        = utm_data->latitude_d;
-        location_data->Longitude       = utm_data->longitude_d;
-        location_data->Height          = utm_data->alt_agl_m;
-        location_data->AltitudeGeo     = utm_data->alt_msl_m;
-    
-        location_data->TimeStamp       = (float) ((utm_data->minutes * 60) + utm_data->seconds) +
-                                         0.01 * (float) utm_data->csecs;
-        UAS_data.LocationValid         = 1;
-
-      } else {
-
-        location_data->Status = ODID_STATUS_REMOTE_ID_SYSTEM_FAILURE;
+        transmit_slot(slot,utm_data,secs);
+        transport_sent(t,now);
       }
 
-      if ((status = encodeLocationMessage(&location_enc,location_data)) == ODID_SUCCESS) {
+      break;
+
+    case ID_OD_TRANSPORT_BLE_EXT:
 
-        transmit_ble((uint8_t *) &location_enc,sizeof(location_enc));
+#if ID_OD_BT && ID_OD_BLE_PACK
+      refresh_location(utm_data);
 
-      } else if (Debug_Serial) {
+      status = transmit_ble_pack();
+#endif
+      transport_sent(t,now);
+      break;
 
-        sprintf(text,"ID_OpenDrone::%s, encodeLocationMessage returned %d\r\n",
-                __func__,status);
-        Debug_Serial->print(text);
-      }
+    default:
 
+#if ID_OD_WIFI
+      status = transmit_wifi_burst(utm_data,t);
+#endif
+      transport_sent(t,now);
       break;
+    }
+  }
 
-    case  6: case 14: case 22: case 30: case 38: // Every 600 ms.
+  return status;
+}
 
-      if (secs > ID_OD_AUTH_DATUM) {
+/*
+ * Pack and transmit the WiFi data for a beacon or NAN interval.
+ *
+ * Location goes in every frame. The static messages are rotated through
+ * the frames, as few in each as will send every one of them at least every
+ * ID_OD_WIFI_STATIC_MS at the transport's period. If those that are due
+ * won't fit in one frame, the interval sends up to ID_OD_WIFI_BURST.
+ */
 
-        system_data->Timestamp = (uint32_t) (secs - ID_OD_AUTH_DATUM);
-        encodeSystemMessage(&system_enc,system_data);
-      }
+#if ID_OD_WIFI
 
-      transmit_ble((uint8_t *) &system_enc,sizeof(system_enc));
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_wifi_burst(struct UTM_data *utm_data,int t) {
 
-      break;
+  int status = 0;
 
-    case  2:
+#if ID_NATIONAL
 
-      if (UAS_data.BasicID[0].IDType) {
+  int      burst;
+  uint8_t *toggle;
 
-        transmit_ble((uint8_t *) &basicID_enc[0],sizeof(ODID_BasicID_encoded));
-      }
-      
-      break;
+  toggle = &wifi_toggle[(t == ID_OD_TRANSPORT_NAN) ? 0: 1];
 
-    case 10:
+  for (burst = 0; burst < ID_OD_WIFI_BURST; ++burst) {
 
-      if (UAS_data.BasicID[1].IDType) {
+    if (*toggle ^= 1) { // Basic IDs, operator, system and location.
 
-        transmit_ble((uint8_t *) &basicID_enc[1],sizeof(ODID_BasicID_encoded));
-      }
-      
-      break;
+      set_valid(static_layout() & (ID_OD_PACK_BASIC_ID_0 | (ID_OD_PACK_BASIC_ID_0 << 1) |
+                                   ID_OD_PACK_SYSTEM | ID_OD_PACK_OPERATOR_ID));
 
-    case 18:
+      status = transmit_wifi(utm_data,0,t);
 
-      transmit_ble((uint8_t *) &selfID_enc,sizeof(selfID_enc));
-      break;
+      set_valid(0);
 
-    case 26:
+    } else {
 
-      transmit_ble((uint8_t *) &operatorID_enc,sizeof(operatorID_enc));
-      break;
+      UAS_data.Auth[0].Timestamp = system_data->Timestamp;
 
-    case 34:
+      // memset(UAS_data.Auth[0].AuthData,0,12);
+      encodeAuthMessage(&auth_enc[0],&UAS_data.Auth[0]);
+      ++static_gen;
 
-      if (auth_page_count) {
+      status = transmit_wifi(utm_data,1,t);
+    }
+  }
 
-        // Refresh the timestamp on page 0?
- 
-        encodeAuthMessage(&auth_enc,auth_data[auth_page]);
+#else
 
-        transmit_ble((uint8_t *) &auth_enc,sizeof(auth_enc));
+  int                       i, n, k, due, frames, room, per_frame, groups;
+  uint16_t                  period;
+  uint32_t                  statics, msecs, oldest;
+  struct ID_OD_wifi_packer *packer;
 
-        if (++auth_page >= auth_page_count) {
+  packer  = &wifi_packer[(t == ID_OD_TRANSPORT_NAN) ? 0: 1];
+  statics = static_layout();
+  n       = __builtin_popcount(statics);
+  period  = transport[t].period_ms;
+  msecs   = millis();
 
-          auth_page = 0;
-        }
-      }
+  // The statics due this interval and the frames needed to carry them.
 
-      break;
+  if ((k = (period) ? ID_OD_WIFI_STATIC_MS / period: 1) < 1) {
 
-    default:
+    k = 1;
+  }
 
-      break;
-    }
+  due  = (n + k - 1) / k;
+  room = ID_OD_PACK_MAX;
 
-    if (++phase > 39) {
+#if ID_OD_WIFI_BEACON && !USE_BEACON_FUNC // odid_wifi_build_message_pack_beacon_frame() takes a full pack.
+  if ((t == ID_OD_TRANSPORT_BEACON)&&
+      (((beacon_max_packed - 3) / ODID_MESSAGE_SIZE) < room)) {
 
-      phase = 0;
-    }
+    room = (beacon_max_packed - 3) / ODID_MESSAGE_SIZE;
   }
+#endif
 
-  //
+  if (pack_layout() & ID_OD_PACK_LOCATION) {
 
-#if ID_OD_WIFI
+    --room;
+  }
 
-  // Pack and transmit the WiFi data.
+  if (room < 1) {
 
-  static uint8_t  wifi_toggle = 1;
-  static uint32_t last_wifi = 0;
+    room = 1;
+  }
 
-  if ((msecs - last_wifi) >= beacon_interval) {
+  if ((frames = (due + room - 1) / room) > ID_OD_WIFI_BURST) {
 
-    last_wifi = msecs;
+    frames = ID_OD_WIFI_BURST;
 
-    if (wifi_toggle ^= 1) { // Basic IDs, operator, system and location.
+  } else if (frames < 1) {
 
-      UAS_data.SystemValid = 1;
+    frames = 1;
+  }
 
-      if (UAS_data.BasicID[0].UASID[0]) {
-        UAS_data.BasicIDValid[0] = 1;
-      }
+  // The statics are split into fixed groups, one a frame, so that the
+  // frame buffers keep the same few layouts. No more groups than the ring
+  // has buffers for.
 
-      if (UAS_data.BasicID[1].UASID[0]) {
-        UAS_data.BasicIDValid[1] = 1;
-      }
+  if ((per_frame = (due + frames - 1) / frames) < ((n + ID_OD_WIFI_GROUPS - 1) / ID_OD_WIFI_GROUPS)) {
 
-      if (UAS_data.OperatorID.OperatorId[0]) {
-        UAS_data.OperatorIDValid = 1;
-      }
+    per_frame = (n + ID_OD_WIFI_GROUPS - 1) / ID_OD_WIFI_GROUPS;
+  }
 
-      status = transmit_wifi(utm_data,0);
+  if (per_frame > room) {
 
-      UAS_data.BasicIDValid[0] =
-      UAS_data.BasicIDValid[1] =
-      UAS_data.LocationValid   =
-      UAS_data.SystemValid     =
-      UAS_data.OperatorIDValid = 0;
+    per_frame = room;
+  }
 
-    } else {
+  groups = (per_frame) ? (n + per_frame - 1) / per_frame: 1;
 
-#if ID_NATIONAL
+  if (frames > groups) {
 
-      UAS_data.Auth[0].Timestamp = system_data->Timestamp;
+    frames = groups;
+  }
 
-      // memset(UAS_data.Auth[0].AuthData,0,12);
-      encodeAuthMessage(&auth_enc,&UAS_data.Auth[0]);
+  if (packer->groups != groups) {
+
+    packer->groups = groups;
+    packer->cursor = 0;
+  }
 
-      status = transmit_wifi(utm_data,pack_encrypt_national(beacon_payload));
+  packer->stats.statics  = n;
+  packer->stats.rotation = (groups + frames - 1) / frames;
+  ++packer->stats.intervals;
 
-#else // Self ID, authentication and location.
-    
-      if (UAS_data.SelfID.Desc[0]) {
-        UAS_data.SelfIDValid = 1;
-      }
+  // Location only while the radio is saturated, for as many intervals as
+  // a rotation has to spare before the statics would be late. The spare
+  // intervals taken at the end of one rotation and the start of the next
+  // both delay the same group, so not if the static sent longest ago would
+  // then miss ID_OD_WIFI_STATIC_MS.
 
-      for (i = 0; (i < auth_page_count)&&(i < ODID_AUTH_MAX_PAGES); ++i) {
+  if ((k -= packer->stats.rotation) > ID_OD_TX_DEFER_MAX) {
 
-        UAS_data.AuthValid[i] = 1;
-      }
-      
-      status = transmit_wifi(utm_data,0);
+    k = ID_OD_TX_DEFER_MAX;
+  }
 
-      UAS_data.LocationValid =
-      UAS_data.SelfIDValid   = 0;
+  for (i = 0, oldest = msecs; i < ID_OD_PACK_MESSAGES; ++i) {
 
-      for (i = 0; (i < auth_page_count)&&(i < ODID_AUTH_MAX_PAGES); ++i) {
+    if ((statics & (1UL << i))&&(packer->sent_msecs[i])&&
+        ((msecs - packer->sent_msecs[i]) > (msecs - oldest))) {
 
-        UAS_data.AuthValid[i] = 0;
-      }
-#endif
+      oldest = packer->sent_msecs[i];
     }
   }
 
-#endif // ID_OD_WIFI
+  if ((n)&&(tx_saturated())&&(packer->deferred < k)&&
+      (((msecs - oldest) + period) <= ID_OD_WIFI_STATIC_MS)) {
 
-  return status;
-}
+    ++packer->deferred;
+    ++packer->stats.deferred;
 
-/*
- *
- */
+    status = transmit_wifi(utm_data,0,t);
+    ++packer->stats.frames;
 
-int ID_OpenDrone::transmit_wifi(struct UTM_data *utm_data,int prepacked) {
+    return status;
+  }
 
-#if ID_OD_WIFI
+  for (i = 0; i < frames; ++i) {
 
-  int             length = 0, wifi_status = 0;
-  uint32_t        msecs;
-  uint64_t        usecs = 0;
-  static uint32_t last_wifi = 0;
-  char text[128];
+    set_valid(rotate_statics(packer,statics,n,msecs,period));
 
-  text[0] = 0;
-  
-  //
-  
-  if (++sequence > 0xffffff) {
+    status = transmit_wifi(utm_data,0,t);
 
-    sequence = 1;
+    set_valid(0);
   }
 
-  msecs         = millis();
-  wifi_interval = msecs - last_wifi;
-  last_wifi     = msecs;
-  
-#if not (defined(ARDUINO_ARCH_RP2040) || defined(ARDUINO_ARCH_NRF52))
-  struct timespec ts;
+  if (!packer->cursor) {
+
+    packer->deferred = 0;
+  }
 
-  clock_gettime(CLOCK_REALTIME,&ts);
-  usecs = (uint64_t)((double) ts.tv_sec * 1e6 + (double) ts.tv_nsec * 1e-3);
-#else
-  usecs = micros();
 #endif
 
-#if ID_OD_WIFI_NAN
+  return status;
+}
 
-  uint8_t        buffer[1024];
-  static uint8_t send_counter = 0;
+/*
+ * The static messages that there is data for, as pack layout bits.
+ */
 
-  if ((length = odid_wifi_build_nan_sync_beacon_frame((char *) WiFi_mac_addr,
-                                                      buffer,sizeof(buffer))) > 0) {
+template <class Backend>
+uint32_t ID_OpenDrone_T<Backend>::static_layout() {
 
-    wifi_status = transmit_wifi2(buffer,length);
-  }
-    
-  if ((Debug_Serial)&&((length < 0)||(wifi_status != 0))) {
+  int      i;
+  uint32_t layout = ID_OD_PACK_SYSTEM;
 
-    sprintf(text,"odid_wifi_build_nan_sync_beacon_frame() = %d, transmit_wifi2() = %d\r\n",
-            length,(int) wifi_status);
-    Debug_Serial->print(text);
-  }
+  for (i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; ++i) {
 
-  if ((length = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,(char *) WiFi_mac_addr,
-                                                              ++send_counter,
-                                                              buffer,sizeof(buffer))) > 0) {
+    if (UAS_data.BasicID[i].UASID[0]) {
 
-    wifi_status = transmit_wifi2(buffer,length);
+      layout |= ID_OD_PACK_BASIC_ID_0 << i;
+    }
   }
 
-  if (Debug_Serial) {
-
-    if ((length < 0)||(wifi_status != 0)) {
+  for (i = 0; (i < auth_page_count)&&(i < ODID_AUTH_MAX_PAGES); ++i) {
 
-      sprintf(text,"odid_wifi_build_message_pack_nan_action_frame() = %d, transmit_wifi2() = %d\r\n",
-              length,(int) wifi_status);
-      Debug_Serial->print(text);
+    layout |= ID_OD_PACK_AUTH << i;
+  }
 
-#if DIAGNOSTICS
+  if (UAS_data.SelfID.Desc[0]) {
 
-    } else {
+    layout |= ID_OD_PACK_SELF_ID;
+  }
 
-      sprintf(text,"ID_OpenDrone::%s ... ",__func__);
-      Debug_Serial->print(text);
-      
-      for (int i = 0; i < 32; ++i) {
+  if (UAS_data.OperatorID.OperatorId[0]) {
 
-        sprintf(text,"%02x ",buffer[16 + i]);
-        Debug_Serial->print(text);      
-      }
+    layout |= ID_OD_PACK_OPERATOR_ID;
+  }
 
-      Debug_Serial->print(" ... \r\n");
+  return layout;
+}
 
-#endif
-    }
-  }
+/*
+ * Sets the *Valid flags of the static messages from a layout, so that
+ * pack_layout() and opendroneid see the same messages.
+ */
 
-#endif // NAN
-  
-#if ID_OD_WIFI_BEACON
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_valid(uint32_t layout) {
 
-#if USE_BEACON_FUNC
+  int i;
 
-  if ((length = odid_wifi_build_message_pack_beacon_frame(&UAS_data,(char *) WiFi_mac_addr,
-                                                          ssid,ssid_length,
-                                                          beacon_interval,++beacon_counter,
-                                                          beacon_frame,BEACON_FRAME_SIZE)) > 0) {
+  for (i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; ++i) {
 
-    wifi_status = transmit_wifi2(beacon_frame,length);
+    UAS_data.BasicIDValid[i] = (layout & (ID_OD_PACK_BASIC_ID_0 << i)) ? 1: 0;
   }
 
-#if DIAGNOSTICS && 1
-
-  if (Debug_Serial) {
+  for (i = 0; i < ODID_AUTH_MAX_PAGES; ++i) {
 
-    sprintf(text,"ID_OpenDrone::%s * %02x ... ",__func__,beacon_frame[0]);
-    Debug_Serial->print(text);
+    UAS_data.AuthValid[i] = (layout & (ID_OD_PACK_AUTH << i)) ? 1: 0;
+  }
 
-    for (int i = 0; i < 20; ++i) {
+  UAS_data.SelfIDValid     = (layout & ID_OD_PACK_SELF_ID)     ? 1: 0;
+  UAS_data.SystemValid     = (layout & ID_OD_PACK_SYSTEM)      ? 1: 0;
+  UAS_data.OperatorIDValid = (layout & ID_OD_PACK_OPERATOR_ID) ? 1: 0;
 
-      sprintf(text,"%02x ",beacon_frame[22 + i]);
-      Debug_Serial->print(text);      
-    }
+  return;
+}
 
-    Debug_Serial->print(" ... *\r\n");
-  }
+/*
+ * The statics in the next group of the rotation, the n of them split as
+ * evenly as they will be.
+ */
 
-#endif // DIAG
+template <class Backend>
+uint32_t ID_OpenDrone_T<Backend>::rotate_statics(struct ID_OD_wifi_packer *packer,uint32_t statics,
+                                                 int n,uint32_t msecs,uint16_t period) {
 
-#else
-  
-  int i, len2 = 0;
+  int      bit, rank, first, last;
+  uint32_t layout = 0, interval, limit;
 
-  ++*beacon_counter;
+  first = (packer->cursor * n) / packer->groups;
+  last  = ((packer->cursor + 1) * n) / packer->groups;
+  limit = ((ID_OD_WIFI_STATIC_MS > period) ? ID_OD_WIFI_STATIC_MS: period) + (period / 2);
 
-  for (i = 0; i < 8; ++i) {
+  if (++packer->cursor >= packer->groups) {
 
-    beacon_timestamp[i] = (usecs >> (i * 8)) & 0xff;
+    packer->cursor = 0;
   }
 
-#if 1
-  beacon_seq[0] = (uint8_t) (sequence << 4);
-  beacon_seq[1] = (uint8_t) (sequence >> 4);
-#endif
+  for (bit = 0, rank = 0; (bit < ID_OD_PACK_MESSAGES)&&(rank < last); ++bit) {
 
-  length = (prepacked > 0) ? prepacked:
-                             odid_message_build_pack(&UAS_data,beacon_payload,beacon_max_packed);
+    if (!(statics & (1UL << bit))) {
 
-  if (length > 0) {
+      continue;
+    }
 
-    *beacon_length = length + 5;
+    if (rank++ < first) {
 
-    wifi_status = transmit_wifi2(beacon_frame,len2 = beacon_offset + length);
-  }
+      continue;
+    }
 
-#if DIAGNOSTICS && 1
+    layout |= 1UL << bit;
 
-  if (Debug_Serial) {
+    if (packer->sent_msecs[bit]) {
 
-    sprintf(text,"ID_OpenDrone::%s %d %d+%d=%d ",
-            __func__,beacon_max_packed,beacon_offset,length,len2);
-    Debug_Serial->print(text);
+      interval = msecs - packer->sent_msecs[bit];
 
-    sprintf(text,"* %02x ... ",beacon_frame[0]);
-    Debug_Serial->print(text);
+      if (interval > packer->stats.static_max_ms) {
 
-    for (int i = 0; i < 16; ++i) {
+        packer->stats.static_max_ms = interval;
+      }
 
-      if ((i == 3)||(i == 10)) {
+      if (interval > limit) {
 
-        Debug_Serial->print("| ");
+        ++packer->stats.late;
       }
-
-      sprintf(text,"%02x ",beacon_frame[beacon_offset - 10 + i]);
-      Debug_Serial->print(text);
     }
 
-    sprintf(text,"... %02x (%2d,%4u,%4u)\r\n",beacon_frame[len2 - 1],
-            wifi_status,wifi_interval,ble_interval);
-    Debug_Serial->print(text);
+    packer->sent_msecs[bit] = (msecs) ? msecs: 1;
   }
 
-#endif // DIAG
-
-#endif // FUNC
-  
-#endif // BEACON
-
-#endif // WIFI
+  ++packer->stats.frames;
+  packer->stats.messages += last - first;
 
-  return 0;
+  return layout;
 }
 
+#endif
+
 /*
- *
+ * Encode (if necessary) and advertise the message for a scheduler slot.
  */
 
-int ID_OpenDrone::transmit_ble(uint8_t *odid_msg,int length) {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::transmit_slot(int slot,struct UTM_data *utm_data,time_t secs) {
 
-  uint32_t        msecs;
-  static uint32_t last_ble;
-  
-  msecs        = millis();
-  ble_interval = msecs - last_ble;
+  int  status, page;
+  char text[128];
+
+  switch (slot) {
+
+  case ID_OD_SLOT_LOCATION:
+
+    if ((status = refresh_location(utm_data)) == ODID_SUCCESS) {
+
+      transmit_ble(slot,(uint8_t *) &location_enc,sizeof(location_enc));
+
+    } else if (Debug_Serial) {
+
+      sprintf(text,"ID_OpenDrone::%s, encodeLocationMessage returned %d\r\n",
+              __func__,status);
+      Debug_Serial->print(text);
+    }
+
+    break;
+
+  case ID_OD_SLOT_SYSTEM:
+
+    if (secs > ID_OD_AUTH_DATUM) {
+
+      id_od_update(system_data->Timestamp,(uint32_t) (secs - ID_OD_AUTH_DATUM),&system_dirty,ID_OD_SYS_TIMESTAMP);
+    }
+
+    encode_system();
+
+    transmit_ble(slot,(uint8_t *) &system_enc,sizeof(system_enc));
+    break;
+
+  case ID_OD_SLOT_BASIC_ID_0:
+
+    transmit_ble(slot,(uint8_t *) &basicID_enc[0],sizeof(ODID_BasicID_encoded));
+    break;
+
+  case ID_OD_SLOT_BASIC_ID_1:
+
+    transmit_ble(slot,(uint8_t *) &basicID_enc[1],sizeof(ODID_BasicID_encoded));
+    break;
+
+  case ID_OD_SLOT_SELF_ID:
+
+    transmit_ble(slot,(uint8_t *) &selfID_enc,sizeof(selfID_enc));
+    break;
+
+  case ID_OD_SLOT_OPERATOR_ID:
+
+    transmit_ble(slot,(uint8_t *) &operatorID_enc,sizeof(operatorID_enc));
+    break;
+
+  default: // Authentication pages.
+
+    // Refresh the timestamp on page 0?
+
+    page = slot - ID_OD_SLOT_AUTH;
+
+    transmit_ble(slot,(uint8_t *) &auth_enc[page],sizeof(ODID_Auth_encoded));
+    break;
+  }
+
+  return;
+}
+
+/*
+ * Update the Location message from the UTM data and encode it (if necessary).
+ * Returns the encoder's status.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::refresh_location(struct UTM_data *utm_data) {
+
+  if (utm_data->satellites >= SATS_LEVEL_2) {
+
+    id_od_update(location_data->Status,ODID_STATUS_UNDECLARED,&location_dirty,ID_OD_LOCN_STATUS);
+    id_od_update(location_data->Direction,(float) utm_data->heading,&location_dirty,ID_OD_LOCN_DIRECTION);
+    id_od_update(location_data->SpeedHorizontal,0.514444 * (float) utm_data->speed_kn,
+                 &location_dirty,ID_OD_LOCN_SPEED_H);
+    id_od_update(location_data->SpeedVertical,INV_SPEED_V,&location_dirty,ID_OD_LOCN_SPEED_V);
+    id_od_update(location_data->Latitude,utm_data->latitude_d,&location_dirty,ID_OD_LOCN_LATITUDE);
+    id_od_update(location_data->Longitude,utm_data->longitude_d,&location_dirty,ID_OD_LOCN_LONGITUDE);
+    id_od_update(location_data->Height,utm_data->alt_agl_m,&location_dirty,ID_OD_LOCN_HEIGHT);
+    id_od_update(location_data->AltitudeGeo,utm_data->alt_msl_m,&location_dirty,ID_OD_LOCN_ALTITUDE);
+    id_od_update(location_data->TimeStamp,(float) utc_clock.fix_centisecs() / 100.0f,
+                 &location_dirty,ID_OD_LOCN_TIMESTAMP);
+
+    UAS_data.LocationValid = 1;
+
+  } else {
+
+    id_od_update(location_data->Status,ODID_STATUS_REMOTE_ID_SYSTEM_FAILURE,&location_dirty,ID_OD_LOCN_STATUS);
+
+    UAS_data.LocationValid = 0;
+  }
+
+  return encode_location();
+}
+
+/*
+ * Only re-encode the Location and System messages if something that they
+ * depend on has changed. If it is just the timestamp, it is patched in the
+ * encoded message (opendroneid stores it as a plain integer).
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::encode_location() {
+
+  float tenths;
+
+  if (location_dirty & ~ID_OD_LOCN_TIMESTAMP) {
+
+    location_status = encodeLocationMessage(&location_enc,location_data);
+    ++encode_stats.location_encodes;
+    ++location_gen;
+
+  } else if (location_dirty) {
+
+    // As opendroneid's encodeTimeStamp().
+
+    tenths = roundf(location_data->TimeStamp * 10.0);
+
+    if (location_data->TimeStamp == INV_TIMESTAMP) {
+
+      location_enc.TimeStamp = INV_TIMESTAMP;
+
+    } else if (tenths < 0.0) {
+
+      location_enc.TimeStamp = 0;
+
+    } else if (tenths > (MAX_TIMESTAMP * 10)) {
+
+      location_enc.TimeStamp = MAX_TIMESTAMP * 10;
+
+    } else {
+
+      location_enc.TimeStamp = (uint16_t) tenths;
+    }
+
+    ++encode_stats.location_patches;
+    ++location_gen;
+
+  } else {
+
+    ++encode_stats.location_skipped;
+  }
+
+  location_dirty = 0;
+
+  return location_status;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::encode_system() {
+
+  if (system_dirty & ~ID_OD_SYS_TIMESTAMP) {
+
+    encodeSystemMessage(&system_enc,system_data);
+    ++encode_stats.system_encodes;
+    ++system_gen;
+
+  } else if (system_dirty) {
+
+    system_enc.Timestamp = system_data->Timestamp;
+    ++encode_stats.system_patches;
+    ++system_gen;
+
+  } else {
+
+    ++encode_stats.system_skipped;
+  }
+
+  system_dirty = 0;
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_encode_stats(struct ID_OD_encode_stats *stats) {
+
+  memcpy(stats,&encode_stats,sizeof(struct ID_OD_encode_stats));
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_beacon_stats(struct ID_OD_beacon_stats *stats) {
+
+  memcpy(stats,&beacon_stats,sizeof(struct ID_OD_beacon_stats));
+
+#if ID_OD_WIFI
+  stats->stale = 0;
+
+  for (int i = 0; i < ID_OD_FRAME_BUFFERS; ++i) {
+
+    stats->stale += frame_ring[i].stale;
+  }
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_nan_stats(struct ID_OD_beacon_stats *stats) {
+
+#if ID_OD_WIFI_NAN
+  memcpy(stats,&nan_stats,sizeof(struct ID_OD_beacon_stats));
+#else
+  memset(stats,0,sizeof(struct ID_OD_beacon_stats));
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_pack_stats(int t,struct ID_OD_pack_stats *stats) {
+
+#if ID_OD_WIFI
+  if ((t == ID_OD_TRANSPORT_NAN)||(t == ID_OD_TRANSPORT_BEACON)) {
+
+    memcpy(stats,&wifi_packer[(t == ID_OD_TRANSPORT_NAN) ? 0: 1].stats,sizeof(struct ID_OD_pack_stats));
+    return;
+  }
+#endif
+
+  memset(stats,0,sizeof(struct ID_OD_pack_stats));
+
+  return;
+}
+
+/*
+ * The BLE message scheduler.
+ *
+ * Each message has a period and a deadline. At each BLE slot, the due
+ * message with the earliest deadline is sent. A message that misses its
+ * deadline, e.g. because transmit() wasn't called during a long GNSS parse,
+ * is either dropped (ID_OD_SCHED_SKIP) or sent late (ID_OD_SCHED_CATCH_UP,
+ * limited to ID_OD_CATCH_UP_MAX periods).
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::init_schedule(uint64_t now) {
+
+  int                   i, j;
+  struct ID_OD_schedule *entry;
+  static const struct {uint16_t period_ms, deadline_ms, offset_ms;}
+                        defaults[ID_OD_SLOT_AUTH + 1] = {{ 300, 150,    0},  // Location
+                                                         { 600, 300,  450},  // System
+                                                         {3000,1000,  150},  // Basic ID 0
+                                                         {3000,1000,  750},  // Basic ID 1
+                                                         {3000,1000, 1350},  // Self ID
+                                                         {3000,1000, 1950},  // Operator ID
+                                                         {3000,1000, 2550}}; // Auth., +75 ms per page
+
+  // WiFi starts an interval after the first BLE slot.
+
+  for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+    transport[i].sent    =
+    transport[i].held    = 0;
+    transport[i].waiting = 0;
+    transport[i].due     = (transport[i].air == ID_OD_AIR_WIFI) ? now + transport[i].period_ms: now;
+  }
+
+  for (i = 0; i < ID_OD_SLOTS; ++i) {
+
+    j     = (i < ID_OD_SLOT_AUTH) ? i: ID_OD_SLOT_AUTH;
+    entry = &schedule[i];
+
+    memset(entry,0,sizeof(struct ID_OD_schedule));
+
+    entry->period_ms   = defaults[j].period_ms;
+    entry->deadline_ms = defaults[j].deadline_ms;
+    entry->due         = now + defaults[j].offset_ms + ((i - j) * ID_OD_BLE_SLOT_MS);
+  }
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_schedule(int slot,uint16_t period_ms,uint16_t deadline_ms) {
+
+  if ((slot >= 0)&&(slot < ID_OD_SLOTS)&&(period_ms >= ID_OD_BLE_SLOT_MS)) {
+
+    schedule[slot].period_ms   = period_ms;
+    schedule[slot].deadline_ms = (deadline_ms) ? deadline_ms: period_ms / 2;
+  }
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_schedule_policy(int policy) {
+
+  schedule_policy = policy;
+
+  return;
+}
+
+/*
+ * Returns the slot to send now, or -1.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::next_slot(uint64_t now) {
+
+  int                    i, enabled, best = -1;
+  uint32_t               missed;
+  uint64_t               deadline, best_deadline = 0, limit;
+  struct ID_OD_schedule *entry;
+
+  for (i = 0; i < ID_OD_SLOTS; ++i) {
+
+    entry = &schedule[i];
+
+    switch (i) {
+
+    case ID_OD_SLOT_BASIC_ID_0:
+    case ID_OD_SLOT_BASIC_ID_1:
+
+      enabled = (UAS_data.BasicID[i - ID_OD_SLOT_BASIC_ID_0].IDType) ? 1: 0;
+      break;
+
+    case ID_OD_SLOT_LOCATION:
+    case ID_OD_SLOT_SYSTEM:
+    case ID_OD_SLOT_SELF_ID:
+    case ID_OD_SLOT_OPERATOR_ID:
+
+      enabled = 1;
+      break;
+
+    default:
+
+      enabled = ((i - ID_OD_SLOT_AUTH) < auth_page_count) ? 1: 0;
+      break;
+    }
+
+    if (!enabled) {
+
+      if (entry->due < now) {
+
+        entry->due = now;
+      }
+
+      continue;
+    }
+
+    // Deal with missed deadlines.
+
+    if ((deadline = entry->due + entry->deadline_ms) < now) {
+
+      if (schedule_policy == ID_OD_SCHED_CATCH_UP) {
+
+        limit = (uint64_t) entry->period_ms * ID_OD_CATCH_UP_MAX;
+
+        if ((now - entry->due) > limit) {
+
+          missed          = (uint32_t) ((now - entry->due - limit) / entry->period_ms) + 1;
+          entry->skipped += missed;
+          entry->due     += (uint64_t) missed * entry->period_ms;
+        }
+
+      } else {
+
+        missed          = (uint32_t) ((now - deadline) / entry->period_ms) + 1;
+        entry->skipped += missed;
+        entry->due     += (uint64_t) missed * entry->period_ms;
+      }
+
+      deadline = entry->due + entry->deadline_ms;
+    }
+
+    if ((entry->due <= now)&&
+        ((best < 0)||(deadline < best_deadline))) {
+
+      best          = i;
+      best_deadline = deadline;
+    }
+  }
+
+  if (best >= 0) {
+
+    entry = &schedule[best];
+
+    if (now > (entry->due + entry->deadline_ms)) {
+
+      ++entry->late;
+    }
+
+    if (!entry->sent++) {
+
+      entry->first_sent = now;
+    }
+
+    entry->last_sent  = now;
+    entry->due       += entry->period_ms;
+  }
+
+  return best;
+}
+
+/*
+ * Target and achieved intervals.
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_schedule_stats(int slot,struct ID_OD_schedule_stats *stats) {
+
+  struct ID_OD_schedule *entry;
+
+  memset(stats,0,sizeof(struct ID_OD_schedule_stats));
+
+  if ((slot < 0)||(slot >= ID_OD_SLOTS)) {
+
+    return;
+  }
+
+  entry = &schedule[slot];
+
+  stats->target_ms   = entry->period_ms;
+  stats->sent        = entry->sent;
+  stats->late        = entry->late;
+  stats->skipped     = entry->skipped;
+  stats->achieved_ms = (entry->sent > 1) ?
+                       (float) (entry->last_sent - entry->first_sent) / (float) (entry->sent - 1): 0.0;
+
+  return;
+}
+
+/*
+ * The rate plan.
+ *
+ * Returns the transport, of those not already sent by this transmit(), that
+ * has been due longest, or -1. The BLE slots go first because they encode
+ * the messages that the others carry. With legacy adverts off, the slots
+ * still run every ID_OD_BLE_SLOT_MS for that, but don't advertise.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::next_transport(uint64_t now,uint32_t done) {
+
+  int                     i, best = -1;
+  struct ID_OD_transport *entry;
+
+  for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+    entry = &transport[i];
+
+    if ((done & (1 << i))||(entry->due > now)||
+        ((!entry->period_ms)&&(i != ID_OD_TRANSPORT_BLE))) {
+
+      continue;
+    }
+
+    if ((entry->period_ms)&&(air_hold(entry->air,now))) {
+
+      if (!entry->waiting) {
+
+        entry->waiting = 1;
+        ++entry->held;
+      }
+
+      continue;
+    }
+
+    if (i == ID_OD_TRANSPORT_BLE) {
+
+      return i;
+    }
+
+    if ((best < 0)||(entry->due < transport[best].due)) {
+
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::transport_sent(int t,uint64_t now) {
+
+  uint16_t                period;
+  struct ID_OD_transport *entry;
+
+  entry  = &transport[t];
+  period = (entry->period_ms) ? entry->period_ms: ID_OD_BLE_SLOT_MS;
+
+  if (entry->period_ms) {
+
+    if (!entry->sent++) {
+
+      entry->first_sent = now;
+    }
+
+    entry->last_sent = now;
+  }
+
+  entry->waiting = 0;
+
+  // Don't try to make up for lost intervals.
+
+  entry->due = ((now - entry->due) < period) ? entry->due + period: now + period;
+
+  return;
+}
+
+/*
+ * Returns -1 if the transport isn't built in. Turning one on sends it at
+ * the next transmit(). The beacon's interval field keeps the value that
+ * it had at init().
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::set_transport(int t,uint16_t period_ms) {
+
+  struct ID_OD_transport *entry;
+
+  if ((t < 0)||(t >= ID_OD_TRANSPORTS)||(!transport[t].built)) {
+
+    return -1;
+  }
+
+  entry = &transport[t];
+
+  if ((period_ms)&&(!entry->period_ms)) {
+
+    entry->due = msecs64();
+  }
+
+  entry->period_ms = period_ms;
+
+  return 0;
+}
+
+//
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::set_rate_plan(const struct ID_OD_rate_plan *plan) {
+
+  int i, status = 0;
+
+  for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+    if ((set_transport(i,plan->period_ms[i]) != 0)&&(plan->period_ms[i])) {
+
+      status = -1;
+    }
+  }
+
+  return status;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_rate_plan(struct ID_OD_rate_plan *plan) {
+
+  int i;
+
+  for (i = 0; i < ID_OD_TRANSPORTS; ++i) {
+
+    plan->period_ms[i] = transport[i].period_ms;
+  }
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_transport_stats(int t,struct ID_OD_transport_stats *stats) {
+
+  struct ID_OD_transport *entry;
+
+  memset(stats,0,sizeof(struct ID_OD_transport_stats));
+
+  if ((t < 0)||(t >= ID_OD_TRANSPORTS)) {
+
+    return;
+  }
+
+  entry = &transport[t];
+
+  stats->built       = entry->built;
+  stats->period_ms   = entry->period_ms;
+  stats->sent        = entry->sent;
+  stats->held        = entry->held;
+  stats->achieved_ms = (entry->sent > 1) ?
+                       (float) (entry->last_sent - entry->first_sent) / (float) (entry->sent - 1): 0.0;
+
+  return;
+}
+
+/*
+ * millis() extended to 64 bits so that the scheduler doesn't have to worry
+ * about it wrapping after 49 days.
+ */
+
+template <class Backend>
+uint64_t ID_OpenDrone_T<Backend>::msecs64() {
+
+  uint32_t msecs;
+
+  msecs = millis();
+
+  if (msecs < last_millis) {
+
+    millis_wraps += 0x100000000ULL;
+  }
+
+  last_millis = msecs;
+
+  return millis_wraps + msecs;
+}
+
+/*
+ * The UTC clock.
+ *
+ * Returns 1 if the GNSS time has changed. The GNSS date is taken to be
+ * invalid before 1970, in which case the clock keeps running from the last
+ * valid time (or set_utc()).
+ */
+
+int ID_OD_Clock::discipline(int y,int mo,int d,int h,int mi,int s,int cs,uint32_t msecs) {
+
+  int tod;
+
+  tod = (h * 3600) + (mi * 60) + s;
+
+  if ((tod == time_of_day)&&(cs == csecs)&&
+      (d == day)&&(mo == month)&&(y == year)) {
+
+    return 0;
+  }
+
+  if ((d != day)||(mo != month)||(y != year)) {
+
+    year  = y;
+    month = mo;
+    day   = d;
+
+    date_secs = (y >= 1970) ? (time_t) alt_secs_from_civil(y,mo,d,0,0,0): 0;
+
+    ++date_conversions;
+  }
+
+  time_of_day = tod;
+  csecs       = cs;
+
+  if (date_secs) {
+
+    fix_secs   = date_secs + tod;
+    fix_msecs  = (uint16_t) (cs * 10);
+    fix_millis = msecs;
+  }
+
+  ++disciplines;
+
+  return 1;
+}
+
+//
+
+void ID_OD_Clock::discipline(time_t secs,uint16_t msecs,uint32_t now) {
+
+  fix_secs   = secs;
+  fix_msecs  = msecs;
+  fix_millis = now;
+
+  ++disciplines;
+
+  return;
+}
+
+//
+
+time_t ID_OD_Clock::unix_secs(uint32_t msecs) {
+
+  if (!fix_secs) {
+
+    return 0;
+  }
+
+  return fix_secs + (time_t) (((uint32_t) fix_msecs + (msecs - fix_millis)) / 1000);
+}
+
+//
+
+uint32_t ID_OD_Clock::fix_centisecs() {
+
+  return (time_of_day >= 0) ? (((uint32_t) time_of_day % 3600) * 100) + (uint32_t) csecs: 0;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_utc(time_t secs,uint16_t msecs) {
+
+  utc_clock.discipline(secs,msecs,millis());
+
+  return;
+}
+
+/*
+ * The messages that would go in a pack, using the same *Valid flags as
+ * odid_message_build_pack().
+ */
+
+template <class Backend>
+uint32_t ID_OpenDrone_T<Backend>::pack_layout() {
+
+  int      i;
+  uint32_t layout = 0;
+
+  for (i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; ++i) {
+
+    if (UAS_data.BasicIDValid[i]) {
+
+      layout |= ID_OD_PACK_BASIC_ID_0 << i;
+    }
+  }
+
+  if ((UAS_data.LocationValid)&&(location_status == ODID_SUCCESS)) {
+
+    layout |= ID_OD_PACK_LOCATION;
+  }
+
+  for (i = 0; i < ODID_AUTH_MAX_PAGES; ++i) {
+
+    if (UAS_data.AuthValid[i]) {
+
+      layout |= ID_OD_PACK_AUTH << i;
+    }
+  }
+
+  if (UAS_data.SelfIDValid) {
+
+    layout |= ID_OD_PACK_SELF_ID;
+  }
+
+  if (UAS_data.SystemValid) {
+
+    layout |= ID_OD_PACK_SYSTEM;
+  }
+
+  if (UAS_data.OperatorIDValid) {
+
+    layout |= ID_OD_PACK_OPERATOR_ID;
+  }
+
+  return layout;
+}
+
+//
+
+template <class Backend>
+const uint8_t *ID_OpenDrone_T<Backend>::pack_message(int bit) {
+
+  if (bit < ODID_BASIC_ID_MAX_MESSAGES) {
+
+    return (const uint8_t *) &basicID_enc[bit];
+  }
+
+  if (bit == 2) {
+
+    return (const uint8_t *) &location_enc;
+  }
+
+  if ((bit -= 3) < ODID_AUTH_MAX_PAGES) {
+
+    return (const uint8_t *) &auth_enc[bit];
+  }
+
+  switch (bit - ODID_AUTH_MAX_PAGES) {
+
+  case 0:  return (const uint8_t *) &selfID_enc;
+  case 1:  return (const uint8_t *) &system_enc;
+  default: return (const uint8_t *) &operatorID_enc;
+  }
+}
+
+/*
+ * Assembles a message pack from the encoded messages, in the same order as
+ * odid_message_build_pack(), but without encoding anything.
+ * Returns the length, 0 if there is nothing to send.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::build_pack(uint8_t *pack,int max_length,uint32_t layout) {
+
+  int                       i, n;
+  uint8_t                  *message;
+  ODID_MessagePack_encoded *header;
+
+  n = __builtin_popcount(layout);
+
+  if ((n == 0)||(n > ID_OD_PACK_MAX)||
+      ((3 + (n * ODID_MESSAGE_SIZE)) > max_length)) {
+
+    return 0;
+  }
+
+  header                    = (ODID_MessagePack_encoded *) pack;
+  header->MessageType       = ODID_MESSAGETYPE_PACKED;
+  header->ProtoVersion      = ODID_PROTOCOL_VERSION;
+  header->SingleMessageSize = ODID_MESSAGE_SIZE;
+  header->MsgPackSize       = n;
+
+  message = &pack[3];
+
+  for (i = 0; i < ID_OD_PACK_MESSAGES; ++i) {
+
+    if (layout & (1UL << i)) {
+
+      memcpy(message,pack_message(i),ODID_MESSAGE_SIZE);
+      message += ODID_MESSAGE_SIZE;
+    }
+  }
+
+  return 3 + (n * ODID_MESSAGE_SIZE);
+}
+
+/*
+ * BT4/BT5 interleaving.
+ *
+ * Returns the PHY for an advert of the message type from the slot, or -1 if
+ * it is over budget. The ratios are spread with an accumulator per slot, so
+ * that messages of the same type (e.g. the two Basic IDs) each get them.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::ble_phy(int slot,int type,int length) {
+
+#if ID_OD_BT
+
+  int      i, phy, other;
+  uint32_t msecs, elapsed, max_tokens;
+
+  type &= 0xf;
+
+  if (length > ID_OD_BLE_ADV_SIZE) {
+
+    phy = ID_OD_PHY_CODED; // Only fits in an extended advert.
+
+  } else if ((ble_phy_acc[slot] += ble_policy.coded[type]) >= ble_policy.period[type]) {
+
+    ble_phy_acc[slot] -= ble_policy.period[type];
+    phy                = ID_OD_PHY_CODED;
+
+  } else {
+
+    phy                = ID_OD_PHY_LEGACY;
+  }
+
+  // Budgets, a token bucket per PHY holding up to a second's worth.
+
+  msecs           = millis();
+  elapsed         = msecs - ble_token_msecs;
+  ble_token_msecs = msecs;
+
+  if (elapsed > 1000) {
+
+    elapsed = 1000;
+  }
+
+  for (i = 0; i < ID_OD_PHYS; ++i) {
+
+    max_tokens     = (uint32_t) ble_policy.budget[i] * 1000;
+    ble_tokens[i] += elapsed * ble_policy.budget[i];
+
+    if (ble_tokens[i] > max_tokens) {
+
+      ble_tokens[i] = max_tokens;
+    }
+  }
+
+  if ((ble_policy.budget[phy])&&(ble_tokens[phy] < 1000)) {
+
+    other = phy ^ 1;
+
+    if ((length <= ID_OD_BLE_ADV_SIZE)&&
+        ((!ble_policy.budget[other])||(ble_tokens[other] >= 1000))) {
+
+      ++ble_phy_stats.diverted[phy];
+      phy = other;
+
+    } else {
+
+      ++ble_phy_stats.dropped;
+      return -1;
+    }
+  }
+
+  if (ble_policy.budget[phy]) {
+
+    ble_tokens[phy] -= 1000;
+  }
+
+  ++ble_phy_stats.sent[phy];
+
+  return phy;
+
+#else
+
+  return ID_OD_PHY_LEGACY;
+
+#endif
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_ble_policy(int preset) {
+
+#if ID_OD_BT
+
+  int i;
+
+  for (i = 0; i < 16; ++i) {
+
+    switch (preset) {
+
+    case ID_OD_BLE_ALTERNATE:
+
+      ble_policy.coded[i]  = 1;
+      ble_policy.period[i] = 2;
+      break;
+
+    case ID_OD_BLE_LOCATION_LEGACY:
+
+      ble_policy.coded[i]  = (i == ODID_MESSAGETYPE_LOCATION) ? 0: 1;
+      ble_policy.period[i] = 1;
+      break;
+
+    default:
+
+      ble_policy.coded[i]  = 0;
+      ble_policy.period[i] = 1;
+      break;
+    }
+  }
+
+  ble_policy.coded[ODID_MESSAGETYPE_PACKED]  =
+  ble_policy.period[ODID_MESSAGETYPE_PACKED] = 1;
+
+  memset(ble_phy_acc,0,sizeof(ble_phy_acc));
+
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_ble_ratio(int type,uint8_t coded,uint8_t period) {
+
+#if ID_OD_BT
+
+  if ((type >= 0)&&(type < 16)&&(period)&&(coded <= period)) {
+
+    ble_policy.coded[type]  = coded;
+    ble_policy.period[type] = period;
+  }
+
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_ble_budget(int phy,uint16_t per_second) {
+
+#if ID_OD_BT
+
+  if ((phy >= 0)&&(phy < ID_OD_PHYS)) {
+
+    ble_policy.budget[phy] = per_second;
+    ble_tokens[phy]        = (uint32_t) per_second * 1000;
+  }
+
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_ble_phy_stats(struct ID_OD_ble_phy_stats *stats) {
+
+#if ID_OD_BT
+  memcpy(stats,&ble_phy_stats,sizeof(struct ID_OD_ble_phy_stats));
+#else
+  memset(stats,0,sizeof(struct ID_OD_ble_phy_stats));
+#endif
+
+  return;
+}
+
+/*
+ * Airtime, in microseconds, of a frame as it goes on air.
+ *
+ *   WiFi   DSSS/CCK, 192 us long preamble and PLCP header then the frame and
+ *          FCS at the rate. ERP-OFDM, 20 us preamble and SIGNAL, 4 us
+ *          symbols carrying the service bits, frame, FCS and tail, and 6 us
+ *          signal extension.
+ *   BLE    Legacy, an ADV_NONCONN_IND on each of the three primary channels.
+ *          Extended, an ADV_EXT_IND on each primary channel, on the coded PHY
+ *          if the secondary is, and an AUX_ADV_IND. As host_ble_usecs().
+ */
+
+static uint32_t id_od_ble_usecs(int coded,int length) {
+
+  return (coded) ? 376 + (8 * ((8 * (2 + length + 3)) + 3)):
+                   8 * (1 + 4 + 2 + length + 3);
+}
+
+template <class Backend>
+uint32_t ID_OpenDrone_T<Backend>::airtime(int type,int length,int phy) {
+
+  uint32_t bits, rate;
+
+  if (type == ID_OD_TX_WIFI) {
+
+    bits = 8 * (length + 4);
+    rate = air_wifi_rate;
+
+    switch (rate) {
+
+    case 2: case 4: case 11: case 22:
+
+      return 192 + (((2 * bits) + rate - 1) / rate);
+
+    default:
+
+      return 20 + (4 * ((16 + bits + 6 + (2 * rate) - 1) / (2 * rate))) + 6;
+    }
+  }
+
+  if ((phy == ID_OD_PHY_LEGACY)&&(length <= ID_OD_BLE_ADV_SIZE)) {
+
+    return 3 * id_od_ble_usecs(0,6 + length);
+  }
+
+  return (3 * id_od_ble_usecs(phy == ID_OD_PHY_CODED,7)) +
+         id_od_ble_usecs(phy == ID_OD_PHY_CODED,8 + length);
+}
+
+/*
+ * Airtime is counted in whole seconds. air_msecs is the time of the current
+ * transmit(), the frames are all queued from it.
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::air_roll(uint64_t msecs) {
+
+  int      t;
+  uint64_t elapsed;
+
+  air_msecs = msecs;
+  elapsed   = msecs - air_window;
+
+  if (elapsed >= 1000) {
+
+    for (t = 0; t < ID_OD_AIRS; ++t) {
+
+      air[t].last_usecs = (elapsed < 2000) ? air[t].usecs: 0;
+      air[t].usecs      = 0;
+
+      if (air[t].last_usecs > air[t].max_usecs) {
+
+        air[t].max_usecs = air[t].last_usecs;
+      }
+    }
+
+    air_window = (elapsed < 2000) ? air_window + 1000: msecs;
+  }
+
+  return;
+}
+
+// Returns 1 if the transport's budget is holding it back.
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::air_hold(int t,uint64_t msecs) {
+
+  if ((msecs * 1000) < air[t].next_usecs) {
+
+    air[t].held = 1;
+
+    return 1;
+  }
+
+  if (air[t].held) {
+
+    air[t].held = 0;
+    ++air[t].stretched;
+  }
+
+  return 0;
+}
+
+// A frame's airtime at a budget of b/1000 pays for usecs * 1000 / b of time.
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::air_account(int type,int length,int phy) {
+
+  int      t;
+  uint32_t usecs;
+  uint64_t now_usecs;
+
+  t     = (type == ID_OD_TX_WIFI) ? ID_OD_AIR_WIFI: ID_OD_AIR_BLE;
+  usecs = airtime(type,length,phy);
+
+  air[t].usecs       += usecs;
+  air[t].total_usecs += usecs;
+  ++air[t].frames;
+
+  if (air[t].budget) {
+
+    now_usecs         = air_msecs * 1000;
+    air[t].next_usecs = ((air[t].next_usecs > now_usecs) ? air[t].next_usecs: now_usecs) +
+                        (((uint64_t) usecs * 1000) / air[t].budget);
+  }
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::set_airtime_budget(int t,uint16_t per_mille) {
+
+  if ((t >= 0)&&(t < ID_OD_AIRS)) {
+
+    air[t].budget     = (per_mille < 1000) ? per_mille: 0;
+    air[t].next_usecs = 0;
+  }
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_airtime_stats(int t,struct ID_OD_airtime_stats *stats) {
+
+  memset(stats,0,sizeof(struct ID_OD_airtime_stats));
+
+  if ((t >= 0)&&(t < ID_OD_AIRS)) {
+
+    stats->budget         = air[t].budget;
+    stats->ms_per_sec     = (float) air[t].last_usecs * 1e-3f;
+    stats->max_ms_per_sec = (float) air[t].max_usecs  * 1e-3f;
+    stats->frames         = air[t].frames;
+    stats->stretched      = air[t].stretched;
+    stats->total_usecs    = air[t].total_usecs;
+  }
+
+  return;
+}
+
+/*
+ * A BT5 extended advert with a pack of all of the current messages, in the
+ * same service data wrapper as the legacy adverts.
+ */
+
+#if ID_OD_BT && ID_OD_BLE_PACK
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_ble_pack() {
+
+  int      i, length;
+  uint32_t layout = 0;
+  uint8_t *a;
+
+  for (i = 0; i < ODID_BASIC_ID_MAX_MESSAGES; ++i) {
+
+    if (UAS_data.BasicID[i].UASID[0]) {
+
+      layout |= ID_OD_PACK_BASIC_ID_0 << i;
+    }
+  }
+
+  if ((location_gen)&&(location_status == ODID_SUCCESS)) {
+
+    layout |= ID_OD_PACK_LOCATION;
+  }
+
+  layout |= ID_OD_PACK_SYSTEM;
+
+  if (UAS_data.SelfID.Desc[0]) {
+
+    layout |= ID_OD_PACK_SELF_ID;
+  }
+
+  if (UAS_data.OperatorID.OperatorId[0]) {
+
+    layout |= ID_OD_PACK_OPERATOR_ID;
+  }
+
+  // As many auth. pages as will fit.
+
+  for (i = 0; (i < auth_page_count)&&(i < ODID_AUTH_MAX_PAGES)&&
+              (__builtin_popcount(layout) < ID_OD_PACK_MAX); ++i) {
+
+    layout |= ID_OD_PACK_AUTH << i;
+  }
+
+  // The TX queue holds extended adverts by pointer, so a buffer that the
+  // radio task hasn't sent yet can't be rebuilt. If both are still queued,
+  // this pack is dropped.
+
+#if ID_OD_ASYNC_TX
+  uint32_t tail = tx_tail.load(std::memory_order_acquire);
+
+  for (i = 0; i < 2; ++i) {
+
+    if ((ble_ext_queued[i])&&((int32_t) (tail - ble_ext_entry[i]) > 0)) {
+
+      ble_ext_queued[i] = 0;
+    }
+  }
+
+  if (ble_ext_queued[ble_ext_next ^ 1]) {
+
+    if (ble_ext_queued[ble_ext_next]) {
+
+      ++tx_stats.ble;
+      ++tx_stats.dropped;
+      return -1;
+    }
+
+    ble_ext_next ^= 1;
+  }
+#endif
+
+  a = ble_ext[ble_ext_next ^= 1];
+
+  if ((!(length = build_pack(&a[6],ID_OD_BLE_EXT_SIZE - 6,layout)))||
+      (ble_phy(ID_OD_SLOT_LOCATION,ODID_MESSAGETYPE_PACKED,6 + length) < 0)) {
+
+    return -1;
+  }
+
+  a[0] = 5 + length;
+  a[1] = 0x16;
+  a[2] = 0xfa; // ASTM
+  a[3] = 0xff; //
+  a[4] = 0x0d;
+  a[5] = ++msg_counter[ODID_MESSAGETYPE_PACKED];
+
+#if ID_OD_ASYNC_TX
+  uint32_t head = tx_head.load(std::memory_order_relaxed);
+  int      status;
+
+  if (((status = tx_enqueue(ID_OD_TX_BLE,a,6 + length,ID_OD_PHY_CODED)) == 0)&&(tx_async)) {
+
+    ble_ext_queued[ble_ext_next] = 1;
+    ble_ext_entry[ble_ext_next]  = head;
+  }
+
+  return status;
+#else
+  return tx_enqueue(ID_OD_TX_BLE,a,6 + length,ID_OD_PHY_CODED);
+#endif
+}
+
+#endif
+
+/*
+ * The WiFi frame ring.
+ *
+ * Returns a free buffer, preferably one that already has the pack layout,
+ * otherwise the least recently used. NULL if the radio has all of them.
+ * A layout of 0 means that the whole frame will be rewritten.
+ */
+
+#if ID_OD_WIFI
+
+template <class Backend>
+struct ID_OD_frame_buffer *ID_OpenDrone_T<Backend>::acquire_frame(uint32_t layout) {
+
+  int                        i;
+  uint8_t                    state;
+  uint32_t                   msecs;
+  struct ID_OD_frame_buffer *entry, *buffer = NULL;
+
+  msecs = millis();
+
+  tx_harvest();
+
+  for (i = 0; i < ID_OD_FRAME_BUFFERS; ++i) {
+
+    entry = &frame_ring[i];
+
+    if ((state = entry->state) != ID_OD_FRAME_FREE) {
+
+      // Still in the TX queue, or not long with the backend.
+
+      if ((state == ID_OD_FRAME_QUEUED)||
+          ((msecs - entry->tx_msecs) < ID_OD_TX_TIMEOUT_MS)) {
+
+        continue;
+      }
+
+      entry->state = ID_OD_FRAME_FREE;
+      ++beacon_stats.reclaimed;
+    }
+
+    if ((layout)&&(entry->layout == layout)&&(entry->static_gen == static_gen)) {
+
+      buffer = entry;
+      break;
+    }
+
+    if ((!buffer)||(entry->last_used < buffer->last_used)) {
+
+      buffer = entry;
+    }
+  }
+
+  if (!buffer) {
+
+    ++beacon_stats.busy;
+    wifi_saturated = 1;
+    return NULL;
+  }
+
+  buffer->last_used = ++frame_uses;
+
+  if (!layout) {
+
+    buffer->layout     =
+    buffer->static_gen = 0;
+  }
+
+  return buffer;
+}
+
+//
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::send_frame(struct ID_OD_frame_buffer *buffer,int length) {
+
+  buffer->tx_status = ID_OD_TX_QUEUED;
+  buffer->tx_gen    = buffer->tx_gen + 1;
+  buffer->state     = ID_OD_FRAME_QUEUED;
+
+  return tx_enqueue(ID_OD_TX_WIFI,buffer->frame,length);
+}
+
+/*
+ * Counts the outcomes of the frames that the backend has released since the
+ * last look. Called before a buffer is reused, from the builder's side only.
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::tx_harvest() {
+
+  int                        i, busy = 0;
+  struct ID_OD_frame_buffer *entry;
+
+  for (i = 0; i < ID_OD_FRAME_BUFFERS; ++i) {
+
+    entry = &frame_ring[i];
+
+    if (entry->state != ID_OD_FRAME_FREE) {
+
+      ++busy;
+      continue;
+    }
+
+    switch (entry->tx_status) {
+
+    case ID_OD_TX_QUEUED:
+
+      continue;
+
+    case ID_OD_TX_SENT:
+
+      ++tx_stats.wifi_sent;
+      break;
+
+    case ID_OD_TX_DROPPED:
+
+      ++tx_stats.wifi_dropped;
+      wifi_saturated = 1;
+      break;
+
+    default:
+
+      ++tx_stats.wifi_failed;
+      break;
+    }
+
+    entry->tx_status = ID_OD_TX_QUEUED;
+  }
+
+  if (busy >= (ID_OD_FRAME_BUFFERS - 1)) {
+
+    wifi_saturated = 1;
+  }
+
+  return;
+}
+
+/*
+ * Whether the radio has dropped a frame, or had all of the buffers or a
+ * half full TX queue, since the last interval. Clears the drop flag.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::tx_saturated() {
+
+  int saturated;
+
+  tx_harvest();
+
+  saturated      = wifi_saturated;
+  wifi_saturated = 0;
+
+#if ID_OD_ASYNC_TX
+  if ((tx_async)&&
+      ((tx_head.load(std::memory_order_relaxed) - tx_tail.load(std::memory_order_acquire)) >= (ID_OD_TX_QUEUE / 2))) {
+
+    saturated = 1;
+  }
+#endif
+
+  return saturated;
+}
+
+/*
+ * Brings the message pack in a buffer up to date. If the buffer doesn't have
+ * the layout, the header (payload bytes, up to the pack) is copied in and the
+ * pack assembled, otherwise only the Location and System messages that have
+ * been re-encoded are copied. Returns the pack's length and adds the bytes
+ * written to *written.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::frame_pack(struct ID_OD_frame_buffer *buffer,const uint8_t *header,int payload,
+                                        uint32_t frame_type,uint32_t layout,int max_length,
+                                        struct ID_OD_beacon_stats *stats,int *written) {
+
+  int      length;
+  uint8_t *frame;
+
+  frame = buffer->frame;
+
+  if ((buffer->layout != (frame_type | layout))||(buffer->static_gen != static_gen)) {
+
+    memcpy(frame,header,payload);
+
+    length               = build_pack(&frame[payload],max_length,layout);
+    buffer->layout       = frame_type | layout;
+    buffer->static_gen   = static_gen;
+    buffer->location_gen = location_gen;
+    buffer->system_gen   = system_gen;
+    buffer->length       = length;
+    buffer->location     = (layout & ID_OD_PACK_LOCATION) ?
+                           payload + 3 +
+                           (ODID_MESSAGE_SIZE * __builtin_popcount(layout & (ID_OD_PACK_LOCATION - 1))): 0;
+    buffer->system       = (layout & ID_OD_PACK_SYSTEM) ?
+                           payload + 3 +
+                           (ODID_MESSAGE_SIZE * __builtin_popcount(layout & (ID_OD_PACK_SYSTEM - 1))): 0;
+
+    *written            += payload + length;
+    ++stats->rebuilds;
+
+  } else {
+
+    length = buffer->length;
+
+    if ((buffer->location)&&(buffer->location_gen != location_gen)) {
+
+      memcpy(&frame[buffer->location],&location_enc,ODID_MESSAGE_SIZE);
+      buffer->location_gen = location_gen;
+      *written            += ODID_MESSAGE_SIZE;
+      ++stats->location_copies;
+    }
+
+    if ((buffer->system)&&(buffer->system_gen != system_gen)) {
+
+      memcpy(&frame[buffer->system],&system_enc,ODID_MESSAGE_SIZE);
+      buffer->system_gen = system_gen;
+      *written          += ODID_MESSAGE_SIZE;
+      ++stats->system_copies;
+    }
+  }
+
+  return length;
+}
+
+#endif
+
+/*
+ * The TX queue. It has a single producer, transmit(), and a single consumer,
+ * the radio task, so head and tail are only written by one side each.
+ */
+
+static inline struct ID_OD_frame_buffer *frame_buffer(uint8_t *frame) {
+
+  return (struct ID_OD_frame_buffer *) (frame - offsetof(struct ID_OD_frame_buffer,frame));
+}
+
+// A WiFi frame leaves the queue for the backend, the reclaim timeout starts.
+
+static void frame_handover(uint8_t *frame) {
+
+  struct ID_OD_frame_buffer *buffer = frame_buffer(frame);
+
+  buffer->tx_msecs = millis();
+  buffer->state    = ID_OD_FRAME_TX;
+
+  return;
+}
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::tx_enqueue(int type,uint8_t *data,int length,int phy) {
+
+  int status;
+
+  if (type == ID_OD_TX_WIFI) {
+
+    ++tx_stats.wifi;
+
+  } else {
+
+    ++tx_stats.ble;
+  }
+
+#if ID_OD_ASYNC_TX
+
+  uint32_t               head, depth, cycles;
+  struct ID_OD_tx_entry *entry;
+
+  if (tx_async) {
+
+    cycles = tx_cycles();
+    head   = tx_head.load(std::memory_order_relaxed);
+    depth  = head - tx_tail.load(std::memory_order_acquire);
+
+    if (depth >= ID_OD_TX_QUEUE) {
+
+      ++tx_stats.dropped;
+
+      if (type == ID_OD_TX_WIFI) {
+
+        id_od_tx_done(data,ID_OD_TX_DROPPED,id_od_tx_gen(data));
+      }
+
+      return -1;
+    }
+
+    entry         = &tx_queue[head & (ID_OD_TX_QUEUE - 1)];
+    entry->type   = type;
+    entry->phy    = phy;
+    entry->length = length;
+
+    if ((type == ID_OD_TX_WIFI)||(length > ID_OD_TX_BLE_MAX)) {
+
+      entry->frame = data;
+
+    } else {
+
+      memcpy(entry->ble,data,length);
+    }
+
+    air_account(type,length,phy);
+
+    tx_head.store(head + 1,std::memory_order_release);
+
+    Backend::wake_tx_task();
+
+    cycles                  = tx_cycles() - cycles;
+    tx_stats.enqueue_total += cycles;
+
+    if (cycles > tx_stats.enqueue_max) {
+
+      tx_stats.enqueue_max = cycles;
+    }
+
+    if (++depth > tx_stats.depth_max) {
+
+      tx_stats.depth_max = depth;
+    }
+
+    return 0;
+  }
+
+#endif
+
+  air_account(type,length,phy);
+
+  ++tx_stats.sent;
+
+  if (type == ID_OD_TX_WIFI) {
+
+    frame_handover(data);
+
+    return Backend::transmit_wifi(data,length);
+  }
+
+  if ((status = Backend::transmit_ble(data,length,phy)) != 0) {
+
+    ++tx_stats.ble_failed;
+  }
+
+  return status;
+}
+
+#if ID_OD_ASYNC_TX
+
+/*
+ * Runs on the radio task. Returns the number of frames sent.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::tx_service() {
+
+  int                    n = 0;
+  uint32_t               tail;
+  struct ID_OD_tx_entry *entry;
+
+  tail = tx_tail.load(std::memory_order_relaxed);
+
+  while (tail != tx_head.load(std::memory_order_acquire)) {
+
+    entry = &tx_queue[tail & (ID_OD_TX_QUEUE - 1)];
+
+    if (entry->type == ID_OD_TX_WIFI) {
+
+      frame_handover(entry->frame);
+      Backend::transmit_wifi(entry->frame,entry->length);
+
+    } else if (Backend::transmit_ble((entry->length > ID_OD_TX_BLE_MAX) ? entry->frame: entry->ble,
+                                     entry->length,entry->phy) != 0) {
+
+      ++tx_stats.ble_failed;
+    }
+
+    tx_tail.store(++tail,std::memory_order_release);
+
+    ++tx_stats.sent;
+    ++n;
+  }
+
+  return n;
+}
+
+//
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::tx_task(void *arg) {
+
+  return ((ID_OpenDrone_T<Backend> *) arg)->tx_service();
+}
+
+#endif
+
+/*
+ * Waits for the radio task to empty the queue.
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::flush_tx() {
+
+#if ID_OD_ASYNC_TX
+
+  while ((tx_async)&&
+         (tx_head.load(std::memory_order_acquire) != tx_tail.load(std::memory_order_acquire))) {
+
+    delay(1);
+  }
+
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_tx_stats(struct ID_OD_tx_stats *stats) {
+
+  memcpy(stats,&tx_stats,sizeof(struct ID_OD_tx_stats));
+
+#if ID_OD_ASYNC_TX
+  stats->depth = tx_head.load(std::memory_order_relaxed) - tx_tail.load(std::memory_order_relaxed);
+#endif
+
+  return;
+}
+
+/*
+ * Engine mode.
+ *
+ * The update_*() functions write engine_data, transmit() takes a copy of it.
+ * With the engine running, the copy is made on the engine task and a sequence
+ * count (odd while an update is in progress) tells it if it got a torn copy.
+ * If it can't get a clean copy, it uses the last one rather than wait for a
+ * writer which may be on the same core.
+ *
+ * Call init(), set_self_id() and set_auth() before start() and don't call
+ * transmit() after it.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::start(uint16_t tick_ms) {
+
+#if ID_OD_ENGINE
+
+  if (engine_running) {
+
+    return 0;
+  }
+
+  if (tick_ms) {
+
+    engine_stats.tick_ms = tick_ms;
+
+    if (Backend::start_engine(engine_task,this,tick_ms) == 0) {
+
+      engine_running = 1;
+
+      return 0;
+    }
+  }
+
+#endif
+
+  return -1;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::update_begin() {
+
+#if ID_OD_ENGINE
+  engine_seq.store(engine_seq.load(std::memory_order_relaxed) + 1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::update_end() {
+
+  ++engine_stats.updates;
+
+#if ID_OD_ENGINE
+  engine_seq.store(engine_seq.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+#endif
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::update_location(double latitude,double longitude,float alt_msl_m,float alt_agl_m,
+                                   int speed_kn,int heading,int satellites) {
+
+  update_begin();
+
+  engine_data.latitude_d  = latitude;
+  engine_data.longitude_d = longitude;
+  engine_data.alt_msl_m   = alt_msl_m;
+  engine_data.alt_agl_m   = alt_agl_m;
+  engine_data.speed_kn    = speed_kn;
+  engine_data.heading     = heading;
+  engine_data.satellites  = satellites;
+
+  update_end();
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::update_operator_location(double latitude,double longitude,float alt_m) {
+
+  update_begin();
+
+  engine_data.base_latitude  = latitude;
+  engine_data.base_longitude = longitude;
+  engine_data.base_alt_m     = alt_m;
+  engine_data.base_valid     = 1;
+
+  update_end();
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::update_time(int years,int months,int days,int hours,int minutes,int seconds,int csecs) {
+
+  update_begin();
+
+  engine_data.years   = years;
+  engine_data.months  = months;
+  engine_data.days    = days;
+  engine_data.hours   = hours;
+  engine_data.minutes = minutes;
+  engine_data.seconds = seconds;
+  engine_data.csecs   = csecs;
+
+  update_end();
+
+  return;
+}
+
+/*
+ * Transmits the data given to the update_*() functions.
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit() {
+
+#if ID_OD_ENGINE
+
+  int      i;
+  uint32_t seq;
+
+  for (i = 0; i < 2; ++i) {
+
+    seq = engine_seq.load(std::memory_order_acquire);
+
+    if (!(seq & 1)) {
+
+      memcpy(&engine_snapshot,&engine_data,sizeof(engine_snapshot));
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (engine_seq.load(std::memory_order_relaxed) == seq) {
+
+        break;
+      }
+    }
+
+    ++engine_stats.retries;
+  }
+
+#else
+
+  memcpy(&engine_snapshot,&engine_data,sizeof(engine_snapshot));
+
+#endif
+
+  // transmit() only takes the operator's location once, this lets it move.
+
+  if ((system_data->OperatorLatitude)&&(engine_snapshot.base_valid)) {
+
+    id_od_update(system_data->OperatorLatitude,engine_snapshot.base_latitude,&system_dirty,ID_OD_SYS_OPERATOR);
+    id_od_update(system_data->OperatorLongitude,engine_snapshot.base_longitude,&system_dirty,ID_OD_SYS_OPERATOR);
+    id_od_update(system_data->OperatorAltitudeGeo,engine_snapshot.base_alt_m,&system_dirty,ID_OD_SYS_OPERATOR);
+
+    if (system_dirty) {
+
+      encode_system();
+    }
+  }
+
+  return transmit(&engine_snapshot);
+}
+
+#if ID_OD_ENGINE
+
+/*
+ * Runs on the engine task.
+ */
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::engine_tick() {
+
+  uint32_t now, late, tick_us;
+
+  now     = micros();
+  tick_us = (uint32_t) engine_stats.tick_ms * 1000;
+
+  if (!engine_stats.ticks) {
+
+    engine_due = now;
+  }
+
+  late = ((int32_t) (now - engine_due) > 0) ? now - engine_due: 0;
+
+  engine_stats.late_total_us += late;
+
+  if (late > engine_stats.late_max_us) {
+
+    engine_stats.late_max_us = late;
+  }
+
+  // Don't try to make up for lost ticks.
+
+  engine_due = (late < tick_us) ? engine_due + tick_us: now + tick_us;
+
+  ++engine_stats.ticks;
+
+  transmit();
+
+  return;
+}
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::engine_task(void *arg) {
+
+  ((ID_OpenDrone_T<Backend> *) arg)->engine_tick();
+
+  return;
+}
+
+#endif
+
+//
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::get_engine_stats(struct ID_OD_engine_stats *stats) {
+
+  memcpy(stats,&engine_stats,sizeof(struct ID_OD_engine_stats));
+
+  return;
+}
+
+//
+
+uint32_t tx_cycles() {
+
+#if defined(ARDUINO_ARCH_ESP32)
+  return ESP.getCycleCount();
+#elif !defined(ARDUINO)
+  return (uint32_t) host_cycles();
+#else
+  return micros();
+#endif
+}
+
+/*
+ * Called by the backend, possibly from another task, when the radio has
+ * finished with a frame. The outcome is written before the buffer is freed,
+ * tx_harvest() counts it. A release for an earlier send of the buffer, one
+ * that was reclaimed, is counted and ignored.
+ */
+
+void id_od_tx_done(uint8_t *frame,int status,uint32_t gen) {
+
+  struct ID_OD_frame_buffer *buffer;
+
+  buffer = frame_buffer(frame);
+
+  if ((buffer->tx_gen != gen)||(buffer->state == ID_OD_FRAME_FREE)) {
+
+    buffer->stale = buffer->stale + 1;
+    return;
+  }
+
+  buffer->tx_status = (status == ID_OD_TX_QUEUED) ? ID_OD_TX_SENT: status;
+  buffer->state     = ID_OD_FRAME_FREE;
+
+  return;
+}
+
+//
+
+uint32_t id_od_tx_gen(uint8_t *frame) {
+
+  return frame_buffer(frame)->tx_gen;
+}
+
+//
+
+int id_od_tx_live(uint8_t *frame,uint32_t gen) {
+
+  struct ID_OD_frame_buffer *buffer = frame_buffer(frame);
+
+  return (buffer->tx_gen == gen)&&(buffer->state == ID_OD_FRAME_TX);
+}
+
+/*
+ *
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_wifi(struct UTM_data *utm_data,int prepacked,int t) {
+
+#if ID_OD_WIFI
+
+#if ID_OD_WIFI_BEACON
+  int             length = 0, wifi_status = 0;
+#endif
+  uint32_t        msecs;
+  uint64_t        usecs = 0;
+  static uint32_t last_wifi = 0;
+  char text[128];
+
+  text[0] = 0;
+  
+  //
+
+  msecs         = millis();
+  wifi_interval = msecs - last_wifi;
+  last_wifi     = msecs;
+  
+#if not (defined(ARDUINO_ARCH_RP2040) || defined(ARDUINO_ARCH_NRF52))
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME,&ts);
+  usecs = ((uint64_t) ts.tv_sec * 1000000ULL) + (uint32_t) (ts.tv_nsec / 1000);
+#else
+  usecs = micros();
+#endif
+
+#if ID_OD_WIFI_NAN
+
+  if (t == ID_OD_TRANSPORT_NAN) {
+
+    transmit_nan_sync(usecs);
+    transmit_nan_action();
+
+    return 0;
+  }
+
+#endif // NAN
+  
+#if ID_OD_WIFI_BEACON
+
+  if (++sequence > 0xffffff) {
+
+    sequence = 1;
+  }
+
+#if USE_BEACON_FUNC
+
+  uint8_t                   *beacon_frame = NULL;
+  struct ID_OD_frame_buffer *buffer;
+
+  if ((buffer = acquire_frame(0))&&
+      ((length = odid_wifi_build_message_pack_beacon_frame(&UAS_data,(char *) WiFi_mac_addr,
+                                                           ssid,ssid_length,
+                                                           beacon_interval,++beacon_counter,
+                                                           beacon_frame = buffer->frame,
+                                                           BEACON_FRAME_SIZE)) > 0)) {
+
+    wifi_status = send_frame(buffer,length);
+  }
+
+#if DIAGNOSTICS && 1
+
+  if ((Debug_Serial)&&(length > 0)) {
+
+    sprintf(text,"ID_OpenDrone::%s * %02x ... ",__func__,beacon_frame[0]);
+    Debug_Serial->print(text);
+
+    for (int i = 0; i < 20; ++i) {
+
+      sprintf(text,"%02x ",beacon_frame[22 + i]);
+      Debug_Serial->print(text);      
+    }
+
+    Debug_Serial->print(" ... *\r\n");
+  }
+
+#endif // DIAG
+
+#else
+  
+  int                        len2 = 0, written;
+  uint32_t                   layout;
+  uint8_t                   *frame;
+  struct ID_OD_frame_buffer *buffer;
+
+  // Preferably a buffer that already has this pack layout.
+
+  layout = pack_layout();
+
+  if ((buffer = acquire_frame(layout)) == NULL) {
+
+    return 0;
+  }
+
+  frame = buffer->frame;
+  ++beacon_stats.frames;
+
+  written = 0;
+
+#if ID_NATIONAL
+  if (prepacked) {
+
+    memcpy(frame,beacon_frame,beacon_patch.payload);
+
+    length             = pack_encrypt_national(&frame[beacon_patch.payload]);
+    buffer->layout     = 0;
+    buffer->static_gen = 0;
+
+  } else
+#endif
+#if ID_OD_CACHED_PACK
+  {
+    length = frame_pack(buffer,beacon_frame,beacon_patch.payload,0,layout,beacon_max_packed,
+                        &beacon_stats,&written);
+  }
+#else
+  {
+    if (buffer->static_gen != static_gen) {
+
+      memcpy(frame,beacon_frame,beacon_patch.payload);
+      buffer->static_gen = static_gen;
+      written           += beacon_patch.payload;
+    }
+
+    length   = odid_message_build_pack(&UAS_data,&frame[beacon_patch.payload],beacon_max_packed);
+    written += (length > 0) ? length: 0;
+    ++beacon_stats.rebuilds;
+  }
+#endif
+
+  // The volatile header fields.
+
+  frame[beacon_patch.counter] = ++beacon_counter;
+
+  id_od_put_le64(&frame[beacon_patch.timestamp],usecs);
+
+#if 1
+  frame[beacon_patch.seq]     = (uint8_t) (sequence << 4);
+  frame[beacon_patch.seq + 1] = (uint8_t) (sequence >> 4);
+#endif
+
+  written += 1 + 8 + 2;
+
+  if (length > 0) {
+
+    if (frame[beacon_patch.length] != (uint8_t) (length + 5)) {
+
+      frame[beacon_patch.length] = length + 5;
+      ++written;
+    }
+
+    beacon_stats.bytes_written += written;
+
+    wifi_status = send_frame(buffer,len2 = beacon_patch.payload + length);
+  }
+
+#if DIAGNOSTICS && 1
+
+  if (Debug_Serial) {
+
+    sprintf(text,"ID_OpenDrone::%s %d %d+%d=%d ",
+            __func__,beacon_max_packed,beacon_patch.payload,length,len2);
+    Debug_Serial->print(text);
+
+    sprintf(text,"* %02x ... ",frame[0]);
+    Debug_Serial->print(text);
+
+    for (int i = 0; i < 16; ++i) {
+
+      if ((i == 3)||(i == 10)) {
+
+        Debug_Serial->print("| ");
+      }
+
+      sprintf(text,"%02x ",frame[beacon_patch.payload - 10 + i]);
+      Debug_Serial->print(text);
+    }
+
+    sprintf(text,"... %02x (%2d,%4u,%4u)\r\n",frame[len2 - 1],
+            wifi_status,wifi_interval,ble_interval);
+    Debug_Serial->print(text);
+  }
+
+#endif // DIAG
+
+#endif // FUNC
+  
+#endif // BEACON
+
+#endif // WIFI
+
+  return 0;
+}
+
+/*
+ * NAN, the sync beacon and the action frame with the message pack. From the
+ * templates made by init_nan() if it found the fields, otherwise opendroneid
+ * builds them.
+ */
+
+#if ID_OD_WIFI_NAN
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_nan_sync(uint64_t usecs) {
+
+  int                        length = 0, status = -1;
+  char                       text[80];
+  struct ID_OD_frame_buffer *buffer;
+
+  if (nan_patch.sync_length) {
+
+    if ((buffer = acquire_frame(ID_OD_FRAME_NAN_SYNC)) == NULL) {
+
+      return -1;
+    }
+
+    if ((buffer->layout != ID_OD_FRAME_NAN_SYNC)||(buffer->static_gen != static_gen)) {
+
+      memcpy(buffer->frame,nan_sync,nan_patch.sync_length);
+
+      buffer->layout            = ID_OD_FRAME_NAN_SYNC;
+      buffer->static_gen        = static_gen;
+      nan_stats.bytes_written  += nan_patch.sync_length;
+      ++nan_stats.rebuilds;
+    }
+
+    id_od_put_le64(&buffer->frame[24],usecs);
+
+    nan_stats.bytes_written += 8;
+    ++nan_stats.frames;
+
+    return send_frame(buffer,nan_patch.sync_length);
+  }
+
+  if ((buffer = acquire_frame(0))&&
+      ((length = odid_wifi_build_nan_sync_beacon_frame((char *) WiFi_mac_addr,
+                                                       buffer->frame,BEACON_FRAME_SIZE)) > 0)) {
+
+    status = send_frame(buffer,length);
+  }
+
+  if ((Debug_Serial)&&((length < 0)||(status != 0))) {
+
+    sprintf(text,"odid_wifi_build_nan_sync_beacon_frame() = %d, transmit_wifi() = %d\r\n",
+            length,status);
+    Debug_Serial->print(text);
+  }
+
+  return status;
+}
+
+//
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_nan_action() {
+
+  int                        length = 0, status = -1;
+  char                       text[96];
+  struct ID_OD_frame_buffer *buffer;
+
+#if ID_OD_CACHED_PACK
+
+  if (nan_patch.payload) {
+
+    int      i, written = 0;
+    uint32_t layout;
+    uint8_t *frame;
+
+    layout = pack_layout();
+
+    if ((buffer = acquire_frame(ID_OD_FRAME_NAN | layout)) == NULL) {
+
+      return -1;
+    }
+
+    frame  = buffer->frame;
+    length = frame_pack(buffer,nan_action,nan_patch.payload,ID_OD_FRAME_NAN,layout,
+                        BEACON_FRAME_SIZE - nan_patch.payload,&nan_stats,&written);
+
+    if (!length) {
+
+      return -1;
+    }
+
+    for (i = 0; i < nan_patch.lengths; ++i) {
+
+      frame[nan_patch.length[i]] = nan_patch.base[i] + length;
+    }
+
+    frame[nan_patch.counter] = ++nan_counter;
+
+    nan_stats.bytes_written += written + nan_patch.lengths + 1;
+    ++nan_stats.frames;
+
+    return send_frame(buffer,nan_patch.payload + length);
+  }
+
+#endif
+
+  if ((buffer = acquire_frame(0))&&
+      ((length = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,(char *) WiFi_mac_addr,
+                                                               ++nan_counter,
+                                                               buffer->frame,
+                                                               BEACON_FRAME_SIZE)) > 0)) {
+
+    status = send_frame(buffer,length);
+  }
+
+  if (Debug_Serial) {
+
+    if ((length < 0)||(status != 0)) {
+
+      sprintf(text,"odid_wifi_build_message_pack_nan_action_frame() = %d, transmit_wifi() = %d\r\n",
+              length,status);
+      Debug_Serial->print(text);
+
+#if DIAGNOSTICS
+
+    } else if (length > 0) {
+
+      sprintf(text,"ID_OpenDrone::%s ... ",__func__);
+      Debug_Serial->print(text);
+
+      for (int i = 0; i < 32; ++i) {
+
+        sprintf(text,"%02x ",buffer->frame[16 + i]);
+        Debug_Serial->print(text);
+      }
+
+      Debug_Serial->print(" ... \r\n");
+
+#endif
+    }
+  }
+
+  return status;
+}
+
+#endif
+
+/*
+ *
+ */
+
+template <class Backend>
+int ID_OpenDrone_T<Backend>::transmit_ble(int slot,uint8_t *odid_msg,int length) {
+
+  uint32_t        msecs;
+  static uint32_t last_ble;
+  
+  msecs        = millis();
+  ble_interval = msecs - last_ble;
   last_ble     = msecs;
 
 #if ID_OD_BT
 
-  int         i, j, k, len, status;
+  // Legacy adverts off, the slots are only encoding for the other transports.
+
+  if (!transport[ID_OD_TRANSPORT_BLE].period_ms) {
+
+    return 0;
+  }
+
+  int         i, j, k, len, status, phy;
   uint8_t    *a;
 
   i = j = k = len = 0;
+
+#if ID_OD_BLE_ADV_CACHE
+
+  uint32_t gen;
+
+  gen = (slot == ID_OD_SLOT_LOCATION) ? location_gen:
+        (slot == ID_OD_SLOT_SYSTEM)   ? system_gen: static_gen;
+
+  a = ble_adv[slot];
+
+  if (ble_adv_gen[slot] != gen) {
+
+    a[0] = 0x1e;
+    a[1] = 0x16;
+    a[2] = 0xfa; // ASTM
+    a[3] = 0xff; //
+    a[4] = 0x0d;
+
+    memcpy(&a[6],odid_msg,(length < (ID_OD_BLE_ADV_SIZE - 6)) ? length: ID_OD_BLE_ADV_SIZE - 6);
+
+    ble_adv_gen[slot] = gen;
+  }
+
+  if ((phy = ble_phy(slot,odid_msg[0] >> 4,ID_OD_BLE_ADV_SIZE)) < 0) {
+
+    return -1;
+  }
+
+  a[5]   = ++msg_counter[odid_msg[0] >> 4];
+
+  status = tx_enqueue(ID_OD_TX_BLE,a,len = ID_OD_BLE_ADV_SIZE,phy);
+
+#else
+
   a = ble_message;
 
   memset(ble_message,0,sizeof(ble_message));
@@ -870,7 +3367,14 @@ int ID_OpenDrone::transmit_ble(uint8_t *odid_msg,int length) {
     ble_message[j] = odid_msg[i];
   }
 
-  status = transmit_ble2(ble_message,len = j); 
+  if ((phy = ble_phy(slot,odid_msg[0] >> 4,j)) < 0) {
+
+    return -1;
+  }
+
+  status = tx_enqueue(ID_OD_TX_BLE,ble_message,len = j,phy); 
+
+#endif
 
 #if DIAGNOSTICS && 0
 
@@ -918,6 +3422,19 @@ int ID_OpenDrone::transmit_ble(uint8_t *odid_msg,int length) {
   return 0;
 }
 
+/*
+ * The backends that this library is built for. The host also has the null
+ * backend, for timing the core on its own.
+ */
+
+#if defined(ID_OD_BACKEND)
+template class ID_OpenDrone_T<ID_OD_BACKEND>;
+#endif
+
+#if defined(ID_OD_NULL_BACKEND)
+template class ID_OpenDrone_T<ID_OD_Null>;
+#endif
+
 /*
  *
  */
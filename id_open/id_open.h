@@ -25,6 +25,8 @@
 #define USE_BEACON_FUNC   0
 #define ESP32_WIFI_OPTION 0
 
+#define ID_OD_BACKEND     ID_OD_ESP32
+
 #elif defined(ARDUINO_ARCH_ESP8266)
 
 #define ID_OD_WIFI_NAN    0
@@ -33,6 +35,8 @@
 
 #define USE_BEACON_FUNC   0
 
+#define ID_OD_BACKEND     ID_OD_ESP8266
+
 #elif defined(ARDUINO_ARCH_RP2040)
 
 // The Pico doesn't have BT and the NAN/OD beacon code needs work to get it to compile for the Pico.
@@ -43,6 +47,10 @@
 
 #define USE_BEACON_FUNC   0
 
+// No WiFi backend yet, the null backend builds the frames and sends nothing.
+
+#define ID_OD_BACKEND     ID_OD_Null
+
 #elif defined(ARDUINO_ARCH_NRF52)
 
 #define ID_OD_WIFI_NAN    0
@@ -51,6 +59,34 @@
 
 #define USE_BEACON_FUNC   0
 
+#define ID_OD_BACKEND     ID_OD_nRF52
+
+#elif !defined(ARDUINO)
+
+// Host (Linux) build using the recording backend in id_open_host.cpp, see host/README.md.
+// The transports can be selected with -D on the compiler command line.
+
+#if !defined(ID_OD_WIFI_NAN)
+#define ID_OD_WIFI_NAN    0
+#endif
+
+#if !defined(ID_OD_WIFI_BEACON)
+#define ID_OD_WIFI_BEACON 1
+#endif
+
+#if !defined(ID_OD_BT)
+#define ID_OD_BT          0
+#endif
+
+#if !defined(USE_BEACON_FUNC)
+#define USE_BEACON_FUNC   0
+#endif
+
+#if !defined(ID_OD_BACKEND)
+#define ID_OD_BACKEND     ID_OD_Host  // Or ID_OD_Null.
+#define ID_OD_NULL_BACKEND 1          // Also built with ID_OD_Null, for the benchmark.
+#endif
+
 #else
 
 error "No configuration for this processor."
@@ -76,8 +112,28 @@ error "No configuration for this processor."
 
 #define WIFI_CHANNEL      6        // Be careful changing this.
 #define BEACON_FRAME_SIZE 512
+#define BEACON_TEMPLATE_SIZE 160   // The beacon header and tags, up to the pack.
 #define BEACON_INTERVAL   0        // ms, defaults to 500. Android apps would prefer 100ms.
 
+#if !defined(ID_OD_WIFI_BURST)
+#define ID_OD_WIFI_BURST  1        // Most WiFi packs per beacon interval.
+#endif
+
+// WiFi message packing. Location goes in every pack and the static messages
+// are rotated through the packs, as few in each as will send every one at
+// least every ID_OD_WIFI_STATIC_MS (0 for all of them in every interval).
+
+#if !defined(ID_OD_WIFI_STATIC_MS)
+#define ID_OD_WIFI_STATIC_MS 3000
+#endif
+
+// The statics are split into no more than ID_OD_WIFI_GROUPS groups on each
+// transport, each group a pack layout that keeps a frame buffer.
+
+#if !defined(ID_OD_WIFI_GROUPS)
+#define ID_OD_WIFI_GROUPS    4
+#endif
+
 // Used by the id_open_beacon and id_open_esp32.
  
 #if ID_JAPAN
@@ -90,36 +146,481 @@ error "No configuration for this processor."
 
 #define ID_OD_AUTH_DATUM  1546300800LU
 
+// Take the time from the GNSS rather than time(). The default for the
+// processors that don't have a clock set by anything else.
+
+#if !defined(ID_OD_GNSS_CLOCK)
+#if defined(ARDUINO_ARCH_NRF52) || defined(ARDUINO_ARCH_ESP8266)
+#define ID_OD_GNSS_CLOCK  1
+#else
+#define ID_OD_GNSS_CLOCK  0
+#endif
+#endif
+
+// Build the WiFi message packs from the messages already encoded for BLE
+// rather than with odid_message_build_pack().
+
+#if !defined(ID_OD_CACHED_PACK)
+#define ID_OD_CACHED_PACK 1
+#endif
+
+// Asynchronous transmission. transmit() only queues the frames, a radio task
+// (ESP32, pinned to the other core) or thread (host) makes the backend calls.
+// Elsewhere, or if the task can't be started, the calls are made directly.
+
+#if !defined(ID_OD_ASYNC_TX)
+#if defined(ARDUINO_ARCH_ESP32) || !defined(ARDUINO)
+#define ID_OD_ASYNC_TX    1
+#else
+#define ID_OD_ASYNC_TX    0
+#endif
+#endif
+
+#if !defined(ID_OD_TX_QUEUE)
+#define ID_OD_TX_QUEUE    16       // Power of 2.
+#endif
+
+#define ID_OD_TX_BLE_MAX  40
+
+#define ID_OD_TX_WIFI      1
+#define ID_OD_TX_BLE       2
+
+// What became of a WiFi frame. Backend::transmit_wifi() returns one of these
+// and passes the outcome to id_od_tx_done() when it releases the buffer.
+// The core counts them and, while the radio is dropping frames or has all
+// of the buffers, defers the static messages for up to ID_OD_TX_DEFER_MAX
+// intervals so that location still gets out.
+
+#define ID_OD_TX_QUEUED    0       // With the driver, the outcome is to come.
+#define ID_OD_TX_SENT      1
+#define ID_OD_TX_DROPPED   2       // No room in the TX queue or the driver's.
+#define ID_OD_TX_FAILED    3
+
+#if !defined(ID_OD_TX_DEFER_MAX)
+#define ID_OD_TX_DEFER_MAX 2
+#endif
+
+// Engine mode. start() has transmit() called every tick by a FreeRTOS task
+// (ESP32) or a thread (host) and the application pushes new data with the
+// update_*() functions. Elsewhere start() returns -1 and the application
+// calls transmit() with no arguments from loop() to send the pushed data.
+
+#if !defined(ID_OD_ENGINE)
+#define ID_OD_ENGINE      ID_OD_ASYNC_TX
+#endif
+
+#define ID_OD_ENGINE_TICK_MS 25    // A third of ID_OD_BLE_SLOT_MS.
+
+// BLE adverts are kept in a buffer per scheduler slot. The Location and
+// System messages are copied in when they are re-encoded, the rest when
+// the static messages change, and only the counter is written per advert.
+
+#if !defined(ID_OD_BLE_ADV_CACHE)
+#define ID_OD_BLE_ADV_CACHE  1
+#endif
+
+#define ID_OD_BLE_ADV_SIZE    31   // Flags, service data header, counter and a message.
+
+// ESP32, change the advertising data while advertising rather than stop,
+// configure and restart for each advert.
+
+#if !defined(ID_OD_BLE_IN_PLACE)
+#define ID_OD_BLE_IN_PLACE    1
+#endif
+
+// BT5, build in the extended advert transport, one advert carrying a pack
+// with all of the current messages, on the coded PHY where the backend
+// supports it. It is then the default BLE transport, rather than a legacy
+// advert per slot (see the rate plan below). The nRF52 and the BT5 ESP32s
+// (C3, S3, C6) can send it, it is an error on the original ESP32.
+
+#if !defined(ID_OD_BLE_PACK)
+#define ID_OD_BLE_PACK        0
+#endif
+
+// The most messages in a pack. If ODID_PACK_MAX_MESSAGES == 10, a pack is
+// too long for the one byte length of the beacon's IE or the advert's AD.
+
+#define ID_OD_PACK_MAX       ((ODID_PACK_MAX_MESSAGES > 9) ? 9: ODID_PACK_MAX_MESSAGES)
+
+#define ID_OD_BLE_EXT_SIZE   (6 + 3 + (ID_OD_PACK_MAX * ODID_MESSAGE_SIZE))
+#define ID_OD_BLE_EXT_MS      300  // Default period, the Location message's.
+
+// BT4/BT5 interleaving. For each message type, coded of every period adverts
+// go out as BT5 extended adverts on the coded PHY, spread evenly, and each
+// PHY can have a budget of adverts per second. An advert over its PHY's
+// budget goes on the other if that has room, otherwise it is dropped.
+// Packs are always coded. The default is alternate on processors that can
+// send coded (nRF52), otherwise legacy.
+
+#define ID_OD_PHY_LEGACY         0 // BT4, 1M.
+#define ID_OD_PHY_CODED          1 // BT5, extended on the coded PHY.
+#define ID_OD_PHYS               2
+
+#define ID_OD_BLE_LEGACY         0 // Presets.
+#define ID_OD_BLE_ALTERNATE      1
+#define ID_OD_BLE_LOCATION_LEGACY 2 // Location legacy, everything else coded.
+
+#if !defined(ID_OD_BLE_CODED)
+#if defined(ARDUINO_ARCH_NRF52)
+#define ID_OD_BLE_CODED          1
+#else
+#define ID_OD_BLE_CODED          0
+#endif
+#endif
+
+// Airtime planner. The airtime of every frame is worked out as it is queued,
+// WiFi at the lowest basic rate in Backend::rates. A budget, in 1/1000ths of each
+// second, holds a transport's next interval back until its airtime is paid for.
+
+#define ID_OD_AIR_WIFI           0
+#define ID_OD_AIR_BLE            1
+#define ID_OD_AIRS               2
+
+// Transports. ID_OD_WIFI_BEACON, ID_OD_WIFI_NAN, ID_OD_BT and ID_OD_BLE_PACK
+// decide which are built in, a rate plan, which can be changed at run time,
+// decides which of those are sent and how often (a period of 0 is off).
+// Every transport that is due is sent in order of how long it has been due,
+// unless its airtime budget holds it back.
+
+#define ID_OD_TRANSPORT_NAN      0
+#define ID_OD_TRANSPORT_BEACON   1
+#define ID_OD_TRANSPORT_BLE      2 // Legacy adverts, a message in each.
+#define ID_OD_TRANSPORT_BLE_EXT  3 // Extended adverts carrying a pack.
+#define ID_OD_TRANSPORTS         4
+
+// BLE message scheduler.
+
+#define ID_OD_BLE_SLOT_MS      75  // Minimum time between BLE messages.
+#define ID_OD_CATCH_UP_MAX      2  // Periods that a late message may catch up.
+
+#define ID_OD_SCHED_SKIP        0  // Messages that miss their deadline are dropped.
+#define ID_OD_SCHED_CATCH_UP    1  // Messages that miss their deadline are sent late.
+
 //
 
 #include "utm.h"
 
 #include "opendroneid.h"
 
-//
-// Functions in a processor specific file.
-//
+#include "alt_unix_time.h"
+
+static_assert(alt_secs_from_civil(2019,1,1,0,0,0) == ID_OD_AUTH_DATUM,"ID_OD_AUTH_DATUM isn't 1/1/2019");
+static_assert((5 + 3 + (ID_OD_PACK_MAX * ODID_MESSAGE_SIZE)) <= 255,"A pack doesn't fit in an IE or AD");
+
+#if ID_OD_ASYNC_TX || ID_OD_ENGINE
+#include <atomic>
+#endif
+
+// Scheduler slots, one per message (and auth. page).
+
+#define ID_OD_SLOT_LOCATION     0
+#define ID_OD_SLOT_SYSTEM       1
+#define ID_OD_SLOT_BASIC_ID_0   2
+#define ID_OD_SLOT_BASIC_ID_1   3
+#define ID_OD_SLOT_SELF_ID      4
+#define ID_OD_SLOT_OPERATOR_ID  5
+#define ID_OD_SLOT_AUTH         6
+#define ID_OD_SLOTS            (ID_OD_SLOT_AUTH + ODID_AUTH_MAX_PAGES)
+
+struct ID_OD_schedule {
+
+  uint16_t period_ms, deadline_ms;
+  uint32_t sent, late, skipped;
+  uint64_t due, first_sent, last_sent;
+};
+
+// Change tracking, the fields that the encoded Location and System messages depend on.
+
+#define ID_OD_LOCN_STATUS       0x0001
+#define ID_OD_LOCN_DIRECTION    0x0002
+#define ID_OD_LOCN_SPEED_H      0x0004
+#define ID_OD_LOCN_SPEED_V      0x0008
+#define ID_OD_LOCN_LATITUDE     0x0010
+#define ID_OD_LOCN_LONGITUDE    0x0020
+#define ID_OD_LOCN_HEIGHT       0x0040
+#define ID_OD_LOCN_ALTITUDE     0x0080
+#define ID_OD_LOCN_TIMESTAMP    0x0100
+
+#define ID_OD_SYS_OPERATOR      0x0001
+#define ID_OD_SYS_TIMESTAMP     0x0002
+
+struct ID_OD_encode_stats {
+
+  uint32_t location_encodes, location_patches, location_skipped,
+           system_encodes,   system_patches,   system_skipped;
+};
+
+template <typename T,typename U> inline void id_od_update(T &field,U value,uint16_t *dirty,uint16_t bit) {
+
+  if (field != (T) value) {
+
+    field   = (T) value;
+    *dirty |= bit;
+  }
 
-void     construct2(void);
-void     init2(char *,int,uint8_t *,uint8_t);
-uint8_t *capability(void);
-int      tag_rates(uint8_t *,int);
-int      tag_ext_rates(uint8_t *,int);
-int      misc_tags(uint8_t *,int);
-int      transmit_wifi2(uint8_t *,int);
-int      transmit_ble2(uint8_t *,int);
+  return;
+}
 
+// Message packs, one bit per message in pack order.
+
+#define ID_OD_PACK_BASIC_ID_0   0x0001
+#define ID_OD_PACK_BASIC_ID_1   0x0002
+#define ID_OD_PACK_LOCATION     0x0004
+#define ID_OD_PACK_AUTH         0x0008  // One bit per page.
+#define ID_OD_PACK_SELF_ID     (ID_OD_PACK_AUTH << ODID_AUTH_MAX_PAGES)
+#define ID_OD_PACK_SYSTEM      (ID_OD_PACK_SELF_ID << 1)
+#define ID_OD_PACK_OPERATOR_ID (ID_OD_PACK_SYSTEM << 1)
+#define ID_OD_PACK_MESSAGES    (ODID_AUTH_MAX_PAGES + 6)
+
+// WiFi frames are built in a ring of buffers. A buffer handed to
+// Backend::transmit_wifi() belongs to the radio until the backend calls
+// id_od_tx_done(), so the next frame can be built while one is on air.
 //
+// For beacons, init_beacon() builds a template and, after that, only the
+// bytes in the patch list are written for each frame. Each buffer keeps
+// the pack for one layout so that the frames of the static rotation aren't
+// rebuilt. There is a buffer for each group of each WiFi transport, one for
+// the NAN sync beacon and one a transport for a frame still on air or a
+// pack of location only. Fewer and the least recently used layout is the
+// next one wanted.
+
+#if !defined(ID_OD_FRAME_BUFFERS)
+#define ID_OD_FRAME_BUFFERS     ((ID_OD_WIFI_BEACON + ID_OD_WIFI_NAN) * (ID_OD_WIFI_GROUPS + 1) + ID_OD_WIFI_NAN)
+#endif
+
+#define ID_OD_TX_TIMEOUT_MS   100  // Reclaim a buffer if the backend hasn't released it.
+
+// A buffer in the TX queue is never reclaimed, the timeout runs from when
+// it is handed to the backend. Each send has a generation that the backend
+// gives back with id_od_tx_done(), so a late release of a buffer that has
+// been reclaimed, and perhaps sent again, is ignored.
+
+#define ID_OD_FRAME_FREE        0  // Owned by the builder.
+#define ID_OD_FRAME_QUEUED      1  // In the TX queue.
+#define ID_OD_FRAME_TX          2  // Owned by the backend.
+
+struct ID_OD_beacon_patch {
+
+  uint16_t seq, timestamp, counter, length, payload; // Offsets into the frame.
+};
+
+struct ID_OD_frame_buffer {
+
+  volatile uint8_t state, tx_status;
+  volatile uint32_t tx_msecs, tx_gen, stale;        // stale, late releases ignored.
+  uint32_t layout, last_used, static_gen, location_gen, system_gen;
+  uint16_t length, location, system;                 // Pack length, message offsets.
+  uint8_t  frame[BEACON_FRAME_SIZE];
+};
+
+struct ID_OD_beacon_stats {
+
+  uint32_t frames, rebuilds, location_copies, system_copies, busy, reclaimed, stale;
+  uint64_t bytes_written;
+};
+
+// NAN. init() has opendroneid build the sync beacon and an action frame and
+// keeps them as templates, the action frame up to the message pack. After
+// that, a frame is the template with the pack assembled from the encoded
+// messages and the counter, the lengths that count the pack and the sync
+// beacon's timestamp written. The buffers keep their layouts, as beacons do.
+// If the fields can't be found, opendroneid builds every frame as before.
+
+#define ID_OD_NAN_TEMPLATE_SIZE 96
+#define ID_OD_NAN_LENGTHS        4
+
+#define ID_OD_FRAME_NAN         0x40000000UL  // Frame buffer layouts.
+#define ID_OD_FRAME_NAN_SYNC    0x80000000UL
+
+struct ID_OD_nan_patch {
+
+  uint16_t sync_length, payload, counter;       // payload, the pack's offset, 0 if not found.
+  uint8_t  lengths, base[ID_OD_NAN_LENGTHS];    // base, the length field less the pack's length.
+  uint16_t length[ID_OD_NAN_LENGTHS];
+};
+
+inline void id_od_put_le64(uint8_t *field,uint64_t value) {
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(field,&value,8);
+#else
+  for (int i = 0; i < 8; ++i) {
+
+    field[i] = (value >> (i * 8)) & 0xff;
+  }
+#endif
+
+  return;
+}
 
-class ID_OpenDrone {
+struct ID_OD_pack_stats {
+
+  uint8_t  statics;           // Static messages to rotate.
+  uint16_t rotation;          // Intervals to send all of them.
+  uint32_t intervals, frames, messages, late; // messages, statics sent. late, over ID_OD_WIFI_STATIC_MS.
+  uint32_t deferred;          // Intervals that sent only location, the radio being busy.
+  uint32_t static_max_ms;     // Longest between a static's frames.
+};
+
+struct ID_OD_wifi_packer {
+
+  uint8_t  cursor, groups;            // The next group of statics and how many there are.
+  uint8_t  deferred;
+  uint32_t sent_msecs[ID_OD_PACK_MESSAGES];
+  struct ID_OD_pack_stats stats;
+};
+
+// A queued frame. WiFi frames stay in the frame ring, BLE adverts are copied
+// unless they are longer than ID_OD_TX_BLE_MAX (extended adverts).
+
+struct ID_OD_tx_entry {
+
+  uint8_t  type, phy;
+  uint16_t length;
+  uint8_t *frame;
+  uint8_t  ble[ID_OD_TX_BLE_MAX];
+};
+
+struct ID_OD_tx_stats {
+
+  uint32_t wifi, ble, sent, dropped, depth, depth_max;
+  uint32_t wifi_sent, wifi_dropped, wifi_failed, ble_failed; // Outcomes from the backend.
+  uint32_t enqueue_max;   // CPU cycles (micros() if there isn't a cycle counter).
+  uint64_t enqueue_total;
+};
+
+struct ID_OD_engine_stats {
+
+  uint16_t tick_ms;
+  uint32_t ticks, updates, retries; // retries, snapshots re-read because of an update.
+  uint32_t late_max_us;             // Ticks against their schedule.
+  uint64_t late_total_us;
+};
+
+struct ID_OD_ble_policy {
+
+  uint8_t  coded[16], period[16];  // By message type.
+  uint16_t budget[ID_OD_PHYS];     // Adverts per second, 0 for no limit.
+};
+
+struct ID_OD_ble_phy_stats {
+
+  uint32_t sent[ID_OD_PHYS], diverted[ID_OD_PHYS], dropped; // diverted, away from the PHY.
+};
+
+struct ID_OD_airtime {
+
+  uint8_t  held;
+  uint16_t budget;
+  uint32_t usecs, last_usecs, max_usecs, frames, stretched;
+  uint64_t total_usecs, next_usecs;
+};
+
+struct ID_OD_airtime_stats {
+
+  uint16_t budget;            // 1/1000ths, 0 for no limit.
+  float    ms_per_sec;        // Over the last whole second.
+  float    max_ms_per_sec;
+  uint32_t frames, stretched; // stretched, intervals held back by the budget.
+  uint64_t total_usecs;
+};
+
+struct ID_OD_rate_plan {
+
+  uint16_t period_ms[ID_OD_TRANSPORTS];  // 0 for off.
+};
+
+struct ID_OD_transport {
+
+  uint8_t  built, air, waiting;
+  uint16_t period_ms;
+  uint32_t sent, held;
+  uint64_t due, first_sent, last_sent;
+};
+
+struct ID_OD_transport_stats {
+
+  uint8_t  built;
+  uint16_t period_ms;
+  float    achieved_ms;
+  uint32_t sent, held;        // held, intervals held back by the airtime budget.
+};
+
+struct ID_OD_schedule_stats {
+
+  uint16_t target_ms;
+  float    achieved_ms;
+  uint32_t sent, late, skipped;
+};
+
+// Called by the processor specific file when the radio has finished with a
+// frame, with the generation that id_od_tx_gen() gave when it was handed over.
+
+void     id_od_tx_done(uint8_t *,int,uint32_t);
+uint32_t id_od_tx_gen(uint8_t *);
+int      id_od_tx_live(uint8_t *,uint32_t);   // Still with the backend, not reclaimed.
+
+#include "id_open_backend.h"
+
+// UTC clock, disciplined when the GNSS time changes (or set, as with
+// settimeofday()) and extended with millis(). The date is only converted
+// to seconds when it changes, everything else is integer arithmetic.
+
+class ID_OD_Clock {
 
 public:
-           ID_OpenDrone();
+  int      discipline(int,int,int,int,int,int,int,uint32_t);
+  void     discipline(time_t,uint16_t,uint32_t);
+  time_t   unix_secs(uint32_t);
+  uint32_t fix_centisecs(void);     // Since the hour, for the Location TimeStamp.
+
+  uint32_t disciplines = 0, date_conversions = 0;
+
+private:
+  int      year = 0, month = 0, day = 0, time_of_day = -1, csecs = 0;
+  time_t   date_secs = 0, fix_secs = 0;
+  uint16_t fix_msecs = 0;
+  uint32_t fix_millis = 0;
+};
+
+// The processor specific functions come from Backend, see id_open_backend.h.
+
+template <class Backend> class ID_OpenDrone_T {
+
+public:
+           ID_OpenDrone_T();
   void     init(struct UTM_parameters *);
   void     set_self_id(char *);
   void     set_auth(char *);
   void     set_auth(uint8_t *,short int,uint8_t);
   int      transmit(struct UTM_data *);
+  int      transmit(void);
+  int      start(uint16_t = ID_OD_ENGINE_TICK_MS);
+  void     update_location(double,double,float,float,int,int,int);
+  void     update_operator_location(double,double,float);
+  void     update_time(int,int,int,int,int,int,int);
+  void     get_engine_stats(struct ID_OD_engine_stats *);
+  void     set_utc(time_t,uint16_t = 0);
+  void     set_ble_policy(int);
+  void     set_ble_ratio(int,uint8_t,uint8_t);
+  void     set_ble_budget(int,uint16_t);
+  void     get_ble_phy_stats(struct ID_OD_ble_phy_stats *);
+  void     set_airtime_budget(int,uint16_t);
+  void     get_airtime_stats(int,struct ID_OD_airtime_stats *);
+  int      set_transport(int,uint16_t);
+  int      set_rate_plan(const struct ID_OD_rate_plan *);
+  void     get_rate_plan(struct ID_OD_rate_plan *);
+  void     get_transport_stats(int,struct ID_OD_transport_stats *);
+  void     set_schedule(int,uint16_t,uint16_t);
+  void     set_schedule_policy(int);
+  void     get_schedule_stats(int,struct ID_OD_schedule_stats *);
+  void     get_encode_stats(struct ID_OD_encode_stats *);
+  void     get_beacon_stats(struct ID_OD_beacon_stats *);
+  void     get_nan_stats(struct ID_OD_beacon_stats *);
+  void     get_pack_stats(int,struct ID_OD_pack_stats *);
+  void     get_tx_stats(struct ID_OD_tx_stats *);
+  void     flush_tx(void);
 #if ID_NATIONAL
   void     init_national(struct UTM_parameters *);
   void     auth_key_national(uint8_t *,int,uint8_t *,int);
@@ -128,37 +629,145 @@ public:
 private:
 
   void     init_beacon(void);
+#if ID_OD_WIFI_NAN
+  void     init_nan(void);
+  int      transmit_nan_sync(uint64_t);
+  int      transmit_nan_action(void);
+#endif
+  uint64_t msecs64(void);
+  void     init_schedule(uint64_t);
+  int      next_transport(uint64_t,uint32_t);
+  void     transport_sent(int,uint64_t);
+  int      next_slot(uint64_t);
+  void     transmit_slot(int,struct UTM_data *,time_t);
+  int      refresh_location(struct UTM_data *);
+  int      encode_location(void);
+  void     encode_system(void);
 #if ID_NATIONAL
   int      pack_encrypt_national(uint8_t *);
 #endif
-  int      transmit_wifi(struct UTM_data *,int);
-  int      transmit_ble(uint8_t *,int);
+  uint32_t pack_layout(void);
+  const uint8_t *pack_message(int);
+  int      build_pack(uint8_t *,int,uint32_t);
+#if ID_OD_WIFI
+  struct ID_OD_frame_buffer *acquire_frame(uint32_t);
+  int      send_frame(struct ID_OD_frame_buffer *,int);
+  void     tx_harvest(void);
+  int      tx_saturated(void);
+  int      frame_pack(struct ID_OD_frame_buffer *,const uint8_t *,int,uint32_t,uint32_t,int,
+                      struct ID_OD_beacon_stats *,int *);
+  int      transmit_wifi_burst(struct UTM_data *,int);
+  uint32_t static_layout(void);
+  void     set_valid(uint32_t);
+  uint32_t rotate_statics(struct ID_OD_wifi_packer *,uint32_t,int,uint32_t,uint16_t);
+#endif
+  int      transmit_wifi(struct UTM_data *,int,int);
+  int      transmit_ble(int,uint8_t *,int);
+#if ID_OD_BT && ID_OD_BLE_PACK
+  int      transmit_ble_pack(void);
+#endif
+  int      tx_enqueue(int,uint8_t *,int,int = ID_OD_PHY_LEGACY);
+  int      ble_phy(int,int,int);
+  uint32_t airtime(int,int,int);
+  void     air_roll(uint64_t);
+  int      air_hold(int,uint64_t);
+  void     air_account(int,int,int);
+#if ID_OD_ASYNC_TX
+  int      tx_service(void);
+  static int tx_task(void *);
+#endif
+  void     update_begin(void);
+  void     update_end(void);
+#if ID_OD_ENGINE
+  void     engine_tick(void);
+  static void engine_task(void *);
+#endif
 
-  int                     auth_page = 0, auth_page_count = 0, key_length = 0, iv_length = 0;
+  int                     auth_page_count = 0, key_length = 0, iv_length = 0;
   char                   *UAS_operator;
   uint8_t                 msg_counter[16];
   uint16_t                wifi_interval = 0, ble_interval = 0;
   Stream                 *Debug_Serial = NULL;
 
+  int                     schedule_policy = ID_OD_SCHED_SKIP;
+  uint32_t                last_millis = 0;
+  uint64_t                millis_wraps = 0;
+  ID_OD_Clock             utc_clock;
+  struct ID_OD_schedule   schedule[ID_OD_SLOTS];
+  struct ID_OD_transport  transport[ID_OD_TRANSPORTS];
+
+  int                     location_status = ODID_SUCCESS;
+  uint16_t                location_dirty = 0, system_dirty = 0;
+  uint32_t                static_gen = 1, location_gen = 0, system_gen = 0;
+  struct ID_OD_encode_stats encode_stats;
+  struct ID_OD_beacon_stats beacon_stats;
+  struct ID_OD_tx_stats   tx_stats;
+
+  uint8_t                 air_wifi_rate = 2;   // 1 Mbit/s (units of 500 kbit/s).
+  uint64_t                air_msecs = 0, air_window = 0;
+  struct ID_OD_airtime    air[ID_OD_AIRS];
+
+#if ID_OD_ASYNC_TX
+  int                     tx_async = 0;
+  std::atomic<uint32_t>   tx_head, tx_tail;
+  struct ID_OD_tx_entry   tx_queue[ID_OD_TX_QUEUE];
+#endif
+
+  struct UTM_data         engine_data, engine_snapshot;
+  struct ID_OD_engine_stats engine_stats;
+#if ID_OD_ENGINE
+  int                     engine_running = 0;
+  uint32_t                engine_due = 0;
+  std::atomic<uint32_t>   engine_seq;
+#endif
+
   char                    ssid[32];
   size_t                  ssid_length = 0;
   uint8_t                 WiFi_mac_addr[6], wifi_channel = WIFI_CHANNEL,
                          *auth_key = NULL, *auth_iv = NULL;
 #if ID_OD_WIFI
   uint16_t                sequence = 1, beacon_interval = 0x200;
+#if ID_NATIONAL
+  uint8_t                 wifi_toggle[2] = {1,1};  // NAN and beacon.
+#endif
+  struct ID_OD_wifi_packer wifi_packer[2];         // NAN and beacon.
+  uint32_t                frame_uses = 0;
+  uint8_t                 wifi_saturated = 0;
+  struct ID_OD_frame_buffer frame_ring[ID_OD_FRAME_BUFFERS];
 #if ID_OD_WIFI_BEACON
   int                     beacon_offset = 0, beacon_max_packed = 30;
-  uint8_t                 beacon_frame[BEACON_FRAME_SIZE],
-#if USE_BEACON_FUNC
-                          beacon_counter = 0;
-#else
-                         *beacon_payload, *beacon_timestamp, *beacon_counter, *beacon_length, *beacon_seq;
+  uint8_t                 beacon_counter = 0;
+#if !USE_BEACON_FUNC
+  uint8_t                 beacon_frame[BEACON_TEMPLATE_SIZE];
+  struct ID_OD_beacon_patch beacon_patch;
+#endif
 #endif
+#if ID_OD_WIFI_NAN
+  uint8_t                 nan_counter = 0;
+  uint8_t                 nan_sync[ID_OD_NAN_TEMPLATE_SIZE], nan_action[ID_OD_NAN_TEMPLATE_SIZE];
+  struct ID_OD_nan_patch  nan_patch;
+  struct ID_OD_beacon_stats nan_stats;
 #endif
 #endif
 
 #if ID_OD_BT
   uint8_t                 ble_message[36], counter = 0;
+#if ID_OD_BLE_ADV_CACHE
+  uint8_t                 ble_adv[ID_OD_SLOTS][ID_OD_BLE_ADV_SIZE];
+  uint32_t                ble_adv_gen[ID_OD_SLOTS];
+#endif
+  struct ID_OD_ble_policy ble_policy;
+  struct ID_OD_ble_phy_stats ble_phy_stats;
+  uint16_t                ble_phy_acc[ID_OD_SLOTS];
+  uint32_t                ble_tokens[ID_OD_PHYS], ble_token_msecs = 0; // Tokens in 1/1000ths.
+#if ID_OD_BLE_PACK
+  int                     ble_ext_next = 0;
+  uint8_t                 ble_ext[2][ID_OD_BLE_EXT_SIZE]; // One may be queued while the other is built.
+#if ID_OD_ASYNC_TX
+  uint8_t                 ble_ext_queued[2] = {0, 0};
+  uint32_t                ble_ext_entry[2];               // Its place in the TX queue.
+#endif
+#endif
 #endif
 
   ODID_UAS_Data           UAS_data;
@@ -171,12 +780,18 @@ private:
 
   ODID_BasicID_encoded    basicID_enc[2];
   ODID_Location_encoded   location_enc;
-  ODID_Auth_encoded       auth_enc;
+  ODID_Auth_encoded       auth_enc[ODID_AUTH_MAX_PAGES];
   ODID_SelfID_encoded     selfID_enc;
   ODID_System_encoded     system_enc;
   ODID_OperatorID_encoded operatorID_enc;
 };
 
+#if !defined(ID_OD_BACKEND)
+#error "No ID_OD_BACKEND for this processor, define it (ID_OD_Null sends nothing)."
+#endif
+
+typedef ID_OpenDrone_T<ID_OD_BACKEND> ID_OpenDrone;
+
 #endif
 
 /*
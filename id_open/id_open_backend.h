@@ -0,0 +1,187 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * C++ class for Arduino to function as a wrapper around opendroneid.
+ * This file has the processor specific backends' interface.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * NOTES
+ *
+ * A backend is a struct of static functions that ID_OpenDrone_T<> takes as a
+ * template parameter, in place of the construct2(), init2() ... free functions.
+ * The information elements for the beacon frame are types from wifi_ie.h,
+ * built at compile time, the functions are in the processor specific file.
+ *
+ * Every backend has the full set of functions, whatever the transports. The
+ * ones that a processor can't do return -1 (or nothing).
+ *
+ *   construct()        From the ID_OpenDrone_T constructor.
+ *   init()             Start the radios.
+ *   capability()       Beacon capability bits.
+ *   rates              Supported rates IE (a WiFi_bytes<> type).
+ *   ext_rates          Extended supported rates IE.
+ *   misc_ies           Anything else for the beacon, e.g. a vendor IE.
+ *   transmit_wifi()    Send a WiFi frame, id_od_tx_done() with the outcome and the
+ *                      id_od_tx_gen() taken on entry when finished with it. Returns
+ *                      ID_OD_TX_QUEUED, _SENT, _DROPPED (no room in the driver) or _FAILED.
+ *   transmit_ble()     Advertise, 0 if it did. The PHY is a hint, legacy only backends ignore it.
+ *   start_tx_task()    Start a radio task that calls the function (until it
+ *                      returns 0) when woken by wake_tx_task().
+ *   start_engine()     Start a task that calls the function every tick_ms.
+ *
+ */
+
+#ifndef ID_OPEN_BACKEND_H
+#define ID_OPEN_BACKEND_H
+
+#include "wifi_ie.h"
+
+// The rates that the ESP32 and ESP8266 (and the host, which copies them) advertise.
+
+struct ID_OD_WiFi_IEs {
+
+  typedef WiFi_IE_rates<0x8b,  //  5.5
+                        0x96,  // 11
+                        0x82,  //  1
+                        0x84,  //  2
+                        0x0c,  //  6
+                        0x18,  // 12
+                        0x30,  // 24
+                        0x60>  // 48
+                        rates;
+  typedef WiFi_IE_ext_rates<0x6c,  // 54
+                            0x12,  //  9
+                            0x24,  // 18
+                            0x48>  // 36
+                            ext_rates;
+  typedef WiFi_bytes<>      misc_ies;
+};
+
+struct ID_OD_No_IEs {
+
+  typedef WiFi_bytes<>      rates;
+  typedef WiFi_bytes<>      ext_rates;
+  typedef WiFi_bytes<>      misc_ies;
+};
+
+/*
+ * id_open_esp32.cpp
+ */
+
+struct ID_OD_ESP32: ID_OD_WiFi_IEs {
+
+  static uint8_t *capability() {
+
+    // 0x21 = ESS | Short preamble
+    // 0x04 = Short slot time
+
+    static uint8_t capa[2] = {0x21,0x04};
+
+    return capa;
+  }
+
+  static void construct(void);
+  static void init(char *,int,uint8_t *,uint8_t);
+  static int  transmit_wifi(uint8_t *,int);
+  static int  transmit_ble(uint8_t *,int,int);
+  static int  start_tx_task(int (*)(void *),void *);
+  static void wake_tx_task(void);
+  static int  start_engine(void (*)(void *),void *,uint16_t);
+};
+
+/*
+ * id_open_esp8266.cpp
+ */
+
+struct ID_OD_ESP8266: ID_OD_WiFi_IEs {
+
+  static uint8_t *capability() {
+
+    static uint8_t capa[2] = {0x11,0x00};
+
+    return capa;
+  }
+
+  typedef WiFi_IE_vendor<0x18fe34,0x03,0x01,0x00,0x00,0x00,0x00> misc_ies; // Espressif
+
+  static void construct(void);
+  static void init(char *,int,uint8_t *,uint8_t);
+  static int  transmit_wifi(uint8_t *,int);
+  static int  transmit_ble(uint8_t *,int,int);
+  static int  start_tx_task(int (*)(void *),void *) { return -1; }
+  static void wake_tx_task(void)                    { return; }
+  static int  start_engine(void (*)(void *),void *,uint16_t) { return -1; }
+};
+
+/*
+ * id_open_nrf52.cpp
+ */
+
+struct ID_OD_nRF52: ID_OD_No_IEs {
+
+  static uint8_t *capability() {
+
+    static uint8_t capa[2] = {0x11,0x05};
+
+    return capa;
+  }
+
+  static void construct(void);
+  static void init(char *,int,uint8_t *,uint8_t);
+  static int  transmit_wifi(uint8_t *,int);
+  static int  transmit_ble(uint8_t *,int,int);
+  static int  start_tx_task(int (*)(void *),void *) { return -1; }
+  static void wake_tx_task(void)                    { return; }
+  static int  start_engine(void (*)(void *),void *,uint16_t) { return -1; }
+};
+
+/*
+ * id_open_host.cpp, records what would have been sent.
+ */
+
+struct ID_OD_Host: ID_OD_WiFi_IEs {
+
+  static uint8_t *capability() {
+
+    static uint8_t capa[2] = {0x21,0x04};
+
+    return capa;
+  }
+
+  static void construct(void);
+  static void init(char *,int,uint8_t *,uint8_t);
+  static int  transmit_wifi(uint8_t *,int);
+  static int  transmit_ble(uint8_t *,int,int);
+  static int  start_tx_task(int (*)(void *),void *);
+  static void wake_tx_task(void);
+  static int  start_engine(void (*)(void *),void *,uint16_t);
+};
+
+/*
+ * Sends nothing. For timing the core on its own and for building without a radio.
+ */
+
+struct ID_OD_Null: ID_OD_WiFi_IEs {
+
+  static uint8_t *capability() {
+
+    static uint8_t capa[2] = {0x21,0x04};
+
+    return capa;
+  }
+
+  static void construct(void)                       { return; }
+  static void init(char *,int,uint8_t *,uint8_t)    { return; }
+  static int  transmit_wifi(uint8_t *buffer,int)    { id_od_tx_done(buffer,ID_OD_TX_SENT,id_od_tx_gen(buffer));
+                                                      return ID_OD_TX_SENT; }
+  static int  transmit_ble(uint8_t *,int,int)       { return 0; }
+  static int  start_tx_task(int (*)(void *),void *) { return -1; }
+  static void wake_tx_task(void)                    { return; }
+  static int  start_engine(void (*)(void *),void *,uint16_t) { return -1; }
+};
+
+#endif
+
+/*
+ *
+ */
@@ -1,10 +1,15 @@
 /* -*- tab-width: 2; mode: c; -*-
  *
  * C++ class for Arduino to function as a wrapper around opendroneid.
- * This file has the wifi beacon setup code.
+ * This file has the wifi beacon and NAN setup code.
  *
  * Copyright (c) 2023, Steve Jack.
  *
+ * Oct. '26:  Offsets of the volatile fields go in the patch list.
+ *            The IEs come from the Backend template parameter.
+ *            The fixed tags are built at compile time (wifi_ie.h).
+ *            NAN frame templates.
+ *
  * May  '23:  WiFi country code now defined in id_open.h.
  *
  * Nov. '22:  Split out from id_open.cpp.
@@ -26,16 +31,17 @@
 
 /*
  * The variables setup by the following function are defined in id_open.h.
+ * The frame is a template, transmit_wifi() only writes the fields in
+ * beacon_patch.
  * Some of the tags are copied from beacon frames sent by the Raspberry Pi
  * which is known to work with Android ID apps.
  *
  */
 
-void ID_OpenDrone::init_beacon() {
+template <class Backend>
+void ID_OpenDrone_T<Backend>::init_beacon() {
 
   int           i;
-  const uint8_t wifi_channels  = WIFI_COUNTRY_NCHAN;
-  const char    wifi_country[] = WIFI_COUNTRY_CC;
 
   struct __attribute__((__packed__)) beacon_header {
 
@@ -51,14 +57,14 @@ void ID_OpenDrone::init_beacon() {
   } *header;
 
   header                  = (struct beacon_header *) beacon_frame;
-  beacon_timestamp        = header->timestamp;
-  beacon_seq              = header->seq;
+  beacon_patch.timestamp  = header->timestamp - beacon_frame;
+  beacon_patch.seq        = header->seq       - beacon_frame;
   
   header->control[0]      = 0x80;
   header->interval[0]     = (uint8_t)  beacon_interval;
   header->interval[1]     = (uint8_t) (beacon_interval >> 8);
 
-  memcpy(header->capability,capability(),2);
+  memcpy(header->capability,Backend::capability(),2);
 
   for (i = 0; i < 6; ++i) {
 
@@ -77,111 +83,156 @@ void ID_OpenDrone::init_beacon() {
     beacon_frame[beacon_offset++] = ssid[i];
   }
 
-  // Supported rates
-#if 0
-  beacon_frame[beacon_offset++] = 0x01; // This is what ODID 1.0 does.
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x8c; // 11b, 6(B) Mbit/sec
-#else
-  beacon_offset = tag_rates(beacon_frame,beacon_offset);
-#endif
+  // The rest of the tags, up to the ODID vendor IE, are fixed. Other IEs
+  // that have been tried are in wifi_ie.h, e.g. WiFi_IE_ERP and WiFi_IE_WPA.
+  // ODID 1.0 sends WiFi_IE_rates<0x8c> (11b, 6(B) Mbit/sec) as its rates.
 
-  // DS
-  beacon_frame[beacon_offset++] = 0x03;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = wifi_channel;
-
-#if 1
-  // Traffic Indication Map
-  beacon_frame[beacon_offset++] = 0x05;
-  beacon_frame[beacon_offset++] = 0x04;
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x02;
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x00;
-#endif
+  typedef typename WiFi_cat<typename Backend::rates,
+                            WiFi_IE_DS<WIFI_CHANNEL>,
+                            WiFi_IE_TIM,
+                            WiFi_IE_country<WIFI_COUNTRY_CC[0],WIFI_COUNTRY_CC[1],WIFI_COUNTRY_NCHAN,0x14>,
+                            typename Backend::ext_rates,
+                            typename Backend::misc_ies>::type tags; // e.g. HT Capabilities, HT Information
 
-#if 1
-  // Country Information
-  beacon_frame[beacon_offset++] = 0x07;
-  beacon_frame[beacon_offset++] = 0x06;
-  beacon_frame[beacon_offset++] = wifi_country[0];
-  beacon_frame[beacon_offset++] = wifi_country[1];
-  beacon_frame[beacon_offset++] = 0x20;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = wifi_channels;
-  beacon_frame[beacon_offset++] = 0x14;
-#endif
+  static_assert(sizeof(struct beacon_header) + 2 + 32 + tags::size + 7 <= BEACON_TEMPLATE_SIZE,
+                "BEACON_TEMPLATE_SIZE is too small for the tags");
 
-#if 0
-  // Power Constraint
-  beacon_frame[beacon_offset++] = 0x20;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x00;
-#endif
+  beacon_offset = tags::copy(beacon_frame,beacon_offset);
 
-#if 0
-  // TPC Report Transmit Power
-  beacon_frame[beacon_offset++] = 0x23;
-  beacon_frame[beacon_offset++] = 0x02;
-  beacon_frame[beacon_offset++] = 0x11;
-  beacon_frame[beacon_offset++] = 0x00;
-#endif
+  return;
+}
 
-#if 0
-  // ERP Information
-  beacon_frame[beacon_offset++] = 0x2a;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x00;
+/*
+ *
+ */
+
+#if defined(ID_OD_BACKEND)
+template void ID_OpenDrone_T<ID_OD_BACKEND>::init_beacon(void);
 #endif
 
-#if 1
-  // Extended Supported Rates
-  beacon_offset = tag_ext_rates(beacon_frame,beacon_offset);
+#if defined(ID_OD_NULL_BACKEND)
+template void ID_OpenDrone_T<ID_OD_Null>::init_beacon(void);
 #endif
 
-#if 1
-  // Other WiFi chip dependent tags, e.g. HT Capabilities, HT Information
-  beacon_offset = misc_tags(beacon_frame,beacon_offset);
 #endif
 
-#if 0
-  // WPA Information
-  beacon_frame[beacon_offset++] = 0xdd;
-  beacon_frame[beacon_offset++] = 0x1a;
-
-  beacon_frame[beacon_offset++] = 0x00; // Microsoft
-  beacon_frame[beacon_offset++] = 0x50;
-  beacon_frame[beacon_offset++] = 0xf2;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x00;
-
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x50;
-  beacon_frame[beacon_offset++] = 0xf2;
-  beacon_frame[beacon_offset++] = 0x02;
-  beacon_frame[beacon_offset++] = 0x02;
-  beacon_frame[beacon_offset++] = 0x00;
-
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x50;
-  beacon_frame[beacon_offset++] = 0xf2;
-  beacon_frame[beacon_offset++] = 0x04;
-
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x50;
-  beacon_frame[beacon_offset++] = 0xf2;
-  beacon_frame[beacon_offset++] = 0x02;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x00;
-
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x50;
-  beacon_frame[beacon_offset++] = 0xf2;
-  beacon_frame[beacon_offset++] = 0x02;
+/*
+ * NAN. opendroneid builds the frames once and they are kept as templates.
+ *
+ * The sync beacon doesn't change, apart from its timestamp. The action frame
+ * is built with one message more in the second pack, with a different
+ * counter. The pack is found by its header and the bytes before it that
+ * differ, by a message's length or by the counter, are the fields to patch.
+ */
+
+#if ID_OD_WIFI_NAN
+
+template <class Backend>
+void ID_OpenDrone_T<Backend>::init_nan() {
+
+  int                        length;
+  uint8_t                   *frame;
+  struct ID_OD_frame_buffer *buffer;
+
+  memset(&nan_patch,0,sizeof(nan_patch));
+
+  if ((buffer = acquire_frame(0)) == NULL) {
+
+    return;
+  }
+
+  frame = buffer->frame;
+
+  if (((length = odid_wifi_build_nan_sync_beacon_frame((char *) WiFi_mac_addr,frame,BEACON_FRAME_SIZE)) >= 32)&&
+      (length <= ID_OD_NAN_TEMPLATE_SIZE)) {
+
+    memcpy(nan_sync,frame,nan_patch.sync_length = length);
+  }
+
+#if ID_OD_CACHED_PACK
+
+  int     i, n, length2, payload = 0, ok = 1;
+  uint8_t system_valid, operator_valid, diff;
+
+  system_valid   = UAS_data.SystemValid;
+  operator_valid = UAS_data.OperatorIDValid;
+
+  UAS_data.SystemValid     = 1;
+  UAS_data.OperatorIDValid = 0;
+
+  length = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,(char *) WiFi_mac_addr,0,
+                                                         frame,BEACON_FRAME_SIZE);
+
+  for (n = 1; (n < ID_OD_PACK_MAX)&&(length > 0); ++n) {
+
+    if ((i = length - 3 - (n * ODID_MESSAGE_SIZE)) < 1) {
+
+      break;
+    }
+
+    if (((frame[i] >> 4) == ODID_MESSAGETYPE_PACKED)&&
+        (frame[i + 1] == ODID_MESSAGE_SIZE)&&(frame[i + 2] == n)) {
+
+      payload = i;
+      break;
+    }
+  }
+
+  if ((payload)&&(payload <= ID_OD_NAN_TEMPLATE_SIZE)) {
+
+    memcpy(nan_action,frame,payload);
+
+    UAS_data.OperatorIDValid = 1;
+
+    length2 = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,(char *) WiFi_mac_addr,0x5a,
+                                                            frame,BEACON_FRAME_SIZE);
+
+    if (length2 != (length + ODID_MESSAGE_SIZE)) {
+
+      ok = 0;
+    }
+
+    for (i = 0; (i < payload)&&(ok); ++i) {
+
+      if ((diff = frame[i] - nan_action[i]) == 0) {
+
+        continue;
+      }
+
+      if ((diff == 0x5a)&&(i == (payload - 1))) {
+
+        nan_patch.counter = i;
+
+      } else if ((diff == ODID_MESSAGE_SIZE)&&(nan_patch.lengths < ID_OD_NAN_LENGTHS)&&
+                 ((nan_action[i] - (length - payload) + (3 + (ID_OD_PACK_MAX * ODID_MESSAGE_SIZE))) < 256)) {
+
+        nan_patch.base[nan_patch.lengths]     = nan_action[i] - (length - payload);
+        nan_patch.length[nan_patch.lengths++] = i;
+
+      } else {
+
+        ok = 0;
+      }
+    }
+
+    if ((ok)&&(nan_patch.counter)) {
+
+      nan_patch.payload = payload;
+
+    } else {
+
+      nan_patch.lengths = 0;
+    }
+  }
+
+  UAS_data.SystemValid     = system_valid;
+  UAS_data.OperatorIDValid = operator_valid;
+
 #endif
 
+  buffer->layout     =
+  buffer->static_gen = 0;
+
   return;
 }
 
@@ -189,4 +240,12 @@ void ID_OpenDrone::init_beacon() {
  *
  */
 
+#if defined(ID_OD_BACKEND)
+template void ID_OpenDrone_T<ID_OD_BACKEND>::init_nan(void);
+#endif
+
+#if defined(ID_OD_NULL_BACKEND)
+template void ID_OpenDrone_T<ID_OD_Null>::init_nan(void);
+#endif
+
 #endif
@@ -5,6 +5,14 @@
  *
  * Copyright (c) 2020-2023, Steve Jack.
  *
+ * Oct. '26:  Releases WiFi frame buffers with id_od_tx_done().
+ *            Radio task for the asynchronous TX queue.
+ *            Engine task.
+ *            Advertising data changed in place (ID_OD_BLE_IN_PLACE).
+ *            The functions are static members of ID_OD_ESP32, see id_open_backend.h.
+ *            esp_wifi_80211_tx() errors are passed back, ESP_ERR_NO_MEM as a drop.
+ *            BT5 processors (C3, S3, C6) advertise with the extended API, packs on the coded PHY.
+ *
  * Nov. '22:  Split out from id_open.cpp. 
  *
  * MIT licence.
@@ -25,6 +33,12 @@
  * For certain things, it is easier to bypass the 'user friendly' Arduino API and
  * use the esp_ functions.
  * 
+ * The original ESP32 is BT4.2 only and esp_ble_gap_config_adv_data_raw()
+ * won't take more than 31 bytes, so ID_OD_BLE_PACK is an error for it. On
+ * the BT5 processors the controller won't mix the legacy and extended
+ * commands, so every advert goes through the extended API, legacy adverts
+ * on one advertising set and coded PHY adverts (and packs) on another.
+ *
  * Reference 
  * 
  * https://github.com/opendroneid/receiver-android/issues/7
@@ -81,22 +95,91 @@ static const char          *password = "password";
 #include "BLEDevice.h"
 #include "BLEUtils.h"
 
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+#define ID_OD_ESP32_EXT_ADV  1
+#else
+#define ID_OD_ESP32_EXT_ADV  0
+#endif
+
+#if ID_OD_BLE_PACK && !ID_OD_ESP32_EXT_ADV
+#error "ID_OD_BLE_PACK needs BT5 (ESP32-C3, S3 or C6), the ESP32's adverts are limited to 31 bytes."
+#endif
+
+#if ID_OD_ESP32_EXT_ADV
+
+#define EXT_ADV_LEGACY       0 // Advertising sets.
+#define EXT_ADV_CODED        1
+
+static esp_ble_gap_ext_adv_params_t extParams[ID_OD_PHYS];
+
+#else
+
 static esp_ble_adv_data_t   advData;
 static esp_ble_adv_params_t advParams;
+
+#endif
+
 static BLEUUID              service_uuid;
 
 #endif // BT
 
+#if ID_OD_ASYNC_TX
+
+static void                 tx_task(void *);
+
+static TaskHandle_t         tx_task_handle = NULL;
+static int                (*tx_service)(void *) = NULL;
+static void                *tx_arg = NULL;
+
+#endif
+
+#if ID_OD_ENGINE
+
+static void                 engine_task(void *);
+
+static void               (*engine_tick)(void *) = NULL;
+static void                *engine_arg = NULL;
+static uint16_t             engine_tick_ms = ID_OD_ENGINE_TICK_MS;
+
+#endif
+
 static Stream              *Debug_Serial = NULL;
 
 /*
  *
  */
 
-void construct2() {
+void ID_OD_ESP32::construct() {
 
 #if ID_OD_BT
 
+#if ID_OD_ESP32_EXT_ADV
+
+  int i;
+
+  memset(extParams,0,sizeof(extParams));
+
+  for (i = 0; i < ID_OD_PHYS; ++i) {
+
+    extParams[i].interval_min  = 0x0020;
+    extParams[i].interval_max  = 0x0040;
+    extParams[i].channel_map   = ADV_CHNL_ALL;
+    extParams[i].own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    extParams[i].filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
+    extParams[i].tx_power      = 9;
+    extParams[i].sid           = i;
+  }
+
+  extParams[EXT_ADV_LEGACY].type          = ESP_BLE_GAP_SET_EXT_ADV_PROP_LEGACY_NONCONN;
+  extParams[EXT_ADV_LEGACY].primary_phy   = ESP_BLE_GAP_PHY_1M;
+  extParams[EXT_ADV_LEGACY].secondary_phy = ESP_BLE_GAP_PHY_1M;
+
+  extParams[EXT_ADV_CODED].type           = ESP_BLE_GAP_SET_EXT_ADV_PROP_NONCONN_NONSCANNABLE_UNDIRECTED;
+  extParams[EXT_ADV_CODED].primary_phy    = ESP_BLE_GAP_PHY_CODED;
+  extParams[EXT_ADV_CODED].secondary_phy  = ESP_BLE_GAP_PHY_CODED;
+
+#else
+
   memset(&advData,0,sizeof(advData));
 
   advData.set_scan_rsp        = false;
@@ -116,6 +199,8 @@ void construct2() {
   advParams.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
   advParams.peer_addr_type    = BLE_ADDR_TYPE_PUBLIC;
 
+#endif
+
   service_uuid = BLEUUID("0000fffa-0000-1000-8000-00805f9b34fb");
 
 #endif // ID_OD_BT
@@ -127,7 +212,7 @@ void construct2() {
  *
  */
 
-void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
+void ID_OD_ESP32::init(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
 
   int  status;
   char text[128];
@@ -222,96 +307,106 @@ void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channe
   power    = esp_ble_tx_power_get(ESP_BLE_PWR_TYPE_DEFAULT);
   power_db = 3 * ((int) power - 4); 
 
+#if ID_OD_ESP32_EXT_ADV
+
+  esp_ble_gap_ext_adv_set_params(EXT_ADV_LEGACY,&extParams[EXT_ADV_LEGACY]);
+  esp_ble_gap_ext_adv_set_params(EXT_ADV_CODED,&extParams[EXT_ADV_CODED]);
+
+#endif
+
 #endif
 
   return;
 }
 
 /*
- * Processor dependent bits for the wifi frame header.
+ * The processor dependent bits for the wifi frame header are in id_open_backend.h.
  */
 
-uint8_t *capability() {
-
-  // 0x21 = ESS | Short preamble
-  // 0x04 = Short slot time
-
-  static uint8_t capa[2] = {0x21,0x04};
-  
-  return capa;
-}
+int ID_OD_ESP32::transmit_wifi(uint8_t *buffer,int length) {
 
-//
+  int       status = ID_OD_TX_SENT;
+  esp_err_t wifi_status = 0;
 
-int tag_rates(uint8_t *beacon_frame,int beacon_offset) {
+#if ID_OD_WIFI
 
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x08;
-  beacon_frame[beacon_offset++] = 0x8b; //  5.5
-  beacon_frame[beacon_offset++] = 0x96; // 11
-  beacon_frame[beacon_offset++] = 0x82; //  1
-  beacon_frame[beacon_offset++] = 0x84; //  2
-  beacon_frame[beacon_offset++] = 0x0c; //  6
-  beacon_frame[beacon_offset++] = 0x18; // 12 
-  beacon_frame[beacon_offset++] = 0x30; // 24
-  beacon_frame[beacon_offset++] = 0x60; // 48
+  uint32_t  gen = id_od_tx_gen(buffer);
 
-  return beacon_offset;
-}
+  if (length) {
 
-//
+    wifi_status = esp_wifi_80211_tx(WIFI_IF_AP,buffer,length,true);  
+  }
 
-int tag_ext_rates(uint8_t *beacon_frame,int beacon_offset) {
+  // esp_wifi_80211_tx() has taken a copy of the frame, or hasn't got room
+  // for it. There is no callback, so taken is as good as sent.
 
-  beacon_frame[beacon_offset++] = 0x32;
-  beacon_frame[beacon_offset++] = 0x04;
-  beacon_frame[beacon_offset++] = 0x6c; // 54 
-  beacon_frame[beacon_offset++] = 0x12; //  9 
-  beacon_frame[beacon_offset++] = 0x24; // 18 
-  beacon_frame[beacon_offset++] = 0x48; // 36 
+  switch (wifi_status) {
 
-  return beacon_offset;
-}
+  case ESP_OK:         status = ID_OD_TX_SENT;    break;
+  case ESP_ERR_NO_MEM: status = ID_OD_TX_DROPPED; break;
+  default:             status = ID_OD_TX_FAILED;  break;
+  }
 
-//
+  id_od_tx_done(buffer,status,gen);
 
-int misc_tags(uint8_t *beacon_frame,int beacon_offset) {
+#endif
 
-  return beacon_offset;
+  return status;
 }
 
 /*
  *
  */
 
-int transmit_wifi2(uint8_t *buffer,int length) {
+int ID_OD_ESP32::transmit_ble(uint8_t *ble_message,int length,int phy) {
 
-  esp_err_t wifi_status = 0;
+  esp_err_t  ble_status = 0;
 
-#if ID_OD_WIFI
+#if ID_OD_BT
 
-  if (length) {
+#if ID_OD_ESP32_EXT_ADV
 
-    wifi_status = esp_wifi_80211_tx(WIFI_IF_AP,buffer,length,true);  
-  }
+  // Legacy adverts are 31 bytes, anything longer has to be extended.
 
-#endif
+  int                   set;
+  esp_ble_gap_ext_adv_t start;
+  static uint8_t        advertising[ID_OD_PHYS] = {0, 0};
 
-  return (int) wifi_status;
-}
+  set = ((phy == ID_OD_PHY_CODED)||(length > 31)) ? EXT_ADV_CODED: EXT_ADV_LEGACY;
 
-/*
- *
- */
+  ble_status = esp_ble_gap_config_ext_adv_data_raw(set,length,ble_message);
 
-int transmit_ble2(uint8_t *ble_message,int length) {
+  if ((ble_status == ESP_OK)&&(!advertising[set])) {
 
-  esp_err_t  ble_status = 0;
+    start.instance   = set;
+    start.duration   = 0;
+    start.max_events = 0;
 
-#if ID_OD_BT
+    if ((ble_status = esp_ble_gap_ext_adv_start(1,&start)) == ESP_OK) {
+
+      advertising[set] = 1;
+    }
+  }
+
+#else
 
   static int advertising = 0; 
 
+#if ID_OD_BLE_IN_PLACE
+
+  // The controller takes new advertising data while advertising, so there
+  // is one call per advert and no gap.
+
+  ble_status = esp_ble_gap_config_adv_data_raw(ble_message,length); 
+
+  if (!advertising) {
+
+    ble_status  = esp_ble_gap_start_advertising(&advParams);
+    advertising = 1;
+  }
+
+#else
+
   if (advertising) {
 
     ble_status = esp_ble_gap_stop_advertising();
@@ -322,6 +417,10 @@ int transmit_ble2(uint8_t *ble_message,int length) {
 
   advertising = 1;
 
+#endif
+
+#endif // EXT_ADV
+
 #endif // BT
 
   return (int) ble_status;
@@ -340,6 +439,101 @@ esp_err_t event_handler(void *ctx, system_event_t *event) {
 
 #endif
 
+/*
+ * The radio task runs on the other core to the caller (loop() is on core 1),
+ * so the WiFi and BLE calls don't hold up the application.
+ */
+
+#if ID_OD_ASYNC_TX
+
+int ID_OD_ESP32::start_tx_task(int (*service)(void *),void *arg) {
+
+  BaseType_t core;
+
+  tx_service = service;
+  tx_arg     = arg;
+
+  core = (portNUM_PROCESSORS > 1) ? (xPortGetCoreID() ^ 1): tskNO_AFFINITY;
+
+  if (xTaskCreatePinnedToCore(tx_task,"id_od_tx",4096,NULL,2,&tx_task_handle,core) != pdPASS) {
+
+    tx_task_handle = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+//
+
+void ID_OD_ESP32::wake_tx_task() {
+
+  if (tx_task_handle) {
+
+    xTaskNotifyGive(tx_task_handle);
+  }
+
+  return;
+}
+
+//
+
+void tx_task(void *arg) {
+
+  for (;;) {
+
+    ulTaskNotifyTake(pdTRUE,pdMS_TO_TICKS(10));
+
+    tx_service(tx_arg);
+  }
+}
+
+#endif
+
+/*
+ * The engine task runs with the radio task, at a higher priority, and uses
+ * vTaskDelayUntil() so that the ticks don't drift with the time they take.
+ */
+
+#if ID_OD_ENGINE
+
+int ID_OD_ESP32::start_engine(void (*tick)(void *),void *arg,uint16_t tick_ms) {
+
+  BaseType_t core;
+
+  engine_tick    = tick;
+  engine_arg     = arg;
+  engine_tick_ms = tick_ms;
+
+  core = (portNUM_PROCESSORS > 1) ? (xPortGetCoreID() ^ 1): tskNO_AFFINITY;
+
+  if (xTaskCreatePinnedToCore(engine_task,"id_od_engine",6144,NULL,3,NULL,core) != pdPASS) {
+
+    return -1;
+  }
+
+  return 0;
+}
+
+//
+
+void engine_task(void *arg) {
+
+  TickType_t       last_wake;
+  const TickType_t period = (pdMS_TO_TICKS(engine_tick_ms) > 0) ? pdMS_TO_TICKS(engine_tick_ms): 1;
+
+  last_wake = xTaskGetTickCount();
+
+  for (;;) {
+
+    vTaskDelayUntil(&last_wake,period);
+
+    engine_tick(engine_arg);
+  }
+}
+
+#endif
+
 /*
  *
  */
@@ -5,6 +5,11 @@
  *
  * Copyright (c) 2022, Steve Jack.
  *
+ * Oct. '26:  Releases WiFi frame buffers from the send callback.
+ *            The functions are static members of ID_OD_ESP8266, see id_open_backend.h.
+ *            Passes back the wifi_send_pkt_freedom() result and the callback's status.
+ *            One frame with the SDK, the slot freed if the core reclaims it.
+ *
  * Nov. '22:  Split out from id_open.cpp. 
  *
  * MIT licence.
@@ -32,8 +37,21 @@
 
 extern "C" {
   int wifi_send_pkt_freedom(uint8 *,int,bool);
+  int wifi_register_send_pkt_freedom_cb(void (*)(uint8));
 }
 
+static void  tx_done_cb(uint8);
+
+// The frame handed to the SDK, released by tx_done_cb(). The SDK sends one
+// frame at a time, so there is one slot and a frame is dropped while the
+// last is still live. If a callback is lost, the core reclaims the buffer
+// after ID_OD_TX_TIMEOUT_MS, id_od_tx_live() no longer holds and the slot
+// is taken by the next frame. The SDK's callbacks run from its task, between
+// calls of loop(), so tx_done_cb() can't preempt transmit_wifi().
+
+static uint8_t          *in_flight     = NULL;
+static uint32_t          in_flight_gen = 0;
+
 #endif // WIFI
 
 static Stream *Debug_Serial = NULL;
@@ -42,7 +60,7 @@ static Stream *Debug_Serial = NULL;
  *
  */
 
-void construct2() {
+void ID_OD_ESP8266::construct() {
 
   return;
 }
@@ -51,7 +69,7 @@ void construct2() {
  *
  */
 
-void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
+void ID_OD_ESP8266::init(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
 
   char text[128];
 
@@ -72,6 +90,8 @@ void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channe
   WiFi.softAP(ssid,NULL,wifi_channel,false,0);
   WiFi.setOutputPower(20.0);
 
+  wifi_register_send_pkt_freedom_cb(tx_done_cb);
+
   wifi_softap_get_config(&wifi_config);
   // wifi_config.beacon_interval = 1000; // Pass beacon_interval from id_open.cpp?
   // wifi_softap_set_config(&wifi_config);
@@ -93,89 +113,75 @@ void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channe
  *
  */
 
-uint8_t *capability() {
+int ID_OD_ESP8266::transmit_wifi(uint8_t *buffer,int length) {
 
-  static uint8_t capa[2] = {0x11,0x00};
-  
-  return capa;
-}
+  int status = ID_OD_TX_SENT;
 
-//
+#if ID_OD_WIFI
 
-int tag_rates(uint8_t *beacon_frame,int beacon_offset) {
+  uint32_t gen;
 
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x08;
-  beacon_frame[beacon_offset++] = 0x8b; //  5.5
-  beacon_frame[beacon_offset++] = 0x96; // 11
-  beacon_frame[beacon_offset++] = 0x82; //  1
-  beacon_frame[beacon_offset++] = 0x84; //  2
-  beacon_frame[beacon_offset++] = 0x0c; //  6
-  beacon_frame[beacon_offset++] = 0x18; // 12 
-  beacon_frame[beacon_offset++] = 0x30; // 24
-  beacon_frame[beacon_offset++] = 0x60; // 48
+  gen = id_od_tx_gen(buffer);
 
-  return beacon_offset;
-}
+  if ((in_flight)&&(!id_od_tx_live(in_flight,in_flight_gen))) {
 
-//
+    in_flight = NULL;
+  }
 
-int tag_ext_rates(uint8_t *beacon_frame,int beacon_offset) {
+  if (!length) {
 
-  beacon_frame[beacon_offset++] = 0x32;
-  beacon_frame[beacon_offset++] = 0x04;
-  beacon_frame[beacon_offset++] = 0x6c; // 54 
-  beacon_frame[beacon_offset++] = 0x12; //  9 
-  beacon_frame[beacon_offset++] = 0x24; // 18 
-  beacon_frame[beacon_offset++] = 0x48; // 36 
+    id_od_tx_done(buffer,status = ID_OD_TX_SENT,gen);
 
-  return beacon_offset;
-}
+  } else if (in_flight) {
 
-//
+    // The SDK is still sending the last one.
 
-int misc_tags(uint8_t *beacon_frame,int beacon_offset) {
+    id_od_tx_done(buffer,status = ID_OD_TX_DROPPED,gen);
 
-  // Espressif
-  beacon_frame[beacon_offset++] = 0xdd;
-  beacon_frame[beacon_offset++] = 0x09;
+  } else {
 
-  beacon_frame[beacon_offset++] = 0x18;
-  beacon_frame[beacon_offset++] = 0xfe;
-  beacon_frame[beacon_offset++] = 0x34;
-  beacon_frame[beacon_offset++] = 0x03;
-  beacon_frame[beacon_offset++] = 0x01;
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x00;
-  beacon_frame[beacon_offset++] = 0x00;
+    in_flight     = buffer;
+    in_flight_gen = gen;
 
-  return beacon_offset;
-}
+    if (wifi_send_pkt_freedom(buffer,length,1) != 0) {
 
-/*
- *
- */
+      in_flight = NULL;
+      id_od_tx_done(buffer,status = ID_OD_TX_DROPPED,gen);
+
+    } else {
 
-int transmit_wifi2(uint8_t *buffer,int length) {
+      status = ID_OD_TX_QUEUED;
+    }
+  }
+
+#endif
+
+  return status;
+}
+
+//
 
 #if ID_OD_WIFI
 
-  if (length) {
+void tx_done_cb(uint8 status) {
 
-    wifi_send_pkt_freedom(buffer,length,1);
-  }
+  if (in_flight) {
 
-#endif
+    id_od_tx_done(in_flight,(status == 0) ? ID_OD_TX_SENT: ID_OD_TX_FAILED,in_flight_gen);
 
-  return 0;
+    in_flight = NULL;
+  }
+
+  return;
 }
 
+#endif
+
 /*
  *
  */
 
-int transmit_ble2(uint8_t *ble_message,int length) {
+int ID_OD_ESP8266::transmit_ble(uint8_t *ble_message,int length,int phy) {
 
   return 0;
 }
@@ -0,0 +1,668 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * C++ class for Arduino to function as a wrapper around opendroneid.
+ * This file has the host (Linux) backend and the Arduino shim functions.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * Nothing is transmitted. Frames are recorded in a ring in memory and,
+ * optionally, written to pcap files which can be opened with Wireshark.
+ * WiFi frames are written as LINKTYPE_IEEE802_11 (105) and BLE adverts as
+ * LINKTYPE_BLUETOOTH_LE_LL (251).
+ *
+ * The functions are static members of ID_OD_Host (id_open_backend.h). The
+ * tags and capabilities are the same as the ESP32's.
+ *
+ * The BLE controller calls that the ESP32 backend would make, and the time
+ * that advertising would be stopped for, are counted. Adverts longer than
+ * 31 bytes, or for the coded PHY, are BT5 extended adverts, recorded as
+ * AUX_ADV_INDs, and their airtime is added up for each PHY that they might
+ * be sent on.
+ *
+ * WiFi frame buffers are held for the frame's airtime (at 1 Mbit/s by
+ * default) and released by host_tx_poll(), which stands in for the radio's
+ * TX done interrupt. With ID_OD_ASYNC_TX, it is called by the radio thread.
+ * host_set_tx_depth() limits the frames that the driver will take at once,
+ * more are dropped, as the ESP32 does when it runs out of TX buffers.
+ *
+ * The radio task is a thread that spins (yielding) on the TX queue, as
+ * if it had a core to itself. The engine is another, which ticks on the
+ * host clock so that it keeps to simulated time.
+ *
+ */
+
+#define DIAGNOSTICS 0
+
+//
+
+#if !defined(ARDUINO)
+
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include <Arduino.h>
+
+#include "id_open.h"
+#include "id_open_host.h"
+
+#if ID_OD_ASYNC_TX || ID_OD_ENGINE
+#include <thread>
+#endif
+
+static void     record(int,uint8_t *,int);
+static void     pcap_write(FILE *,const uint8_t *,int,uint64_t);
+static uint32_t ble_crc24(const uint8_t *,int);
+static uint64_t monotonic_usecs(void);
+
+Stream                     Serial;
+
+static uint64_t          (*host_clock)(void) = monotonic_usecs;
+static uint8_t             host_mac[6] = {0x02,0x00,0x00,0x00,0x0d,0x1d};
+static FILE               *wifi_pcap = NULL, *ble_pcap = NULL;
+static int                 ring_next = 0, tx_kbps = 1000, in_flight_head = 0, in_flight_tail = 0,
+                           tx_depth = ID_OD_FRAME_BUFFERS;
+static uint8_t            *in_flight[ID_OD_FRAME_BUFFERS + 1];
+static uint64_t            in_flight_done[ID_OD_FRAME_BUFFERS + 1];
+static uint32_t            in_flight_gen[ID_OD_FRAME_BUFFERS + 1];
+static struct host_frame   ring[HOST_FRAME_RING];
+static struct host_tx_stats stats;
+
+/*
+ * Arduino shim.
+ */
+
+uint64_t host_usecs() {
+
+  return host_clock();
+}
+
+//
+
+void host_set_clock(uint64_t (*usecs)(void)) {
+
+  host_clock = (usecs) ? usecs: monotonic_usecs;
+
+  return;
+}
+
+//
+
+uint32_t millis() {
+
+  return (uint32_t) (host_clock() / 1000);
+}
+
+//
+
+uint32_t micros() {
+
+  return (uint32_t) host_clock();
+}
+
+//
+
+void delay(uint32_t msecs) {
+
+  struct timespec ts;
+
+  ts.tv_sec  =  msecs / 1000;
+  ts.tv_nsec = (msecs % 1000) * 1000000L;
+
+  nanosleep(&ts,NULL);
+
+  return;
+}
+
+//
+
+char *dtostrf(double value,signed char width,unsigned char prec,char *s) {
+
+  sprintf(s,"%*.*f",(int) width,(int) prec,value);
+
+  return s;
+}
+
+//
+
+Stream::Stream(FILE *f) {
+
+  file = f;
+
+  return;
+}
+
+size_t Stream::write(const uint8_t *buffer,size_t length) {
+
+  return fwrite(buffer,1,length,file);
+}
+
+size_t Stream::print(const char *s) {
+
+  return write((const uint8_t *) s,strlen(s));
+}
+
+size_t Stream::print(int i) {
+
+  char text[16];
+
+  sprintf(text,"%d",i);
+
+  return print(text);
+}
+
+void Stream::begin(unsigned long baud) {
+
+  return;
+}
+
+//
+
+uint64_t monotonic_usecs() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((uint64_t) ts.tv_sec * 1000000ULL) + (uint64_t) (ts.tv_nsec / 1000);
+}
+
+/*
+ * Backend.
+ */
+
+void ID_OD_Host::construct() {
+
+  memset(ring,0,sizeof(ring));
+  memset(&stats,0,sizeof(stats));
+
+  return;
+}
+
+/*
+ *
+ */
+
+void ID_OD_Host::init(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
+
+  memcpy(WiFi_mac_addr,host_mac,6);
+
+  return;
+}
+
+/*
+ * The processor dependent bits for the wifi frame header are in id_open_backend.h.
+ */
+
+void record(int type,uint8_t *buffer,int length) {
+
+  struct host_frame *frame;
+
+  frame = &ring[ring_next];
+
+  if (++ring_next >= HOST_FRAME_RING) {
+
+    ring_next = 0;
+  }
+
+  if (length > HOST_FRAME_SIZE) {
+
+    length = HOST_FRAME_SIZE;
+  }
+
+  frame->type   = type;
+  frame->length = length;
+  frame->usecs  = host_clock();
+
+  memcpy(frame->data,buffer,length);
+
+  return;
+}
+
+//
+
+int ID_OD_Host::transmit_wifi(uint8_t *buffer,int length) {
+
+  int      next;
+  uint32_t depth;
+
+  host_tx_poll();
+
+  depth = (in_flight_head - in_flight_tail + ID_OD_FRAME_BUFFERS + 1) % (ID_OD_FRAME_BUFFERS + 1);
+
+  if ((tx_kbps)&&(length)&&(depth >= (uint32_t) tx_depth)) {
+
+    ++stats.wifi_dropped;
+    id_od_tx_done(buffer,ID_OD_TX_DROPPED,id_od_tx_gen(buffer));
+
+    return ID_OD_TX_DROPPED;
+  }
+
+  if (length) {
+
+    record(HOST_FRAME_WIFI,buffer,length);
+
+    ++stats.wifi_frames;
+    stats.wifi_bytes += length;
+
+    if (wifi_pcap) {
+
+      pcap_write(wifi_pcap,buffer,length,host_clock());
+    }
+  }
+
+  next = (in_flight_head + 1) % (ID_OD_FRAME_BUFFERS + 1);
+
+  if ((!tx_kbps)||(!length)||(next == in_flight_tail)) {
+
+    id_od_tx_done(buffer,ID_OD_TX_SENT,id_od_tx_gen(buffer));
+    return ID_OD_TX_SENT;
+  }
+
+  // DSSS preamble and header plus the frame.
+
+  in_flight[in_flight_head]      = buffer;
+  in_flight_gen[in_flight_head]  = id_od_tx_gen(buffer);
+  in_flight_done[in_flight_head] = host_clock() + 192 + (((uint64_t) length * 8000) / tx_kbps);
+  in_flight_head                 = next;
+
+  depth = (in_flight_head - in_flight_tail + ID_OD_FRAME_BUFFERS + 1) % (ID_OD_FRAME_BUFFERS + 1);
+
+  if (depth > stats.wifi_in_flight_max) {
+
+    stats.wifi_in_flight_max = depth;
+  }
+
+  return ID_OD_TX_QUEUED;
+}
+
+//
+
+void host_tx_poll() {
+
+  uint64_t usecs;
+
+  usecs = host_clock();
+
+  while ((in_flight_tail != in_flight_head)&&(in_flight_done[in_flight_tail] <= usecs)) {
+
+    id_od_tx_done(in_flight[in_flight_tail],ID_OD_TX_SENT,in_flight_gen[in_flight_tail]);
+
+    in_flight_tail = (in_flight_tail + 1) % (ID_OD_FRAME_BUFFERS + 1);
+  }
+
+  return;
+}
+
+//
+
+void host_set_tx_rate(int kbps) {
+
+  tx_kbps = (kbps > 0) ? kbps: 0;
+
+  return;
+}
+
+//
+
+void host_set_tx_depth(int frames) {
+
+  tx_depth = (frames < 1) ? 1: (frames > ID_OD_FRAME_BUFFERS) ? ID_OD_FRAME_BUFFERS: frames;
+
+  return;
+}
+
+/*
+ * The BLE LL packet is an ADV_NONCONN_IND on the primary advertising channels.
+ */
+
+int ID_OD_Host::transmit_ble(uint8_t *ble_message,int length,int phy) {
+
+  int      i, j, extended;
+  uint8_t  packet[4 + 2 + 6 + 255 + 3];
+  uint32_t crc;
+
+  if (length <= 0) {
+
+    return 0;
+  }
+
+  extended = ((length > 31)||(phy == ID_OD_PHY_CODED)) ? 1: 0;
+
+  record(HOST_FRAME_BLE,ble_message,length);
+
+  ++stats.ble_frames;
+  stats.ble_bytes += length;
+
+  // The ESP32's controller calls.
+
+  static int advertising = 0;
+
+#if ID_OD_BLE_IN_PLACE
+  stats.ble_calls += (advertising) ? 1: 2;
+#else
+  if (advertising) {
+
+    stats.ble_calls     += 3;
+    stats.ble_off_usecs += 2 * HOST_BLE_CALL_USECS; // Until start completes.
+
+  } else {
+
+    stats.ble_calls     += 2;
+  }
+#endif
+
+  advertising = 1;
+
+  // Airtime. An extended advert is an ADV_EXT_IND on each primary channel,
+  // on the coded PHY if the secondary is, pointing to an AUX_ADV_IND.
+
+  if (!extended) {
+
+    stats.ble_legacy_usecs += 3 * host_ble_usecs(HOST_PHY_1M,6 + length);
+
+  } else {
+
+    ++stats.ble_ext_frames;
+
+    for (i = 0; i < HOST_PHYS; ++i) {
+
+      stats.ble_ext_usecs[i] += (3 * host_ble_usecs((i == HOST_PHY_CODED) ? HOST_PHY_CODED: HOST_PHY_1M,7)) +
+                                host_ble_usecs(i,8 + length);
+    }
+  }
+
+  if ((ble_pcap)&&(length <= 255 - 8)) {
+
+    j = 0;
+
+    packet[j++] = 0xd6; // Advertising access address.
+    packet[j++] = 0xbe;
+    packet[j++] = 0x89;
+    packet[j++] = 0x8e;
+
+    if (!extended) {
+
+      packet[j++] = 0x42; // ADV_NONCONN_IND, random address.
+      packet[j++] = 6 + length;
+
+    } else {
+
+      packet[j++] = 0x47; // AUX_ADV_IND, random address.
+      packet[j++] = 8 + length;
+      packet[j++] = 0x07; // Extended header length, non-connectable and non-scannable.
+      packet[j++] = 0x01; // AdvA.
+    }
+
+    for (i = 0; i < 6; ++i) {
+
+      packet[j++] = host_mac[5 - i];
+    }
+
+    memcpy(&packet[j],ble_message,length);
+    j += length;
+
+    crc = ble_crc24(&packet[4],j - 4);
+
+    packet[j++] = (uint8_t)  crc;
+    packet[j++] = (uint8_t) (crc >>  8);
+    packet[j++] = (uint8_t) (crc >> 16);
+
+    pcap_write(ble_pcap,packet,j,host_clock());
+  }
+
+  return 0;
+}
+
+/*
+ * The airtime of a BLE packet with a PDU payload of length bytes.
+ *
+ *   1M     preamble 1, access address 4, header 2, CRC 3 bytes at 8 us.
+ *   2M     as 1M but with a 2 byte preamble, at 4 us.
+ *   Coded  80 us preamble, 256 us access address, 16 us CI and 24 us TERM1,
+ *          then the header, payload, CRC and TERM2 (3 bits) at 64 us a bit.
+ */
+
+uint32_t host_ble_usecs(int phy,int length) {
+
+  switch (phy) {
+
+  case HOST_PHY_2M:    return 4 * (2 + 4 + 2 + length + 3);
+  case HOST_PHY_CODED: return 376 + (8 * ((8 * (2 + length + 3)) + 3));
+  default:             return 8 * (1 + 4 + 2 + length + 3);
+  }
+}
+
+/*
+ * Radio thread.
+ */
+
+#if ID_OD_ASYNC_TX
+
+int ID_OD_Host::start_tx_task(int (*service)(void *),void *arg) {
+
+  std::thread([service,arg]() {
+
+      for (;;) {
+
+        host_tx_poll();
+
+        if (!service(arg)) {
+
+          std::this_thread::yield();
+        }
+      }
+    }).detach();
+
+  return 0;
+}
+
+//
+
+void ID_OD_Host::wake_tx_task() {
+
+  return;
+}
+
+#endif
+
+/*
+ * Engine thread.
+ */
+
+#if ID_OD_ENGINE
+
+int ID_OD_Host::start_engine(void (*tick)(void *),void *arg,uint16_t tick_ms) {
+
+  std::thread([tick,arg,tick_ms]() {
+
+      uint64_t next;
+
+      next = host_usecs();
+
+      for (;;) {
+
+        while (host_usecs() < next) {
+
+          std::this_thread::yield();
+        }
+
+#if !ID_OD_ASYNC_TX
+        host_tx_poll();
+#endif
+        tick(arg);
+
+        next += (uint64_t) tick_ms * 1000;
+      }
+    }).detach();
+
+  return 0;
+}
+
+#endif
+
+/*
+ * Recording.
+ */
+
+int host_pcap_open(const char *wifi_file,const char *ble_file) {
+
+  int            i, status = 0;
+  uint32_t       header[6] = {0xa1b2c3d4,0x00040002,0,0,65535,0};
+  FILE         **pcap[2]   = {&wifi_pcap,&ble_pcap};
+  const char    *file[2]   = {wifi_file,ble_file};
+  const uint32_t link[2]   = {105,251};
+
+  host_pcap_close();
+
+  for (i = 0; i < 2; ++i) {
+
+    if (!file[i]) {
+
+      continue;
+    }
+
+    if ((*pcap[i] = fopen(file[i],"wb")) == NULL) {
+
+      status = -1;
+      continue;
+    }
+
+    header[5] = link[i];
+    fwrite(header,sizeof(header),1,*pcap[i]);
+  }
+
+  return status;
+}
+
+//
+
+void host_pcap_close() {
+
+  if (wifi_pcap) {
+
+    fclose(wifi_pcap);
+    wifi_pcap = NULL;
+  }
+
+  if (ble_pcap) {
+
+    fclose(ble_pcap);
+    ble_pcap = NULL;
+  }
+
+  return;
+}
+
+//
+
+void pcap_write(FILE *pcap,const uint8_t *data,int length,uint64_t usecs) {
+
+  uint32_t record[4];
+
+  record[0] = (uint32_t) (usecs / 1000000);
+  record[1] = (uint32_t) (usecs % 1000000);
+  record[2] =
+  record[3] = length;
+
+  fwrite(record,sizeof(record),1,pcap);
+  fwrite(data,1,length,pcap);
+
+  return;
+}
+
+/*
+ * 0 is the most recent frame.
+ */
+
+const struct host_frame *host_frame(int age) {
+
+  int index;
+
+  if ((age < 0)||(age >= HOST_FRAME_RING)) {
+
+    return NULL;
+  }
+
+  index = (ring_next - 1 - age + HOST_FRAME_RING) % HOST_FRAME_RING;
+
+  return (ring[index].length) ? &ring[index]: NULL;
+}
+
+//
+
+const struct host_tx_stats *host_stats() {
+
+  return &stats;
+}
+
+//
+
+void host_reset_stats() {
+
+  memset(&stats,0,sizeof(stats));
+
+  return;
+}
+
+/*
+ * The TSC on x86, otherwise nanoseconds.
+ */
+
+uint64_t host_cycles() {
+
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+
+  return ((uint64_t) hi << 32) | lo;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/*
+ * Bluetooth Core Specification, Vol 6, Part B, 3.1.1.
+ */
+
+uint32_t ble_crc24(const uint8_t *data,int length) {
+
+  int      i, bit;
+  uint8_t  d;
+  uint32_t crc = 0xaaaaaa; // 0x555555, bit reversed.
+
+  // Bit reversed LFSR so that the result can be sent LSB first.
+
+  for (i = 0; i < length; ++i) {
+
+    d = data[i];
+
+    for (bit = 0; bit < 8; ++bit, d >>= 1) {
+
+      if ((crc ^ d) & 1) {
+
+        crc = (crc >> 1) | 0x800000;
+        crc ^= 0x5a6000;
+
+      } else {
+
+        crc >>= 1;
+      }
+    }
+  }
+
+  return crc;
+}
+
+/*
+ *
+ */
+
+#endif // !ARDUINO
@@ -0,0 +1,67 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * C++ class for Arduino to function as a wrapper around opendroneid.
+ * This file has the host (Linux) backend's recording functions.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * NOTES
+ *
+ */
+
+#if !defined(ARDUINO)
+
+#ifndef ID_OPEN_HOST_H
+#define ID_OPEN_HOST_H
+
+#define HOST_FRAME_RING   64
+#define HOST_FRAME_SIZE  512
+
+#define HOST_FRAME_WIFI    1
+#define HOST_FRAME_BLE     2
+
+#define HOST_BLE_CALL_USECS 1000   // A guess at a Bluedroid GAP call's round trip.
+
+#define HOST_PHY_1M        0
+#define HOST_PHY_2M        1
+#define HOST_PHY_CODED     2       // S=8.
+#define HOST_PHYS          3
+
+struct host_frame {
+
+  uint8_t  type;
+  uint16_t length;
+  uint64_t usecs;
+  uint8_t  data[HOST_FRAME_SIZE];
+};
+
+struct host_tx_stats {
+
+  uint32_t wifi_frames, ble_frames, wifi_in_flight_max;
+  uint32_t wifi_dropped;      // No room in the simulated driver, not recorded.
+  uint32_t ble_calls;         // Controller calls, as the ESP32 backend makes them.
+  uint64_t wifi_bytes,  ble_bytes;
+  uint64_t ble_off_usecs;     // Time with advertising stopped, HOST_BLE_CALL_USECS a call.
+  uint32_t ble_ext_frames;    // Extended adverts, also counted in ble_frames.
+  uint64_t ble_legacy_usecs;  // Airtime of the legacy adverts, three primary channels at 1M.
+  uint64_t ble_ext_usecs[HOST_PHYS]; // Airtime of the extended adverts for each secondary PHY.
+};
+
+int                         host_pcap_open(const char *,const char *);
+void                        host_pcap_close(void);
+const struct host_frame    *host_frame(int);
+const struct host_tx_stats *host_stats(void);
+void                        host_reset_stats(void);
+uint64_t                    host_cycles(void);
+uint32_t                    host_ble_usecs(int,int);
+void                        host_set_tx_rate(int);
+void                        host_set_tx_depth(int);
+void                        host_tx_poll(void);
+
+#endif
+
+#endif
+
+/*
+ *
+ */
@@ -5,6 +5,12 @@
  *
  * Copyright (c) 2022, Steve Jack.
  *
+ * Oct. '26      BT5 extended adverts with a message pack, sent with the SoftDevice
+ *               functions on the coded PHY.
+ *               The core's interleaving policy chooses BT4 or BT5 rather than a toggle.
+ *               BLE_OPTION 2.
+ *               The functions are static members of ID_OD_nRF52, see id_open_backend.h.
+ *
  * December '22  
  *
  * MIT licence.
@@ -18,9 +24,14 @@
  * Uses Adafruit's BLE libraries. Works for BT4. It doesn't work for BT5 coded.
  * Adafruit use Nordic's S140 and support for coded in S410 is experimental.
  *
+ * BT5 (coded) adverts are sent with the SoftDevice functions, taking the
+ * advertising set from Bluefruit until the next BT4 advert.
+ *
  * BLE_OPTION == 2
  *
- * To do. Uses the nRF functions directly.
+ * Bluefruit only starts the SoftDevice. Everything is sent with the SoftDevice
+ * functions and, while the PHY doesn't change, the advertising data is swapped
+ * without stopping and restarting.
  * Probably easier and better to use Zephyr rather than Arduino for this.
  * 
  */
@@ -50,19 +61,31 @@
 // Use Adafruit's BLE libraries.
 // nRF SDK, Soft Device S140.
 
-#define PATCHED_BLEADV 0
-
 BLEService BLE_ODID_service;
 
 #elif BLE_OPTION == 2
 
+#include <bluefruit.h>
+
 #endif
 
 //
 
 const uint8_t    ODID_Uuid[] = {0x00, 0x00, 0xff, 0xfa, 0x00, 0x00, 0x10, 0x00,
                                 0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb};
-static char      BT_type_toggle[32];
+
+#define ADV_INTERVAL     100 // 0.625 ms units.
+#define EXT_ADV_INTERVAL 160
+
+static uint8_t   adv_data[2][BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED];
+static int       adv_buffer = 0, sd_advertising = 0, sd_phy = ID_OD_PHY_LEGACY;
+#if BLE_OPTION == 1
+static uint8_t   adv_handle = 0; // The S140 has one advertising set, Bluefruit's.
+#else
+static uint8_t   adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+#endif
+
+static uint32_t  sd_advert(uint8_t *,int,int);
 
 #endif
 
@@ -83,7 +106,7 @@ static char    text[128];
  *
  */
 
-void construct2() {
+void ID_OD_nRF52::construct() {
 
   return;
 }
@@ -92,10 +115,8 @@ void construct2() {
  *
  */
 
-void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
+void ID_OD_nRF52::init(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channel) {
 
-  memset(BT_type_toggle,4,sizeof(BT_type_toggle));
-  
 #if DIAGNOSTICS
   text[0] = text[63] = 0;
 
@@ -134,7 +155,13 @@ void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channe
   Bluefruit.Advertising.start(0);                // 0 = Don't stop advertising after n seconds
 
 #elif BLE_OPTION == 2
-  
+
+  // Just to start the SoftDevice.
+
+  Bluefruit.begin();
+  Bluefruit.setTxPower(8);
+  Bluefruit.setName(ssid);
+
 #endif
   
 #endif // BT
@@ -146,64 +173,24 @@ void init2(char *ssid,int ssid_length,uint8_t *WiFi_mac_addr,uint8_t wifi_channe
  *
  */
 
-uint8_t *capability() {
-
-  static uint8_t capa[2] = {0x11,0x05};
-  
-  return capa;
-}
-
-//
-
-int tag_rates(uint8_t *beacon_frame,int beacon_offset) {
-
-  return beacon_offset;
-}
-
-//
-
-int tag_ext_rates(uint8_t *beacon_frame,int beacon_offset) {
-
-  return beacon_offset;
-}
-
-//
-
-int misc_tags(uint8_t *beacon_frame,int beacon_offset) {
-
-  return beacon_offset;
-}
-
-/*
- *
- */
-
-int transmit_wifi2(uint8_t *buffer,int length) {
+int ID_OD_nRF52::transmit_wifi(uint8_t *buffer,int length) {
 
 #if ID_OD_WIFI
 
-  ;
+  id_od_tx_done(buffer,ID_OD_TX_FAILED,id_od_tx_gen(buffer)); // No WiFi radio.
 
 #endif
 
-  return 0;
+  return ID_OD_TX_FAILED;
 }
 
 /*
- * To do:
- *
- * Alternate BT4 & BT5 ?
- *
+ * The PHY comes from the core's interleaving policy.
  */
 
-int transmit_ble2(uint8_t *ble_message,int length) {
+int ID_OD_nRF52::transmit_ble(uint8_t *ble_message,int length,int phy) {
 
-  short int                    BT_type = 5, index = 0;
-  ODID_BasicID_encoded        *basic_encoded;
-  ODID_Auth_encoded_page_zero *auth_encoded;
-  
-  basic_encoded = (ODID_BasicID_encoded *)        &ble_message[6];
-  auth_encoded  = (ODID_Auth_encoded_page_zero *) &ble_message[6];
+  uint32_t status = 0;
 
 #if ID_OD_BT
 
@@ -214,7 +201,7 @@ int transmit_ble2(uint8_t *ble_message,int length) {
 
     diag = 1;
     
-    // This should go in init2, but doing it this way gives us chance to 
+    // This should go in init(), but doing it this way gives us chance to 
     // open the serial port.
 
     ble_version_t version;
@@ -231,64 +218,48 @@ int transmit_ble2(uint8_t *ble_message,int length) {
   }
 #endif
 
-  if (length < (ODID_MESSAGE_SIZE + 10)) {
+  // Message packs are too long for a legacy advert.
 
-    // Toggle between BT4 and BT5.
+  if (length > BLE_GAP_ADV_SET_DATA_SIZE_MAX) {
 
-    switch (basic_encoded->MessageType) {
+    phy = ID_OD_PHY_CODED;
+  }
 
-    case ODID_MESSAGETYPE_BASIC_ID:
+#if BLE_OPTION == 1
 
-      index = (basic_encoded->IDType < 6) ? basic_encoded->IDType: 0;
-      break;
+  if (phy == ID_OD_PHY_CODED) {
 
-    case ODID_MESSAGETYPE_LOCATION:
-    case ODID_MESSAGETYPE_SELF_ID:
-    case ODID_MESSAGETYPE_SYSTEM:
-    case ODID_MESSAGETYPE_OPERATOR_ID:
-      
-      index = basic_encoded->MessageType + 6;
-      break;
+    if (!sd_advertising) {
 
-    case ODID_MESSAGETYPE_AUTH:
-      index = auth_encoded->DataPage + 14;
-      break;
+      Bluefruit.Advertising.stop();
+    }
 
-    default:
+    status = sd_advert(ble_message,length,phy);
 
-      index = 0;
-      break;
-    }
+  } else {
 
-    BT_type               =  BT_type_toggle[index];
-    BT_type_toggle[index] = (BT_type_toggle[index] == 4) ? 5: 4;
-  } 
+    if (sd_advertising) {
 
-#if BLE_OPTION == 1
+      sd_ble_gap_adv_stop(adv_handle);
+      sd_advertising = 0;
+    }
 
-  Bluefruit.Advertising.stop();
+    Bluefruit.Advertising.stop();
+    Bluefruit.Advertising.setType(BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED);
+    Bluefruit.Advertising.setData(ble_message,length);
+    Bluefruit.Advertising.start(0);
+  }
 
-	if (BT_type == 4) {
+#elif BLE_OPTION == 2
 
-		Bluefruit.Advertising.setType(BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED);
-#if PATCHED_BLEADV
-		Bluefruit.Advertising.setPhy(BLE_GAP_PHY_AUTO);
-#endif
-	} else {
+  status = sd_advert(ble_message,length,phy);
 
-		Bluefruit.Advertising.setType(BLE_GAP_ADV_TYPE_EXTENDED_NONCONNECTABLE_SCANNABLE_UNDIRECTED);
-#if PATCHED_BLEADV
-		Bluefruit.Advertising.setPhy(BLE_GAP_PHY_CODED);
-#endif
-	}
+#endif  
 
-  Bluefruit.Advertising.setData(ble_message,length);
-  Bluefruit.Advertising.start(0);
-  
 #if DIAGNOSTICS
   if (Debug_Serial) {
 
-    sprintf(text,"\r%s %08x %2d BT%d ",__func__,ble_message,length,BT_type);
+    sprintf(text,"\r%s %08x %2d BT%d ",__func__,ble_message,length,(phy == ID_OD_PHY_CODED) ? 5: 4);
     Debug_Serial->print(text);
 
     for (int j = 0; j < 12; ++j) {
@@ -299,15 +270,94 @@ int transmit_ble2(uint8_t *ble_message,int length) {
   }
 #endif
 
-#elif BLE_OPTION == 2
+#endif
 
-#endif  
+  return (int) status;
+}
+
+/*
+ * A non-connectable advert, legacy or extended on the coded PHY, with the
+ * SoftDevice functions.
+ *
+ * The SoftDevice reads the data while advertising, so the buffers alternate.
+ * If the PHY is the same as the last advert's, the data is changed without
+ * stopping. Otherwise the set is stopped, reconfigured and restarted.
+ */
+
+#if ID_OD_BT
+
+uint32_t sd_advert(uint8_t *ble_message,int length,int phy) {
+
+  uint32_t             status;
+  uint8_t             *buffer;
+  ble_gap_adv_params_t params;
+  ble_gap_adv_data_t   data;
+
+  if (length > BLE_GAP_ADV_SET_DATA_SIZE_EXTENDED_MAX_SUPPORTED) {
+
+    return NRF_ERROR_INVALID_LENGTH;
+  }
+
+  buffer = adv_data[adv_buffer ^= 1];
+
+  memcpy(buffer,ble_message,length);
 
+  memset(&data,0,sizeof(data));
+
+  data.adv_data.p_data = buffer;
+  data.adv_data.len    = length;
+
+  if ((sd_advertising)&&(phy == sd_phy)) {
+
+    return sd_ble_gap_adv_set_configure(&adv_handle,&data,NULL);
+  }
+
+  memset(&params,0,sizeof(params));
+
+  if (phy == ID_OD_PHY_CODED) {
+
+    params.properties.type = BLE_GAP_ADV_TYPE_EXTENDED_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+    params.primary_phy     = BLE_GAP_PHY_CODED;
+    params.secondary_phy   = BLE_GAP_PHY_CODED;
+    params.interval        = EXT_ADV_INTERVAL;
+
+  } else {
+
+    params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+    params.primary_phy     = BLE_GAP_PHY_1MBPS;
+    params.interval        = ADV_INTERVAL;
+  }
+
+  params.duration      = 0;
+  params.filter_policy = BLE_GAP_ADV_FP_ANY;
+
+  if (sd_advertising) {
+
+    sd_ble_gap_adv_stop(adv_handle);
+    sd_advertising = 0;
+  }
+
+  if (((status = sd_ble_gap_adv_set_configure(&adv_handle,&data,&params)) == NRF_SUCCESS)&&
+      ((status = sd_ble_gap_adv_start(adv_handle,BLE_CONN_CFG_TAG_DEFAULT)) == NRF_SUCCESS)) {
+
+    sd_advertising = 1;
+    sd_phy         = phy;
+  }
+
+#if DIAGNOSTICS
+  if ((status != NRF_SUCCESS)&&(Debug_Serial)) {
+
+    sprintf(text,"\r%s %2d BT%d 0x%04lx\n",__func__,length,(phy == ID_OD_PHY_CODED) ? 5: 4,
+            (unsigned long) status);
+    Debug_Serial->print(text);
+  }
 #endif
 
-  return 0;
+  return status;
 }
 
+#endif
+
 /*
  *
  */
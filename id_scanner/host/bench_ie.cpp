@@ -0,0 +1,473 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Benchmark and fuzzer for the scanner's WiFi decoding (rid_ie.cpp) on a
+ * Linux host.
+ *
+ * The corpus is the frames in the pcap files given (802.11, link type 105,
+ * or radiotap, 127), such as id_open's bench_transmit writes with -w, or, if
+ * there are none, a French beacon, an ASD-STAN beacon, a Parrot beacon, a
+ * NAN action frame and an access point's beacon without remote ID. Each
+ * frame goes through the same dispatch as decode_wifi(), and the frames per
+ * second and the frames decoded are reported.
+ *
+ * With -z, each iteration takes a frame from the corpus, mutates it (bit
+ * flips, a truncation, an IE length byte or a byte set to 0, 0xff or a
+ * random value), copies it to a buffer of exactly its length and decodes
+ * it. Build with -fsanitize=address,undefined to catch reads past the end.
+ * The IDs decoded are checked to be terminated.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * Usage: bench_ie [-f frames] [-z iterations] [-s seed] [file.pcap ...]
+ *
+ * See README.md for building.
+ *
+ */
+
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "rid_ie.h"
+#include "odid_wifi.h"
+
+#define MAX_FRAMES  65536
+#define MAX_FRAME   2346
+
+struct frame {
+
+  uint8_t *data;
+  int      length;
+};
+
+static uint64_t wall_nsecs(void);
+static uint32_t xorshift(void);
+static int      read_pcap(const char *);
+static void     add_frame(const uint8_t *,int);
+static void     synthetic(void);
+static int      decode(const uint8_t *,int,struct rid_fields *);
+static void     bench(int);
+static void     fuzz(int);
+static int      mutate(const struct frame *,uint8_t *);
+
+static struct frame corpus[MAX_FRAMES];
+static int          corpus_size = 0;
+
+static uint32_t     rng_state = 2463534242UL;
+
+/*
+ *
+ */
+
+int main(int argc,char *argv[]) {
+
+  int i, opt, frames = 1000000, iterations = 0;
+
+  while ((opt = getopt(argc,argv,"f:z:s:")) != -1) {
+
+    switch (opt) {
+
+    case 'f':
+      frames = atoi(optarg);
+      break;
+
+    case 'z':
+      iterations = atoi(optarg);
+      break;
+
+    case 's':
+      if (!(rng_state = (uint32_t) strtoul(optarg,NULL,0))) {
+        rng_state = 1;
+      }
+      break;
+
+    default:
+      fprintf(stderr,"usage: %s [-f frames] [-z iterations] [-s seed] [file.pcap ...]\n",argv[0]);
+      return 1;
+    }
+  }
+
+  for (i = optind; i < argc; ++i) {
+
+    if (read_pcap(argv[i]) < 0) {
+
+      fprintf(stderr,"%s: can't read %s\n",argv[0],argv[i]);
+      return 1;
+    }
+  }
+
+  if (!corpus_size) {
+
+    synthetic();
+  }
+
+  bench(frames);
+
+  if (iterations > 0) {
+
+    fuzz(iterations);
+  }
+
+  for (i = 0; i < corpus_size; ++i) {
+
+    free(corpus[i].data);
+  }
+
+  return 0;
+}
+
+/*
+ * As decode_wifi().
+ */
+
+int decode(const uint8_t *frame,int length,struct rid_fields *fields) {
+
+  char                  ssid[RID_SSID_SIZE];
+  static const uint8_t  nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
+
+  if ((length >= 10)&&(memcmp(nan_dest,&frame[4],6) == 0)) {
+
+    return rid_decode_nan(frame,length,fields);
+  }
+
+  if ((length > 0)&&(frame[0] == 0x80)) {
+
+    return rid_decode_beacon(frame,length,fields,ssid);
+  }
+
+  return 0;
+}
+
+/*
+ *
+ */
+
+void bench(int frames) {
+
+  int               i, passes, decoded = 0, french = 0, odid = 0;
+  long int          total;
+  uint64_t          start, nsecs;
+  struct rid_fields fields;
+
+  passes = (frames + corpus_size - 1) / corpus_size;
+  total  = (long int) passes * corpus_size;
+
+  start  = wall_nsecs();
+
+  for (int pass = 0; pass < passes; ++pass) {
+
+    for (i = 0; i < corpus_size; ++i) {
+
+      if (decode(corpus[i].data,corpus[i].length,&fields)) {
+
+        if (!pass) {
+
+          ++decoded;
+          french += (fields.formats & RID_FRENCH) ? 1: 0;
+          odid   += (fields.formats & RID_ODID)   ? 1: 0;
+        }
+      }
+    }
+  }
+
+  nsecs = wall_nsecs() - start;
+
+  printf("%-8s %8s %8s %8s %10s %8s %12s\n",
+         "corpus","remote","french","odid","frames","ns","frames/s");
+  printf("%-8d %8d %8d %8d %10ld %8.1f %12.0f\n",
+         corpus_size,decoded,french,odid,total,
+         (double) nsecs / (double) total,1.0e9 * (double) total / (double) nsecs);
+
+  return;
+}
+
+/*
+ *
+ */
+
+void fuzz(int iterations) {
+
+  int               i, length, decoded = 0, bad = 0;
+  uint8_t          *copy, buffer[MAX_FRAME];
+  struct rid_fields fields;
+
+  for (i = 0; i < iterations; ++i) {
+
+    length = mutate(&corpus[xorshift() % corpus_size],buffer);
+    copy   = (uint8_t *) malloc(length ? length: 1);
+
+    memcpy(copy,buffer,length);
+
+    if (decode(copy,length,&fields)) {
+
+      ++decoded;
+
+      if ((strnlen(fields.uas_id,RID_ID_SIZE) == RID_ID_SIZE)||
+          (strnlen(fields.op_id,RID_ID_SIZE)  == RID_ID_SIZE)) {
+
+        ++bad;
+      }
+    }
+
+    free(copy);
+  }
+
+  printf("\n%-10s %8s %8s\n","mutations","decoded","bad");
+  printf("%-10d %8d %8d\n",iterations,decoded,bad);
+
+  return;
+}
+
+// Returns the length of the mutated frame in buffer.
+
+int mutate(const struct frame *original,uint8_t *buffer) {
+
+  int i, length, offset, ies[64], count = 0;
+
+  length = original->length;
+  memcpy(buffer,original->data,length);
+
+  for (offset = 36; ((offset + 1) < length)&&(count < 64); offset += buffer[offset + 1] + 2) {
+
+    ies[count++] = offset + 1;
+  }
+
+  switch (xorshift() % 5) {
+
+  case 0:
+
+    for (i = 1 + xorshift() % 8; i > 0; --i) {
+
+      buffer[xorshift() % length] ^= (uint8_t) (1 << (xorshift() % 8));
+    }
+    break;
+
+  case 1:
+
+    length = xorshift() % (length + 1);
+    break;
+
+  case 2:
+
+    if (count) {
+
+      buffer[ies[xorshift() % count]] = (uint8_t) xorshift();
+    }
+    break;
+
+  case 3:
+
+    i         = xorshift() % 3;
+    buffer[xorshift() % length] = (i == 0) ? 0x00: (i == 1) ? 0xff: (uint8_t) xorshift();
+    break;
+
+  default:
+
+    if (count) {                            // An IE length byte one too long.
+
+      ++buffer[ies[xorshift() % count]];
+    }
+    break;
+  }
+
+  return length;
+}
+
+/*
+ *
+ */
+
+int read_pcap(const char *file) {
+
+  int       link, length, skip;
+  uint32_t  header[6], record[4];
+  uint8_t   buffer[65536];
+  FILE     *pcap;
+
+  if ((pcap = fopen(file,"rb")) == NULL) {
+
+    return -1;
+  }
+
+  if ((fread(header,sizeof(header),1,pcap) != 1)||(header[0] != 0xa1b2c3d4)) {
+
+    fclose(pcap);
+    return -1;
+  }
+
+  link = (int) header[5];
+
+  while (fread(record,sizeof(record),1,pcap) == 1) {
+
+    length = (int) record[2];
+
+    if ((length > (int) sizeof(buffer))||(fread(buffer,1,length,pcap) != (size_t) length)) {
+
+      break;
+    }
+
+    skip = 0;
+
+    if (link == 127) {                      // Radiotap, the length is at 2.
+
+      skip = (length >= 4) ? (buffer[2] | (buffer[3] << 8)): length;
+    } else if (link != 105) {
+
+      continue;
+    }
+
+    if (skip < length) {
+
+      add_frame(&buffer[skip],length - skip);
+    }
+  }
+
+  fclose(pcap);
+
+  return 0;
+}
+
+void add_frame(const uint8_t *data,int length) {
+
+  if ((corpus_size >= MAX_FRAMES)||(length > MAX_FRAME)||(length < 1)) {
+
+    return;
+  }
+
+  corpus[corpus_size].data   = (uint8_t *) malloc(length);
+  corpus[corpus_size].length = length;
+
+  memcpy(corpus[corpus_size++].data,data,length);
+
+  return;
+}
+
+/*
+ *
+ */
+
+void synthetic() {
+
+  int            i, length;
+  char           mac[6] = {0x02, 0x00, 0x00, 0x12, 0x34, 0x56};
+  uint8_t        frame[512], *p;
+  ODID_UAS_Data  UAS_data;
+  static const uint8_t french[] = {0xdd, 0x00, 0x6a, 0x5c, 0x35, 0x01,
+                                   0x01, 0x01, 0x01,
+                                   0x02, 0x1e, 'F', 'R', 'A', 'F', 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J',
+                                               'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+                                   0x03, 0x0c, 'I', 'D', 'F', 'R', 'A', 'N', 'C', 'E', '0', '0', '0', '1',
+                                   0x04, 0x04, 0x00, 0x48, 0x95, 0x4c,
+                                   0x05, 0x04, 0x00, 0x03, 0x93, 0x87,
+                                   0x06, 0x02, 0x00, 0x8c,
+                                   0x07, 0x02, 0x00, 0x32,
+                                   0x08, 0x04, 0x00, 0x48, 0x95, 0x00,
+                                   0x09, 0x04, 0x00, 0x03, 0x93, 0x00,
+                                   0x0a, 0x01, 0x07,
+                                   0x0b, 0x02, 0x00, 0x5a};
+  static const uint8_t ap_ies[] = {0x00, 0x08, 'H', 'o', 'm', 'e', 'W', 'i', 'F', 'i',
+                                   0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24,
+                                   0x03, 0x01, 0x06,
+                                   0x05, 0x04, 0x00, 0x01, 0x00, 0x00,
+                                   0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+                                               0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x00, 0x00,
+                                   0x2d, 0x1a, 0xef, 0x11, 0x1b, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                               0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                               0x00,
+                                   0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x80, 0x00, 0x03, 0xa4, 0x00, 0x00,
+                                               0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+                                   0xdd, 0x07, 0x00, 0x50, 0xf2, 0x04, 0x10, 0x4a, 0x00};
+
+  memset(frame,0,sizeof(frame));
+
+  frame[0] = 0x80;
+  memset(&frame[4],0xff,6);
+  memcpy(&frame[10],mac,6);
+  memcpy(&frame[16],mac,6);
+  frame[32] = 0x64;
+
+  // French.
+
+  p = &frame[36];
+  *p++ = 0x00; *p++ = 0x04; memcpy(p,"FR01",4); p += 4;
+  memcpy(p,french,sizeof(french));
+  p[1] = sizeof(french) - 2;
+  add_frame(frame,(int) (p - frame) + sizeof(french));
+
+  // An access point.
+
+  memcpy(&frame[36],ap_ies,sizeof(ap_ies));
+  add_frame(frame,36 + sizeof(ap_ies));
+
+  // ODID, as a beacon, a Parrot beacon and a NAN action frame.
+
+  memset(&UAS_data,0,sizeof(UAS_data));
+
+  UAS_data.BasicIDValid[0] = 1;
+  UAS_data.BasicID[0].IDType = ODID_IDTYPE_SERIAL_NUMBER;
+  strcpy(UAS_data.BasicID[0].UASID,"1596A0000000001");
+  UAS_data.LocationValid = 1;
+  UAS_data.Location.Latitude  = 51.4791;
+  UAS_data.Location.Longitude = -0.0013;
+  UAS_data.Location.AltitudeGeo = 60.0;
+  UAS_data.Location.Height = 20.0;
+  UAS_data.SystemValid = 1;
+  UAS_data.System.OperatorLatitude  = 51.4790;
+  UAS_data.System.OperatorLongitude = -0.0015;
+  UAS_data.OperatorIDValid = 1;
+  strcpy(UAS_data.OperatorID.OperatorId,"GBR-OP-1234ABCDEFGH");
+
+  if ((length = odid_wifi_build_message_pack_beacon_frame(&UAS_data,mac,"UAV-0001",8,100,1,frame,sizeof(frame))) > 0) {
+
+    add_frame(frame,length);
+
+    for (i = 36; (i + 5) < length; i += frame[i + 1] + 2) {
+
+      if ((frame[i] == 0xdd)&&(frame[i + 2] == 0xfa)) {
+
+        frame[i + 2] = 0x90; frame[i + 3] = 0x3a; frame[i + 4] = 0xe6; frame[i + 5] = 0x01;
+        add_frame(frame,length);
+        break;
+      }
+    }
+  }
+
+  if ((length = odid_wifi_build_message_pack_nan_action_frame(&UAS_data,mac,1,frame,sizeof(frame))) > 0) {
+
+    add_frame(frame,length);
+  }
+
+  return;
+}
+
+/*
+ *
+ */
+
+uint64_t wall_nsecs() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+uint32_t xorshift() {
+
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+/*
+ *
+ */
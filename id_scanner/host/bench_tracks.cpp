@@ -0,0 +1,565 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Benchmark for the scanner's track table on a Linux host.
+ *
+ * For 8, 64 and 512 tracks, frames from randomly chosen transmitters are
+ * looked up with track_find() and with the linear search that next_uav()
+ * used to do, and the ns per lookup of each are reported. Every other frame
+ * carries its UAV's UAS ID, as ODID beacons with a Basic ID do. The churn
+ * rows have twice as many transmitters as tracks; for those the evictions
+ * are reported, the linear search's being the overwrites of its last track,
+ * and each eviction is checked to have been of the least recently seen
+ * track.
+ *
+ * The second table is loop()'s scan of the tracks (the expiry, the flag
+ * and the TFT projection of the flagged tracks) with the old struct per
+ * track and with the structure of arrays in uav_state.h. It reports the
+ * bytes of each, the ns per scan with the tracks in the cache and after
+ * the cache has been flushed, and the cache lines that a scan reads. A
+ * sixteenth of the tracks are flagged for each scan.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * Usage: bench_tracks [-f frames]
+ *
+ * See README.md for building.
+ *
+ */
+
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "tracks.h"
+#include "uav_state.h"
+
+struct transmitter {
+
+  uint8_t mac[6];
+  char    id[TRACK_ID_SIZE];
+};
+
+struct linear_uav {
+
+  uint8_t mac[6];
+  char    uav_id[TRACK_ID_SIZE];
+};
+
+struct old_id_data {int       flag;            // As id_scanner's struct id_data was.
+                    uint8_t   mac[6];
+                    uint32_t  last_seen;
+                    char      op_id[TRACK_ID_SIZE];
+                    char      uav_id[TRACK_ID_SIZE];
+                    double    lat_d, long_d, base_lat_d, base_long_d;
+                    int       altitude_msl, height_agl, speed, heading, rssi;
+};
+
+#define CACHE_LINE    64
+#define FLUSH_BYTES   (8 << 20)
+#define SCANS         20000
+
+static uint64_t wall_nsecs(void);
+static uint32_t xorshift(void);
+static int      linear_next_uav(struct linear_uav *,int,const uint8_t *,int *);
+static void     run(int,int,int);
+static void     layout(int);
+static int      scan_old(struct old_id_data *,int,uint32_t,uintptr_t *);
+static int      scan_soa(struct uav_state *,int,uint32_t,uintptr_t *);
+static int      count_lines(uintptr_t *,int);
+static void     flush_cache(void);
+
+static uint8_t *flush_buffer = NULL;
+
+static uint32_t rng_state = 2463534242UL;
+
+/*
+ *
+ */
+
+int main(int argc,char *argv[]) {
+
+  int i, opt, frames = 1000000;
+  static const int sizes[] = {8, 64, 512};
+
+  while ((opt = getopt(argc,argv,"f:")) != -1) {
+
+    switch (opt) {
+
+    case 'f':
+      frames = atoi(optarg);
+      break;
+
+    default:
+      fprintf(stderr,"usage: %s [-f frames]\n",argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%-6s %8s %8s %10s %10s %8s %9s %9s %6s\n",
+         "tracks","txs","frames","linear ns","hash ns","probes","lin evict","evicted","lru");
+
+  for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); ++i) {
+
+    run(sizes[i],sizes[i],frames);
+    run(sizes[i],2 * sizes[i],frames);
+  }
+
+  printf("\n%-6s %9s %9s %9s %9s %11s %11s %9s %9s\n",
+         "tracks","struct B","arrays B","struct ns","arrays ns","struct cold","arrays cold","struct ln","arrays ln");
+
+  flush_buffer = (uint8_t *) calloc(1,FLUSH_BYTES);
+
+  for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); ++i) {
+
+    layout(sizes[i]);
+  }
+
+  free(flush_buffer);
+
+  return 0;
+}
+
+/*
+ *
+ */
+
+void run(int capacity,int txs,int frames) {
+
+  int                 i, j, k, outcome, lin_evicted = 0, lru_ok = 1, *sequence;
+  uint32_t           *last_seen;
+  uint64_t            start, linear_ns, hash_ns;
+  volatile int        sink = 0;
+  struct transmitter *tx;
+  struct linear_uav  *linear;
+  struct track_table  table;
+
+  tx        = (struct transmitter *) calloc(txs,sizeof(struct transmitter));
+  linear    = (struct linear_uav *)  calloc(capacity,sizeof(struct linear_uav));
+  last_seen = (uint32_t *)           calloc(capacity,sizeof(uint32_t));
+  sequence  = (int *)                malloc(frames * sizeof(int));
+
+  if ((!tx)||(!linear)||(!last_seen)||(!sequence)||
+      (track_table_init(&table,capacity))) {
+
+    fprintf(stderr,"out of memory\n");
+    exit(1);
+  }
+
+  for (i = 0; i < txs; ++i) {
+
+    for (j = 0; j < 6; ++j) {
+
+      tx[i].mac[j] = (uint8_t) xorshift();
+    }
+
+    tx[i].mac[0] |= 0x02; // Locally administered, as randomised MACs are, and never 0.
+
+    sprintf(tx[i].id,"1596F%015u",(unsigned int) xorshift());
+  }
+
+  for (i = 0; i < frames; ++i) {
+
+    sequence[i] = xorshift() % txs;
+  }
+
+  // Linear, as next_uav() was.
+
+  start = wall_nsecs();
+
+  for (i = 0; i < frames; ++i) {
+
+    k     = linear_next_uav(linear,capacity,tx[sequence[i]].mac,&lin_evicted);
+    sink += linear[k].mac[5];
+
+    if (i & 1) {
+
+      memcpy(linear[k].uav_id,tx[sequence[i]].id,TRACK_ID_SIZE);
+    }
+  }
+
+  linear_ns = wall_nsecs() - start;
+
+  // Hash table.
+
+  start = wall_nsecs();
+
+  for (i = 0; i < frames; ++i) {
+
+    sink += track_find(&table,tx[sequence[i]].mac,(i & 1) ? tx[sequence[i]].id: NULL,NULL);
+  }
+
+  hash_ns = wall_nsecs() - start;
+
+  // Check the evictions, untimed.
+
+  track_table_free(&table);
+  track_table_init(&table,capacity);
+
+  for (i = 0; i < frames; ++i) {
+
+    k = track_find(&table,tx[sequence[i]].mac,(i & 1) ? tx[sequence[i]].id: NULL,&outcome);
+
+    if (outcome == TRACK_EVICTED) {
+
+      for (j = 0; j < capacity; ++j) {
+
+        if ((j != k)&&(last_seen[j] < last_seen[k])) {
+
+          lru_ok = 0;
+        }
+      }
+    }
+
+    if ((outcome != TRACK_FOUND)&&(memcmp(table.keys[k].mac,tx[sequence[i]].mac,6))) {
+
+      lru_ok = 0;
+    }
+
+    last_seen[k] = i + 1;
+  }
+
+  printf("%6d %8d %8d %10.1f %10.1f %8.3f %9d %9u %6s\n",
+         capacity,txs,frames,
+         (double) linear_ns / frames,(double) hash_ns / frames,
+         (double) table.stats.probes / table.stats.lookups,
+         lin_evicted,table.stats.evicted,lru_ok ? "ok": "FAIL");
+
+  track_table_free(&table);
+
+  free(tx);
+  free(linear);
+  free(last_seen);
+  free(sequence);
+
+  return;
+}
+
+/*
+ * loop()'s scan, warm and cold, with both layouts. The memory is as the
+ * scanner allocates it: the tracks plus the keep alive, and for the arrays
+ * the cold pointers and the strings' pool blocks as well.
+ */
+
+void layout(int count) {
+
+  int                 i, pass, k, old_lines, soa_lines;
+  size_t              old_bytes, soa_bytes;
+  uint32_t            msecs = 1000000;
+  uint64_t            start, old_ns, soa_ns, old_cold = 0, soa_cold = 0;
+  uintptr_t          *lines;
+  volatile int        sink = 0;
+  struct old_id_data *old;
+  struct uav_state    soa;
+  void               *soa_memory;
+
+  old_bytes  = (count + 1) * sizeof(struct old_id_data);
+  soa_bytes  = uav_state_bytes(count + 1) + ((count + 1) * sizeof(void *)) +
+               (count * uav_state_array(2 * TRACK_ID_SIZE));
+
+  old        = (struct old_id_data *) calloc(count + 1,sizeof(struct old_id_data));
+  soa_memory = calloc(1,uav_state_bytes(count + 1));
+  lines      = (uintptr_t *) malloc(8 * (count + 1) * sizeof(uintptr_t));
+
+  uav_state_init(&soa,soa_memory,count + 1);
+
+  for (i = 0; i < count; ++i) {
+
+    old[i].last_seen = soa.last_seen[i] = msecs - (xorshift() % 5000);
+    old[i].lat_d     = 51.5 + 0.001 * (xorshift() % 100);
+    old[i].long_d    = -0.1 - 0.001 * (xorshift() % 100);
+    old[i].base_lat_d = 51.5;
+    soa.lat[i]       = uav_e7(old[i].lat_d);
+    soa.lon[i]       = uav_e7(old[i].long_d);
+    soa.base_lat[i]  = uav_e7(old[i].base_lat_d);
+  }
+
+  // Warm.
+
+  start = wall_nsecs();
+
+  for (pass = 0; pass < SCANS; ++pass) {
+
+    for (k = 0; k < count; k += 16) {
+
+      old[(pass + k) & (count - 1)].flag = 1;
+    }
+
+    sink += scan_old(old,count,msecs,NULL);
+  }
+
+  old_ns = (wall_nsecs() - start) / SCANS;
+
+  start = wall_nsecs();
+
+  for (pass = 0; pass < SCANS; ++pass) {
+
+    for (k = 0; k < count; k += 16) {
+
+      soa.flag[(pass + k) & (count - 1)] = 1;
+    }
+
+    sink += scan_soa(&soa,count,msecs,NULL);
+  }
+
+  soa_ns = (wall_nsecs() - start) / SCANS;
+
+  // Cold.
+
+  for (pass = 0; pass < 200; ++pass) {
+
+    for (k = 0; k < count; k += 16) {
+
+      old[(pass + k) & (count - 1)].flag = 1;
+      soa.flag[(pass + k) & (count - 1)] = 1;
+    }
+
+    flush_cache();
+    start     = wall_nsecs();
+    sink     += scan_old(old,count,msecs,NULL);
+    old_cold += wall_nsecs() - start;
+
+    flush_cache();
+    start     = wall_nsecs();
+    sink     += scan_soa(&soa,count,msecs,NULL);
+    soa_cold += wall_nsecs() - start;
+  }
+
+  // Lines.
+
+  for (k = 0; k < count; k += 16) {
+
+    old[k].flag = soa.flag[k] = 1;
+  }
+
+  old_lines = count_lines(lines,scan_old(old,count,msecs,lines));
+  soa_lines = count_lines(lines,scan_soa(&soa,count,msecs,lines));
+
+  printf("%6d %9u %9u %9.1f %9.1f %11.1f %11.1f %9d %9d\n",
+         count,(unsigned int) old_bytes,(unsigned int) soa_bytes,
+         (double) old_ns,(double) soa_ns,old_cold / 200.0,soa_cold / 200.0,
+         old_lines,soa_lines);
+
+  free(old);
+  free(soa_memory);
+  free(lines);
+
+  return;
+}
+
+/*
+ * As loop(), without the printing, the old one track at a time and the new
+ * as it is now. If lines isn't NULL, the addresses read are put in it and
+ * their number returned.
+ */
+
+int scan_old(struct old_id_data *uavs,int count,uint32_t msecs,uintptr_t *lines) {
+
+  int    i, n = 0;
+  double x_m, y_m, sum = 0.0;
+
+  for (i = 0; i < count; ++i) {
+
+    if (lines) {
+
+      lines[n++] = (uintptr_t) &uavs[i].last_seen;
+      lines[n++] = (uintptr_t) &uavs[i].flag;
+    }
+
+    if ((uavs[i].last_seen)&&
+        ((msecs - uavs[i].last_seen) > 300000L)) {
+
+      uavs[i].last_seen = 0;
+    }
+
+    if (uavs[i].flag) {
+
+      if (lines) {
+
+        lines[n++] = (uintptr_t) &uavs[i].lat_d;
+        lines[n++] = (uintptr_t) &uavs[i].long_d;
+        lines[n++] = (uintptr_t) &uavs[i].base_lat_d;
+      }
+
+      if ((uavs[i].lat_d)&&(uavs[i].base_lat_d)) {
+
+        y_m  = (uavs[i].lat_d  - 51.5) * 111000.0;
+        x_m  = (uavs[i].long_d + 0.1)  *  69000.0;
+        sum += x_m + y_m;
+      }
+
+      uavs[i].flag = 0;
+    }
+  }
+
+  return (lines) ? n: (int) sum;
+}
+
+int scan_soa(struct uav_state *uavs,int count,uint32_t msecs,uintptr_t *lines) {
+
+  int       i, j, n = 0, expired = 0;
+  uint8_t  *flag = uavs->flag;
+  uint32_t *last_seen = uavs->last_seen;
+  uint64_t  flags;
+  double    x_m, y_m, sum = 0.0;
+
+  for (i = 0; i < count; ++i) {
+
+    expired |= (last_seen[i] != 0) & ((msecs - last_seen[i]) > 300000L);
+  }
+
+  if (lines) {
+
+    for (i = 0; i < count; ++i) {
+
+      lines[n++] = (uintptr_t) &last_seen[i];
+    }
+  }
+
+  if (expired) {
+
+    for (i = 0; i < count; ++i) {
+
+      if ((last_seen[i])&&
+          ((msecs - last_seen[i]) > 300000L)) {
+
+        last_seen[i] = 0;
+      }
+    }
+  }
+
+  for (i = 0; i < count; i += 8) {
+
+    if (lines) {
+
+      lines[n++] = (uintptr_t) &flag[i];
+    }
+
+    memcpy(&flags,&flag[i],8);
+
+    while (flags) {
+
+      j      = i + (__builtin_ctzll(flags) >> 3);
+      flags &= flags - 1;
+
+      if (lines) {
+
+        lines[n++] = (uintptr_t) &uavs->lat[j];
+        lines[n++] = (uintptr_t) &uavs->lon[j];
+        lines[n++] = (uintptr_t) &uavs->base_lat[j];
+      }
+
+      if ((uavs->lat[j])&&(uavs->base_lat[j])) {
+
+        y_m  = (uav_deg(uavs->lat[j]) - 51.5) * 111000.0;
+        x_m  = (uav_deg(uavs->lon[j]) + 0.1)  *  69000.0;
+        sum += x_m + y_m;
+      }
+
+      flag[j] = 0;
+    }
+  }
+
+  return (lines) ? n: (int) sum;
+}
+
+int count_lines(uintptr_t *lines,int n) {
+
+  int i, j, distinct = 0;
+
+  for (i = 0; i < n; ++i) {
+
+    for (j = 0; (j < i)&&((lines[j] / CACHE_LINE) != (lines[i] / CACHE_LINE)); ++j) {;}
+
+    if (j == i) {
+
+      ++distinct;
+    }
+  }
+
+  return distinct;
+}
+
+void flush_cache() {
+
+  int              i;
+  volatile uint8_t sum = 0;
+
+  for (i = 0; i < FLUSH_BYTES; i += CACHE_LINE) {
+
+    flush_buffer[i] += 1;
+    sum             += flush_buffer[i];
+  }
+
+  return;
+}
+
+/*
+ * The old search, a match, else a free track, else the last one.
+ */
+
+int linear_next_uav(struct linear_uav *uavs,int max_uavs,const uint8_t *mac,int *evicted) {
+
+  int i, found = -1;
+
+  for (i = 0; i < max_uavs; ++i) {
+
+    if (memcmp(uavs[i].mac,mac,6) == 0) {
+
+      found = i;
+    }
+  }
+
+  if (found < 0) {
+
+    for (i = 0; i < max_uavs; ++i) {
+
+      if (!uavs[i].mac[0]) {
+
+        found = i;
+        break;
+      }
+    }
+  }
+
+  if (found < 0) {
+
+    found = max_uavs - 1;
+    ++*evicted;
+  }
+
+  memcpy(uavs[found].mac,mac,6);
+
+  return found;
+}
+
+/*
+ *
+ */
+
+uint64_t wall_nsecs() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+uint32_t xorshift() {
+
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+/*
+ *
+ */
@@ -7,6 +7,12 @@
  *
  * MIT licence.
  * 
+ * Oct. '26     The WiFi callback only copies candidate frames into a ring, loop() decodes them.
+ *              Tracks are found with a hashed index (tracks.h) and the least recently seen is evicted.
+ *              The track pool is sized at boot, the strings and log files come from block pools.
+ *              The track state is a structure of arrays (uav_state.h), the strings a cold table.
+ *              The beacon IEs are walked with a bounds checked iterator and vendor IEs are
+ *              dispatched on OUI and type through a table of decoders (rid_ie.h).
  * Nov. '21     Added option to dump ODID frame to serial output.
  * Oct. '21     Updated for opendroneid release 1.0.
  * June '21     Added an option to log to an SD card.
@@ -17,7 +23,30 @@
  *
  * Notes
  * 
- * May need a semaphore.
+ * The promiscuous callback runs in the WiFi driver's task. It copies beacons
+ * and NAN action frames into rx_ring.h's slots and returns, everything else
+ * (the IE walk, opendroneid, the track table) is done by loop(), which is
+ * then the only thing that touches the tracks. BLE adverts have their own ring.
+ *
+ * A track is looked up by the transmitter's MAC and, if the frame has a
+ * Basic ID, by the UAS ID, so a UAV that changes its MAC keeps its track.
+ * Tracks are only made for frames with remote ID in them. When the table is
+ * full the track that has gone longest without a frame is replaced.
+ *
+ * The number of tracks is set in setup() from the free PSRAM, or heap if
+ * there isn't any, between MIN_UAVS and MAX_UAVS. The ID strings and the SD
+ * log files are only wanted once a track has them, so they come from fixed
+ * block pools (pool.h) that are allocated at the same time. Nothing is
+ * allocated once the scanner is running.
+ *
+ * The state of the tracks is held as arrays (uav_state.h), so that loop()'s
+ * scan of the tracks only reads last_seen[] and flag[]. The pointers to the
+ * strings and log files are in a cold array of their own.
+ *
+ * Beacons and NAN frames are decoded by rid_ie.cpp into a neutral set of
+ * fields, which apply_rid() copies to the track. Vendor IEs are matched on
+ * OUI and type in its vendor_ies[] table, so another national format is a
+ * decoder and one more entry there.
  * 
  */
 
@@ -37,6 +66,11 @@
 #include <nvs_flash.h>
 
 #include "opendroneid.h"
+#include "rx_ring.h"
+#include "tracks.h"
+#include "pool.h"
+#include "uav_state.h"
+#include "rid_ie.h"
 
 //
 
@@ -60,7 +94,11 @@
 #define TRACK_TIME       120 // secs, 600
 
 #define ID_SIZE     (ODID_ID_SIZE + 1)
-#define MAX_UAVS           8
+#define MIN_UAVS           8
+#define MAX_UAVS         256
+#define TRACK_RAM_SHARE    8 // The tracks may have 1/8 of the free memory.
+#define SD_LOG_FILES       8 // Open at once.
+#define TRACK_COLOURS      8
 #define OP_DISPLAY_LIMIT  16
 
 //
@@ -68,6 +106,7 @@
 #if SD_LOGGER
 
 #include <SD.h>
+#include <new>
 // #include <SdFat.h>
 
 // #define SD_CONFIG       SdSpiConfig(SD_CS,DEDICATED_SPI,SD_SCK_MHZ(16))
@@ -88,13 +127,9 @@
 
 //
 
-struct id_data {int       flag;
-                uint8_t   mac[6];
-                uint32_t  last_seen;
+struct id_strings {
                 char      op_id[ID_SIZE];
                 char      uav_id[ID_SIZE];
-                double    lat_d, long_d, base_lat_d, base_long_d;
-                int       altitude_msl, height_agl, speed, heading, rssi;
 };
 
 #if SD_LOGGER
@@ -104,30 +139,53 @@ struct id_log  {int8_t    flushed;
 };
 #endif
 
+struct id_cold {struct id_strings *strings; // NULL until the track has an ID.
+#if SD_LOGGER
+                struct id_log     *log;     // NULL until the track is logged.
+#endif
+};
+
 //
 
-static void               print_json(int,int,struct id_data *);
-static void               write_log(uint32_t,struct id_data *,struct id_log *);
+static void               print_json(int,int);
+static void               write_log(uint32_t,int);
 static esp_err_t          event_handler(void *,system_event_t *);
 static void               callback(void *,wifi_promiscuous_pkt_type_t);
-static struct id_data    *next_uav(uint8_t *);
-static void               parse_french_id(struct id_data *,uint8_t *);
-static void               parse_odid(struct id_data *,ODID_UAS_Data *);
+static void               decode_wifi(struct rx_slot *);
+#if BLE_SCAN
+static void               decode_ble(struct rx_slot *);
+#endif
+static int                next_uav(uint8_t *,const char *,struct rx_slot *);
+static void               release_uav(int);
+static const uint8_t     *uav_mac(int);
+static struct id_strings *uav_strings(int);
+static const char        *uav_op_id(int);
+static const char        *uav_uas_id(int);
+static void               apply_rid(int,struct rid_fields *);
                         
 static void               dump_frame(uint8_t *,int);
 static void               calc_m_per_deg(double,double,double *,double *);
 static char              *format_op_id(char *);
 
 static double             base_lat_d = 0.0, base_long_d = 0.0, m_deg_lat = 110000.0, m_deg_long = 110000.0;
+static struct block_pool  strings_pool;
 #if SD_LOGGER
-static struct id_log      logfiles[MAX_UAVS + 1];
+static struct block_pool  log_pool;
 #endif
+static struct id_strings  none_strings = {"NONE", ""};
 
-volatile char             ssid[10];
-volatile unsigned int     callback_counter = 0, french_wifi = 0, odid_wifi = 0, odid_ble = 0;
-volatile struct id_data   uavs[MAX_UAVS + 1];
+char                      ssid[10];
+volatile unsigned int     callback_counter = 0;
+unsigned int              french_wifi = 0, odid_wifi = 0, odid_ble = 0;
+int                       max_uavs = 0;
+struct uav_state          uavs;        // max_uavs + 1, the last is for the keep alive.
+struct id_cold           *cold = NULL;
 
-volatile ODID_UAS_Data    UAS_data;
+static struct track_table tracks;
+static struct rx_ring     wifi_ring;
+#if BLE_SCAN
+static struct rx_ring     ble_ring;
+#endif
 
 //
 
@@ -161,7 +219,8 @@ U8X8_SSD1306_128X64_NONAME_HW_I2C u8x8(U8X8_PIN_NONE);
 TFT_eSPI tft = TFT_eSPI();
                   
 static uint16_t *pixel_timestamp = NULL;
-static uint32_t  track_colours[MAX_UAVS + 1];
+static const uint32_t track_colours[TRACK_COLOURS] = {TFT_RED, TFT_GREEN, TFT_YELLOW, TFT_ORANGE,
+                                                      TFT_CYAN, TFT_BLUE, TFT_SILVER, TFT_PINK};
 
 #endif
 
@@ -176,85 +235,37 @@ class MyAdvertisedDeviceCallbacks: public BLEAdvertisedDeviceCallbacks {
   
     void onResult(BLEAdvertisedDevice device) {
 
-      int                   i, k, len;
-      char                  text[128];
-      uint8_t              *payload, *odid, *mac;
-      struct id_data       *UAV;
-      ODID_BasicID_data     odid_basic;
-      ODID_Location_data    odid_location;
-      ODID_System_data      odid_system;
-      ODID_OperatorID_data  odid_operator;
-
-      text[0] = i = k = 0;
-      
-      //
-      
-      if ((len = device.getPayloadLength()) > 0) {
+      int             len;
+      uint8_t        *payload;
+      struct rx_slot *slot;
+
+      // Copied for loop(), which decodes it.
+
+      if (((len = device.getPayloadLength()) > 4)&&
+          ((slot = rx_ring_claim(&ble_ring)) != NULL)) {
 
         BLEAddress ble_address = device.getAddress();
-        mac                    = (uint8_t *) ble_address.getNative();
 
 //      BLEUUID BLE_UUID = device.getServiceUUID(); // crashes program
 
         payload = device.getPayload();
-        odid    = &payload[6];
-#if 0
-        for (i = 0, k = 0; i < ESP_BD_ADDR_LEN; ++i, k += 3) {
-
-          sprintf(&text[k],"%02x ",mac[i]);
-        }
 
-        Serial.printf("%s\r\n",text);
+        if (len > RX_FRAME_SIZE) {
 
-        dump_frame(payload,payload[0]);      
-#endif
-
-        if ((payload[1] == 0x16)&&
-            (payload[2] == 0xfa)&&
-            (payload[3] == 0xff)&&
-            (payload[4] == 0x0d)){
-
-          UAV            = next_uav(mac);
-          UAV->last_seen = millis();
-          UAV->rssi      = device.getRSSI();
-          UAV->flag      = 1;
-
-          memcpy(UAV->mac,mac,6);
-
-          switch (odid[0] & 0xf0) {
-
-          case 0x00: // basic
+          len = RX_FRAME_SIZE;
+        }
 
-            decodeBasicIDMessage(&odid_basic,(ODID_BasicID_encoded *) odid);
-            break;
+        slot->type     = RX_BLE;
+        slot->channel  = 0;
+        slot->rssi     = device.getRSSI();
+        slot->length   = len;
+        slot->msecs    = millis();
+        slot->rx_usecs = 0;
 
-          case 0x10: // location
-          
-            decodeLocationMessage(&odid_location,(ODID_Location_encoded *) odid);
-            UAV->lat_d        = odid_location.Latitude;
-            UAV->long_d       = odid_location.Longitude;
-            UAV->altitude_msl = (int) odid_location.AltitudeGeo;
-            UAV->height_agl   = (int) odid_location.Height;
-            UAV->speed        = (int) odid_location.SpeedHorizontal;
-            UAV->heading      = (int) odid_location.Direction;
-            break;
-
-          case 0x40: // system
-
-            decodeSystemMessage(&odid_system,(ODID_System_encoded *) odid);
-            UAV->base_lat_d   = odid_system.OperatorLatitude;
-            UAV->base_long_d  = odid_system.OperatorLongitude;
-            break;
-
-          case 0x50: // operator
-
-            decodeOperatorIDMessage(&odid_operator,(ODID_OperatorID_encoded *) odid);
-            strncpy((char *) UAV->op_id,(char *) odid_operator.OperatorId,ODID_ID_SIZE);
-            break;
-          }
+        memcpy(slot->mac,ble_address.getNative(),6);
+        memcpy(slot->frame,payload,len);
 
-          ++odid_ble;
-        }
+        rx_ring_publish(&ble_ring);
       }
 
       return;
@@ -271,25 +282,18 @@ void setup() {
 
   int         i;
   char        text[128];
+  size_t      free_bytes, track_bytes, bytes;
+  uint8_t    *memory = NULL, *p;
 
   text[0] = i = 0;
 
   //
 
-  memset((void *) &UAS_data,0,sizeof(ODID_UAS_Data));
-  memset((void *) uavs,0,(MAX_UAVS + 1) * sizeof(struct id_data));
-  memset((void *) ssid,0,10);
-
-  strcpy((char *) uavs[MAX_UAVS].op_id,"NONE");
-
-#if SD_LOGGER
-
-  for (i = 0; i <= MAX_UAVS; ++i) {
-
-    logfiles[i].flushed    = 1; 
-    logfiles[i].last_write = 0;
-  }
+  memset(ssid,0,10);
 
+  rx_ring_init(&wifi_ring);
+#if BLE_SCAN
+  rx_ring_init(&ble_ring);
 #endif
 
   //
@@ -301,6 +305,91 @@ void setup() {
   Serial.printf("\r\n{ \"title\": \"%s\" }\r\n",title);
   Serial.printf("{ \"build date\": \"%s\" }\r\n",build_date);
 
+#if TFT_DISPLAY
+
+  // The trails are drawn on the screen, with a timestamp per pixel so that
+  // they fade. It is the display's, not the tracks', so it is taken first and
+  // the tracks share what is left.
+
+  if (psramFound()) {
+
+    pixel_timestamp = (uint16_t *) ps_calloc(TFT_WIDTH * TFT_HEIGHT,sizeof(uint16_t));
+  }
+
+  if ((!pixel_timestamp)&&
+      ((pixel_timestamp = (uint16_t *) calloc(TFT_WIDTH * TFT_HEIGHT,sizeof(uint16_t))) == NULL)) {
+
+    Serial.print("{ \"message\": \"Unable to allocate memory for track data.\" }\r\n");
+  }
+
+#endif
+
+  // The track pool, from PSRAM if there is any.
+
+  free_bytes  = (psramFound()) ? ESP.getFreePsram(): ESP.getFreeHeap();
+  track_bytes = (uav_state_bytes(MAX_UAVS) / MAX_UAVS) + sizeof(struct id_cold) +
+                pool_block_size(sizeof(struct id_strings)) +
+                (track_table_bytes(MAX_UAVS) / MAX_UAVS);
+
+  if ((max_uavs = free_bytes / (TRACK_RAM_SHARE * track_bytes)) > MAX_UAVS) {
+
+    max_uavs = MAX_UAVS;
+  } else if (max_uavs < MIN_UAVS) {
+
+    max_uavs = MIN_UAVS;
+  }
+
+  for (; max_uavs >= MIN_UAVS; max_uavs /= 2) {
+
+    bytes = uav_state_bytes(max_uavs + 1) +
+            pool_bytes(sizeof(struct id_cold),max_uavs + 1) +
+            pool_bytes(sizeof(struct id_strings),max_uavs) +
+            track_table_bytes(max_uavs);
+#if SD_LOGGER
+    bytes += pool_bytes(sizeof(struct id_log),SD_LOG_FILES);
+#endif
+
+    if (psramFound()) {
+
+      memory = (uint8_t *) ps_calloc(1,bytes);
+    }
+
+    if ((memory)||(memory = (uint8_t *) calloc(1,bytes))) {
+
+      break;
+    }
+  }
+
+  if (!memory) {
+
+    Serial.print("{ \"message\": \"Unable to allocate memory for the tracks.\" }\r\n");
+
+    for (;;) {
+
+      delay(1000);
+    }
+  }
+
+  uav_state_init(&uavs,memory,max_uavs + 1);
+
+  p    = memory + uav_state_bytes(max_uavs + 1);
+  cold = (struct id_cold *) p;
+  p   += pool_bytes(sizeof(struct id_cold),max_uavs + 1);
+
+  pool_init(&strings_pool,p,sizeof(struct id_strings),max_uavs);
+  p   += pool_bytes(sizeof(struct id_strings),max_uavs);
+#if SD_LOGGER
+  pool_init(&log_pool,p,sizeof(struct id_log),SD_LOG_FILES);
+  p   += pool_bytes(sizeof(struct id_log),SD_LOG_FILES);
+#endif
+  track_table_init(&tracks,max_uavs,p);
+
+  cold[max_uavs].strings = &none_strings;
+
+  sprintf(text,"{ \"tracks\": %d, \"track memory\": %u, \"psram\": %d }\r\n",
+          max_uavs,(unsigned int) bytes,(int) psramFound());
+  Serial.print(text);
+
   //
 
   nvs_flash_init();
@@ -377,27 +466,7 @@ void setup() {
   tft.setRotation(0);
   tft.fillScreen(TFT_BLACK);
 
-  if ((pixel_timestamp = (uint16_t *) calloc(TFT_WIDTH * TFT_HEIGHT,sizeof(uint16_t))) == NULL) {
-
-    Serial.print("{ \"message\": \"Unable to allocate memory for track data.\" }\r\n");
-  }
-
-#if MAX_UAVS != 8
-#warning "Align MAX_UAVS and colour assignments."
-#endif
-
-  track_colours[0] = TFT_RED;
-  track_colours[1] = TFT_GREEN;
-  track_colours[2] = TFT_YELLOW;
-  track_colours[3] = TFT_ORANGE;
-  track_colours[4] = TFT_CYAN;
-  track_colours[5] = TFT_BLUE;
-  track_colours[6] = TFT_SILVER;
-  track_colours[7] = TFT_PINK;
-  
-  track_colours[MAX_UAVS] = TFT_WHITE;
-
-  for (int i = 0, y = 4; i < MAX_UAVS; ++i, y += 4) {
+  for (int i = 0, y = 4; i < TRACK_COLOURS; ++i, y += 4) {
 
     tft.drawLine(4,y,10,y,track_colours[i]);
   }
@@ -452,14 +521,21 @@ void setup() {
 
 void loop() {
 
-  int             i, j, k, msl, agl;
+  int             i, j, k, msl, agl, expired;
   char            text[256];
+  uint64_t        flags;
   double          x_m = 0.0, y_m = 0.0;
   uint32_t        msecs, secs;
+  struct rx_slot *slot;
   static int      display_uav = 0;
   static uint32_t last_display_update = 0, last_page_change = 0, last_json = 0;
+#if DIAGNOSTICS
+  static uint32_t last_rx_stats = 0;
+#endif
 #if LCD_DISPLAY
   char            text1[16];
+  const char     *a;
+  const uint8_t  *mac;
   static int      display_phase = 0;
 #endif
 #if TFT_DISPLAY 
@@ -469,6 +545,22 @@ void loop() {
 
   text[0] = i = j = k = 0;
 
+  // Decode the frames that the callbacks have queued.
+
+  while ((slot = rx_ring_peek(&wifi_ring)) != NULL) {
+
+    decode_wifi(slot);
+    rx_ring_release(&wifi_ring);
+  }
+
+#if BLE_SCAN
+  while ((slot = rx_ring_peek(&ble_ring)) != NULL) {
+
+    decode_ble(slot);
+    rx_ring_release(&ble_ring);
+  }
+#endif
+
   //
   
   msecs = millis();
@@ -491,43 +583,57 @@ void loop() {
   msecs = millis();
   secs  = msecs / 1000;
 
-  for (i = 0; i < MAX_UAVS; ++i) {
+  // The expiry only reads last_seen[], and usually finds nothing.
+
+  for (i = 0, expired = 0; i < max_uavs; ++i) {
 
-    if ((uavs[i].last_seen)&&
-        ((msecs - uavs[i].last_seen) > 300000L)) {
+    expired |= (uavs.last_seen[i] != 0) & ((msecs - uavs.last_seen[i]) > 300000UL);
+  }
 
-      uavs[i].last_seen = 0;
-      uavs[i].mac[0]    = 0;
+  for (i = 0; (expired)&&(i < max_uavs); ++i) {
 
-#if SD_LOGGER
-      if (logfiles[i].sd_log) {
+    if ((uavs.last_seen[i])&&
+        ((msecs - uavs.last_seen[i]) > 300000UL)) {
 
-        logfiles[i].sd_log.close();
-        logfiles[i].flushed = 1;
-      }
-#endif
+      track_remove(&tracks,i);
+      release_uav(i);
     }
+  }
+
+  // The flags, eight at a time.
+
+  for (i = 0; i < max_uavs; i += 8) {
+
+    memcpy(&flags,&uavs.flag[i],8);
+
+    while (flags) {
 
-    if (uavs[i].flag) {
+      k      = i + (__builtin_ctzll(flags) >> 3);
+      flags &= flags - 1;
+
+      if (k >= max_uavs) {
+
+        break;
+      }
 
-      print_json(i,secs,(id_data *) &uavs[i]);
+      print_json(k,secs);
 
 #if SD_LOGGER
-      write_log(msecs,(id_data *) &uavs[i],&logfiles[i]);
+      write_log(msecs,k);
 #endif
 
-      if ((uavs[i].lat_d)&&(uavs[i].base_lat_d)) {
+      if ((uavs.lat[k])&&(uavs.base_lat[k])) {
 
         if (base_lat_d == 0.0) {
 
-          base_lat_d  = uavs[i].base_lat_d;
-          base_long_d = uavs[i].base_long_d;
+          base_lat_d  = uav_deg(uavs.base_lat[k]);
+          base_long_d = uav_deg(uavs.base_lon[k]);
 
           calc_m_per_deg(base_lat_d,base_long_d,&m_deg_lat,&m_deg_long);
         }
 
-        y_m = (uavs[i].lat_d  - base_lat_d)  * m_deg_lat;
-        x_m = (uavs[i].long_d - base_long_d) * m_deg_long;
+        y_m = (uav_deg(uavs.lat[k]) - base_lat_d)  * m_deg_lat;
+        x_m = (uav_deg(uavs.lon[k]) - base_long_d) * m_deg_long;
 
 #if TFT_DISPLAY
         y = TFT_HEIGHT - ((y_m / TRACK_SCALE) + (TFT_HEIGHT  / 2));
@@ -535,7 +641,7 @@ void loop() {
 
         if ((y >= 0)&&(y < TFT_HEIGHT)&&(x >= 0)&&(x < TFT_WIDTH)) {
 
-          tft.drawPixel(x,y,track_colours[i]);
+          tft.drawPixel(x,y,track_colours[k % TRACK_COLOURS]);
 
           if (pixel_timestamp) {
             
@@ -546,29 +652,33 @@ void loop() {
 #endif
       }
 
-      uavs[i].flag = 0;
+      uavs.flag[k] = 0;
 
       last_json = msecs;
     }
+  }
 
 #if SD_LOGGER
 
-    if ((logfiles[i].sd_log)&&
-        (!logfiles[i].flushed)&&
-        ((msecs - logfiles[i].last_write) > 10000)) {
+  for (i = 0; i < max_uavs; ++i) {
+
+    if ((cold[i].log)&&
+        (cold[i].log->sd_log)&&
+        (!cold[i].log->flushed)&&
+        ((msecs - cold[i].log->last_write) > 10000)) {
 
       digitalWrite(SD_LOGGER_LED,1);
 
-      logfiles[i].sd_log.flush();
-      logfiles[i].flushed = 1;
+      cold[i].log->sd_log.flush();
+      cold[i].log->flushed = 1;
 
-      logfiles[i].last_write = msecs;
+      cold[i].log->last_write = msecs;
 
       digitalWrite(SD_LOGGER_LED,0);
     }  
+  }
 
 #endif
-  }
 
 #if TFT_DISPLAY
 
@@ -597,11 +707,33 @@ void loop() {
 
   if ((msecs - last_json) > 60000UL) { // Keep the serial link active
 
-      print_json(MAX_UAVS,msecs / 1000,(id_data *) &uavs[MAX_UAVS]); 
+      print_json(max_uavs,msecs / 1000); 
 
       last_json = msecs;
   }
 
+#if DIAGNOSTICS
+
+  if ((msecs - last_rx_stats) > 60000UL) {
+
+    sprintf(text,"{ \"callbacks\": %u, \"rx dropped\": %u, \"rx max depth\": %u }\r\n",
+            callback_counter,wifi_ring.dropped,wifi_ring.depth_max);
+    Serial.print(text);
+
+    sprintf(text,"{ \"tracks\": %d, \"in use\": %u, \"high water\": %u, \"evicted\": %u, \"strings exhausted\": %u",
+            max_uavs,tracks.stats.in_use,tracks.stats.high_water,tracks.stats.evicted,strings_pool.exhausted);
+    Serial.print(text);
+#if SD_LOGGER
+    sprintf(text,", \"logs exhausted\": %u",log_pool.exhausted);
+    Serial.print(text);
+#endif
+    Serial.print(" }\r\n");
+
+    last_rx_stats = msecs;
+  }
+
+#endif
+
   //
 
   if (( msecs > DISPLAY_PAGE_MS)&&
@@ -611,11 +743,11 @@ void loop() {
 
     if ((msecs - last_page_change) >= DISPLAY_PAGE_MS) {
 
-      for (i = 1; i < MAX_UAVS; ++i) {
+      for (i = 1; i < max_uavs; ++i) {
 
-        j = (display_uav + i) % MAX_UAVS;
+        j = (display_uav + i) % max_uavs;
 
-        if (uavs[j].mac[0]) {
+        if (track_used(&tracks,j)) {
 
           display_uav = j;
           break;
@@ -625,8 +757,8 @@ void loop() {
       last_page_change += DISPLAY_PAGE_MS;
     }
 
-    msl = uavs[display_uav].altitude_msl;
-    agl = uavs[display_uav].height_agl;
+    msl = uavs.altitude_msl[display_uav];
+    agl = uavs.height_agl[display_uav];
 
 #if (LCD_DISPLAY > 10) && (LCD_DISPLAY < 20) 
 
@@ -634,22 +766,22 @@ void loop() {
 
     case 0:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        sprintf(text,"%-16s",format_op_id((char *) uavs[display_uav].op_id));
+        sprintf(text,"%-16s",format_op_id((char *) uav_op_id(display_uav)));
         u8x8.drawString(0,0,text);
       }
       break;
 
     case 1:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        if (uavs[display_uav].uav_id[0]) {
+        if ((a = uav_uas_id(display_uav))[0]) {
 
-          for (i = 0; (i < 16)&&(uavs[display_uav].uav_id[i]); ++i) {
+          for (i = 0; (i < 16)&&(a[i]); ++i) {
 
-            text[i] = uavs[display_uav].uav_id[i];
+            text[i] = a[i];
           }
 
           while (i < 16) {
@@ -661,10 +793,11 @@ void loop() {
           
         } else {
 
+          mac = uav_mac(display_uav);
+
           sprintf(text,"%02x%02x%02x%02x%02x%02x %3d",
-                  uavs[display_uav].mac[0],uavs[display_uav].mac[1],uavs[display_uav].mac[2],
-                  uavs[display_uav].mac[3],uavs[display_uav].mac[4],uavs[display_uav].mac[5],
-                  uavs[display_uav].rssi);
+                  mac[0],mac[1],mac[2],mac[3],mac[4],mac[5],
+                  uavs.rssi[display_uav]);
         }
 
         u8x8.drawString(0,1,text);
@@ -673,12 +806,12 @@ void loop() {
 
     case 2:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        if ((uavs[display_uav].lat_d >= -90.0)&&
-            (uavs[display_uav].lat_d <=  90.0)) {
+        if ((uav_deg(uavs.lat[display_uav]) >= -90.0)&&
+            (uav_deg(uavs.lat[display_uav]) <=  90.0)) {
 
-          dtostrf(uavs[display_uav].lat_d,11,6,text1);
+          dtostrf(uav_deg(uavs.lat[display_uav]),11,6,text1);
           u8x8.drawString(0,2,text1);
           
         } else {
@@ -700,12 +833,12 @@ void loop() {
 
     case 3:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        if ((uavs[display_uav].long_d >= -180.0)&&
-            (uavs[display_uav].long_d <=  180.0)) {
+        if ((uav_deg(uavs.lon[display_uav]) >= -180.0)&&
+            (uav_deg(uavs.lon[display_uav]) <=  180.0)) {
 
-          dtostrf(uavs[display_uav].long_d,11,6,text1);
+          dtostrf(uav_deg(uavs.lon[display_uav]),11,6,text1);
           u8x8.drawString(0,3,text1);
           
         } else {
@@ -727,12 +860,12 @@ void loop() {
 
     case 4:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        if ((uavs[display_uav].base_lat_d >= -90.0)&&
-            (uavs[display_uav].base_lat_d <=  90.0)) {
+        if ((uav_deg(uavs.base_lat[display_uav]) >= -90.0)&&
+            (uav_deg(uavs.base_lat[display_uav]) <=  90.0)) {
 
-          dtostrf(uavs[display_uav].base_lat_d,11,6,text1);
+          dtostrf(uav_deg(uavs.base_lat[display_uav]),11,6,text1);
           u8x8.drawString(0,4,text1);
           
         } else {
@@ -740,9 +873,9 @@ void loop() {
           u8x8.drawString(0,4,blank_latlong);
         }
 
-        if ((uavs[display_uav].speed >= 0)&&(uavs[display_uav].speed < 10000)) {
+        if ((uavs.speed[display_uav] >= 0)&&(uavs.speed[display_uav] < 10000)) {
 
-          sprintf(text," %4d",uavs[display_uav].speed);
+          sprintf(text," %4d",uavs.speed[display_uav]);
           u8x8.drawString(11,4,text);
           
         } else {
@@ -754,12 +887,12 @@ void loop() {
 
     case 5:
 
-      if (uavs[display_uav].mac[0]) {
+      if (track_used(&tracks,display_uav)) {
 
-        if ((uavs[display_uav].base_long_d >= -180.0)&&
-            (uavs[display_uav].base_long_d <=  180.0)) {
+        if ((uav_deg(uavs.base_lon[display_uav]) >= -180.0)&&
+            (uav_deg(uavs.base_lon[display_uav]) <=  180.0)) {
 
-          dtostrf(uavs[display_uav].base_long_d,11,6,text1);
+          dtostrf(uav_deg(uavs.base_lon[display_uav]),11,6,text1);
           u8x8.drawString(0,5,text1);
           
         } else {
@@ -767,9 +900,9 @@ void loop() {
           u8x8.drawString(0,5,blank_latlong);
         }
 
-        if ((uavs[display_uav].heading >= 0)&&(uavs[display_uav].heading <= 360)) {
+        if ((uavs.heading[display_uav] >= 0)&&(uavs.heading[display_uav] <= 360)) {
 
-          sprintf(text," %4d",uavs[display_uav].heading);
+          sprintf(text," %4d",uavs.heading[display_uav]);
           u8x8.drawString(11,5,text);
           
         } else {
@@ -813,24 +946,25 @@ void loop() {
  *
  */
 
-void print_json(int index,int secs,struct id_data *UAV) {
+void print_json(int index,int secs) {
 
-  char text[128], text1[16],text2[16], text3[16], text4[16];
+  char           text[128], text1[16],text2[16], text3[16], text4[16];
+  const uint8_t *mac = uav_mac(index);
 
-  dtostrf(UAV->lat_d,11,6,text1);
-  dtostrf(UAV->long_d,11,6,text2);
-  dtostrf(UAV->base_lat_d,11,6,text3);
-  dtostrf(UAV->base_long_d,11,6,text4);
+  dtostrf(uav_deg(uavs.lat[index]),11,6,text1);
+  dtostrf(uav_deg(uavs.lon[index]),11,6,text2);
+  dtostrf(uav_deg(uavs.base_lat[index]),11,6,text3);
+  dtostrf(uav_deg(uavs.base_lon[index]),11,6,text4);
 
   sprintf(text,"{ \"index\": %d, \"runtime\": %d, \"mac\": \"%02x:%02x:%02x:%02x:%02x:%02x\", ",
           index,secs,
-          UAV->mac[0],UAV->mac[1],UAV->mac[2],UAV->mac[3],UAV->mac[4],UAV->mac[5]);
+          mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
   Serial.print(text);
   sprintf(text,"\"id\": \"%s\", \"uav latitude\": %s, \"uav longitude\": %s, \"alitude msl\": %d, ",
-          UAV->op_id,text1,text2,UAV->altitude_msl);
+          uav_op_id(index),text1,text2,uavs.altitude_msl[index]);
   Serial.print(text);
   sprintf(text,"\"height agl\": %d, \"base latitude\": %s, \"base longitude\": %s, \"speed\": %d, \"heading\": %d }\r\n",
-          UAV->height_agl,text3,text4,UAV->speed,UAV->heading);
+          uavs.height_agl[index],text3,text4,uavs.speed[index],uavs.heading[index]);
   Serial.print(text);
 
   return;
@@ -841,22 +975,38 @@ void print_json(int index,int secs,struct id_data *UAV) {
  *
  */
 
-void write_log(uint32_t msecs,struct id_data *UAV,struct id_log *logfile) {
+void write_log(uint32_t msecs,int uav) {
 
 #if SD_LOGGER
 
-  int       secs, dsecs;
-  char      text[128], filename[24], text1[16], text2[16];
+  int            secs, dsecs;
+  char           text[128], filename[24], text1[16], text2[16];
+  void          *block;
+  const uint8_t *mac = uav_mac(uav);
+  struct id_log *logfile;
 
   secs  = (int) (msecs / 1000);
   dsecs = ((short int) (msecs - (secs * 1000))) / 100;
 
   //
 
+  if (!(logfile = cold[uav].log)) {
+
+    if (!(block = pool_alloc(&log_pool))) {
+
+      return;
+    }
+
+    logfile = cold[uav].log = new (block) id_log;
+
+    logfile->flushed    = 1;
+    logfile->last_write = 0;
+  }
+
   if (!logfile->sd_log) {
 
     sprintf(filename,"/%02X%02X%02X%02X.TSV",
-            UAV->mac[2],UAV->mac[3],UAV->mac[4],UAV->mac[5]);
+            mac[2],mac[3],mac[4],mac[5]);
 
     if (!(logfile->sd_log = SD.open(filename,FILE_APPEND))) {
 
@@ -869,16 +1019,16 @@ void write_log(uint32_t msecs,struct id_data *UAV,struct id_log *logfile) {
 
   if (logfile->sd_log) {
 
-    dtostrf(UAV->lat_d,11,6,text1);
-    dtostrf(UAV->long_d,11,6,text2);
+    dtostrf(uav_deg(uavs.lat[uav]),11,6,text1);
+    dtostrf(uav_deg(uavs.lon[uav]),11,6,text2);
 
     sprintf(text,"%d.%d\t%s\t%s\t%s\t%s\t",
-            secs,dsecs,UAV->op_id,UAV->uav_id,text1,text2);
+            secs,dsecs,uav_op_id(uav),uav_uas_id(uav),text1,text2);
     logfile->sd_log.print(text);
 
     sprintf(text,"%d\t%d\t%d\t",
-            (int) UAV->altitude_msl,(int) UAV->speed,
-            (int) UAV->heading);
+            (int) uavs.altitude_msl[uav],(int) uavs.speed[uav],
+            (int) uavs.heading[uav]);
     logfile->sd_log.print(text);
 
     logfile->sd_log.print("\r\n");
@@ -900,106 +1050,89 @@ esp_err_t event_handler(void *ctx, system_event_t *event) {
 }
 
 /*
- * This function handles WiFi packets.
+ * This function handles WiFi packets. It runs in the driver's task, so it
+ * only copies the beacons and NAN action frames for loop().
  */
 
 void callback(void* buffer,wifi_promiscuous_pkt_type_t type) {
 
-  int                     length, typ, len, i, j, offset;
-  char                    ssid_tmp[10], *a;
-  uint8_t                *packet_u8, *payload, *val;
+  int                     length;
+  uint8_t                *payload;
   wifi_promiscuous_pkt_t *packet;
-  struct id_data         *UAV = NULL;
-  static uint8_t          mac[6], nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
-
-  a = NULL;
-  
-//
+  struct rx_slot         *slot;
+  static const uint8_t    nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
 
   ++callback_counter;
 
-  memset(ssid_tmp,0,10);
-
-  packet    = (wifi_promiscuous_pkt_t *) buffer;
-  packet_u8 = (uint8_t *) buffer;
-  
-  payload   = packet->payload;
-  length    = packet->rx_ctrl.sig_len;
-  offset    = 36;
+  packet  = (wifi_promiscuous_pkt_t *) buffer;
+  payload = packet->payload;
+  length  = packet->rx_ctrl.sig_len;
 
-//
+  if ((length < 24)||
+      ((payload[0] != 0x80)&&(memcmp(nan_dest,&payload[4],6) != 0))) {
 
-  UAV = next_uav(&payload[10]);
-
-  memcpy(UAV->mac,&payload[10],6);
-
-  UAV->rssi      = packet->rx_ctrl.rssi;
-  UAV->last_seen = millis();
-
-//
-
-  if (memcmp(nan_dest,&payload[4],6) == 0) {
-
-    // dump_frame(payload,length);
+    return;
+  }
 
-    if (odid_wifi_receive_message_pack_nan_action_frame((ODID_UAS_Data *) &UAS_data,(char *) mac,payload,length) == 0) {
+  if ((slot = rx_ring_claim(&wifi_ring)) == NULL) {
 
-      ++odid_wifi;
+    return;
+  }
 
-      parse_odid(UAV,(ODID_UAS_Data *) &UAS_data);
-    }
+  if (length > RX_FRAME_SIZE) {
 
-  } else if (payload[0] == 0x80) { // beacon
+    length = RX_FRAME_SIZE;
+  }
 
-    offset = 36;
+  slot->type     = RX_WIFI;
+  slot->channel  = packet->rx_ctrl.channel;
+  slot->rssi     = packet->rx_ctrl.rssi;
+  slot->length   = length;
+  slot->msecs    = millis();
+  slot->rx_usecs = packet->rx_ctrl.timestamp;
 
-    while (offset < length) {
+  memcpy(slot->frame,payload,length);
 
-      typ =  payload[offset];
-      len =  payload[offset + 1];
-      val = &payload[offset + 2];
+  rx_ring_publish(&wifi_ring);
 
-      if ((typ    == 0xdd)&&
-          (val[0] == 0x6a)&& // French
-          (val[1] == 0x5c)&&
-          (val[2] == 0x35)) {
+  return;
+}
 
-        ++french_wifi;
+/*
+ * Decodes a WiFi frame from the ring.
+ */
 
-        parse_french_id(UAV,&payload[offset]);
+void decode_wifi(struct rx_slot *slot) {
 
-      } else if ((typ      == 0xdd)&&
-                 (((val[0] == 0x90)&&(val[1] == 0x3a)&&(val[2] == 0xe6))|| // Parrot
-                  ((val[0] == 0xfa)&&(val[1] == 0x0b)&&(val[2] == 0xbc)))) { // ODID
+  int                     length, decoded = 0;
+  char                    ssid_tmp[RID_SSID_SIZE], *a;
+  uint8_t                *payload;
+  int                     uav;
+  struct rid_fields       fields;
+  static uint8_t          nan_dest[6] = {0x51, 0x6f, 0x9a, 0x01, 0x00, 0x00};
 
-        ++odid_wifi;
+  a = NULL;
+  
+//
 
-        if ((j = offset + 7) < length) {
+  payload   = slot->frame;
+  length    = slot->length;
 
-          memset((void *) &UAS_data,0,sizeof(UAS_data));
-          
-          odid_message_process_pack((ODID_UAS_Data *) &UAS_data,&payload[j],length - j);
+//
 
-#if DUMP_ODID_FRAME
-          dump_frame(payload,length);     
-#endif
-          parse_odid(UAV,(ODID_UAS_Data *) &UAS_data);
-        }
+  if (memcmp(nan_dest,&payload[4],6) == 0) {
 
-      } else if ((typ == 0)&&(!ssid_tmp[0])) {
+    // dump_frame(payload,length);
 
-        for (i = 0; (i < 8)&&(i < len); ++i) {
+    decoded = rid_decode_nan(payload,length,&fields);
 
-          ssid_tmp[i] = val[i];
-        }
-      }
+  } else if (payload[0] == 0x80) { // beacon
 
-      offset += len + 2;
-    }
+    decoded = rid_decode_beacon(payload,length,&fields,ssid_tmp);
 
     if (ssid_tmp[0]) {
 
-      strncpy((char *) ssid,ssid_tmp,8);
+      strncpy(ssid,ssid_tmp,8);
     }
 #if 0
   } else if (a = (char *) memchr(payload,'G',length)) {
@@ -1011,229 +1144,227 @@ void callback(void* buffer,wifi_promiscuous_pkt_type_t type) {
 #endif
   }
 
-  if ((!UAV->op_id[0])&&(!UAV->lat_d)) {
+  if (decoded) {
+
+    if (fields.formats & RID_FRENCH) {
+
+      ++french_wifi;
+    }
+
+    if (fields.formats & RID_ODID) {
+
+      ++odid_wifi;
+#if DUMP_ODID_FRAME
+      dump_frame(payload,length);     
+#endif
+    }
 
-    UAV->mac[0] = 0;
+    uav = next_uav(&payload[10],(fields.has & RID_HAS_UAS_ID) ? fields.uas_id: NULL,slot);
+    apply_rid(uav,&fields);
   }
 
   return;
 }
 
 /*
- *
+ * Decodes a BLE advert from the ring.
  */
 
-struct id_data *next_uav(uint8_t *mac) {
-
-  int             i;
-  struct id_data *UAV = NULL;
-
-  for (i = 0; i < MAX_UAVS; ++i) {
+#if BLE_SCAN
 
-    if (memcmp((void *) uavs[i].mac,mac,6) == 0) {
+void decode_ble(struct rx_slot *slot) {
 
-      UAV = (struct id_data *) &uavs[i];
-    }
-  }
+  int                   uav;
+  uint8_t              *payload, *odid;
+  struct id_strings    *strings;
+  ODID_BasicID_data     odid_basic;
+  ODID_Location_data    odid_location;
+  ODID_System_data      odid_system;
+  ODID_OperatorID_data  odid_operator;
 
-  if (!UAV) {
+  payload = slot->frame;
+  odid    = &payload[6];
 
-    for (i = 0; i < MAX_UAVS; ++i) {
+#if 0
+  dump_frame(payload,payload[0]);      
+#endif
 
-      if (!uavs[i].mac[0]) {
+  if ((slot->length >= (6 + ODID_MESSAGE_SIZE))&&
+      (payload[1] == 0x16)&&
+      (payload[2] == 0xfa)&&
+      (payload[3] == 0xff)&&
+      (payload[4] == 0x0d)){
 
-        UAV = (struct id_data *) &uavs[i];
-        break;
-      }
-    }
-  }
+    uav            = next_uav(slot->mac,NULL,slot);
+    uavs.flag[uav] = 1;
 
-  if (!UAV) {
+    switch (odid[0] & 0xf0) {
 
-     UAV = (struct id_data *) &uavs[MAX_UAVS - 1];
-  }
+    case 0x00: // basic
 
-  return UAV;
-}
+      decodeBasicIDMessage(&odid_basic,(ODID_BasicID_encoded *) odid);
+      break;
 
-/*
- *
- */
+    case 0x10: // location
+          
+      decodeLocationMessage(&odid_location,(ODID_Location_encoded *) odid);
+      uavs.lat[uav]          = uav_e7(odid_location.Latitude);
+      uavs.lon[uav]          = uav_e7(odid_location.Longitude);
+      uavs.altitude_msl[uav] = uav_i16(odid_location.AltitudeGeo);
+      uavs.height_agl[uav]   = uav_i16(odid_location.Height);
+      uavs.speed[uav]        = uav_i16(odid_location.SpeedHorizontal);
+      uavs.heading[uav]      = uav_i16(odid_location.Direction);
+      break;
 
-void parse_odid(struct id_data *UAV,ODID_UAS_Data *UAS_data2) {
+    case 0x40: // system
 
-  if (UAS_data2->BasicIDValid[0]) {
+      decodeSystemMessage(&odid_system,(ODID_System_encoded *) odid);
+      uavs.base_lat[uav]     = uav_e7(odid_system.OperatorLatitude);
+      uavs.base_lon[uav]     = uav_e7(odid_system.OperatorLongitude);
+      break;
 
-    UAV->flag = 1;
-    strncpy((char *) UAV->uav_id,(char *) UAS_data2->BasicID[0].UASID,ODID_ID_SIZE);
-  }
+    case 0x50: // operator
 
-  if (UAS_data2->OperatorIDValid) {
+      decodeOperatorIDMessage(&odid_operator,(ODID_OperatorID_encoded *) odid);
 
-    UAV->flag = 1;
-    strncpy((char *) UAV->op_id,(char *) UAS_data2->OperatorID.OperatorId,ODID_ID_SIZE);
-  }
+      if ((strings = uav_strings(uav)) != NULL) {
 
-  if (UAS_data2->LocationValid) {
+        strncpy(strings->op_id,odid_operator.OperatorId,ODID_ID_SIZE);
+      }
+      break;
+    }
 
-    UAV->flag         = 1;
-    UAV->lat_d        = UAS_data2->Location.Latitude;
-    UAV->long_d       = UAS_data2->Location.Longitude;
-    UAV->altitude_msl = (int) UAS_data2->Location.AltitudeGeo;
-    UAV->height_agl   = (int) UAS_data2->Location.Height;
-    UAV->speed        = (int) UAS_data2->Location.SpeedHorizontal;
-    UAV->heading      = (int) UAS_data2->Location.Direction;
+    ++odid_ble;
   }
 
-  if (UAS_data2->SystemValid) {
-
-    UAV->flag        = 1;
-    UAV->base_lat_d  = UAS_data2->System.OperatorLatitude;
-    UAV->base_long_d = UAS_data2->System.OperatorLongitude;
-  }  
-
   return;
 }
 
+#endif
+
 /*
  *
  */
 
-void parse_french_id(struct id_data *UAV,uint8_t *payload) {
-
-  int            length, i, j, l, t, index;
-  uint8_t       *v;
-  union {int32_t i32; uint32_t u32;}
-                 uav_lat, uav_long, base_lat, base_long;
-  union {int16_t i16; uint16_t u16;} 
-                 alt, height;
-
-  uav_lat.u32  
-  = 
-  uav_long.u32  = 
-  base_lat.u32  =
-  base_long.u32 = 0;
-
-  alt.u16       =
-  height.u16    = 0;
+int next_uav(uint8_t *mac,const char *uas_id,struct rx_slot *slot) {
 
-  index  = 0;
-  length = payload[1];
+  int i, outcome = TRACK_FOUND;
 
-  UAV->flag = 1;
+  if ((i = track_find(&tracks,mac,uas_id,&outcome)) == TRACK_NONE) {
 
-  for (j = 6; j < length;) {
-
-    t =  payload[j];
-    l =  payload[j + 1];
-    v = &payload[j + 2];
-
-    switch (t) {
-
-    case  1:
+    i = max_uavs - 1;
+  }
 
-      if (v[0] != 1) {
+  if (outcome != TRACK_FOUND) {
 
-        return;
-      }
-      
-      break;
+    release_uav(i);
+  }
 
-    case  2:
+  uavs.rssi[i]      = slot->rssi;
+  uavs.last_seen[i] = slot->msecs;
 
-      for (i = 0; (i < (l - 6))&&(i < (ID_SIZE - 1)); ++i) {
+  return i;
+}
 
-        UAV->op_id[i] = (char) v[i + 6];
-      }
+/*
+ * Returns a track's strings and log file to their pools and clears it.
+ */
 
-      UAV->op_id[i] = 0;
-      break;
+void release_uav(int i) {
 
-    case  3:
+#if SD_LOGGER
+  if (cold[i].log) {
 
-      for (i = 0; (i < l)&&(i < (ID_SIZE - 1)); ++i) {
+    if (cold[i].log->sd_log) {
 
-        UAV->uav_id[i] = (char) v[i];
-      }
+      cold[i].log->sd_log.close();
+    }
 
-      UAV->uav_id[i] = 0;
-      break;
+    cold[i].log->~id_log();
+    pool_free(&log_pool,cold[i].log);
+  }
+#endif
 
-    case  4:
+  pool_free(&strings_pool,cold[i].strings);
 
-      for (i = 0; i < 4; ++i) {
+  memset(&cold[i],0,sizeof(struct id_cold));
+  uav_state_clear(&uavs,i);
 
-        uav_lat.u32 <<= 8;
-        uav_lat.u32  |= v[i];
-      }
+  return;
+}
 
-      break;
+/*
+ * The track table has the MACs, the keep alive has none.
+ */
 
-    case  5:
+const uint8_t *uav_mac(int i) {
 
-      for (i = 0; i < 4; ++i) {
+  static const uint8_t no_mac[6] = {0, 0, 0, 0, 0, 0};
 
-        uav_long.u32 <<= 8;
-        uav_long.u32  |= v[i];
-      }
+  return (track_used(&tracks,i)) ? tracks.keys[i].mac: no_mac;
+}
 
-      break;
+/*
+ * A track's strings, taken from the pool the first time that they are
+ * wanted. NULL if the pool is empty.
+ */
 
-    case  6:
+struct id_strings *uav_strings(int i) {
 
-      alt.u16 = (((uint16_t) v[0]) << 8) | (uint16_t) v[1];
-      break;
+  if ((!cold[i].strings)&&
+      ((cold[i].strings = (struct id_strings *) pool_alloc(&strings_pool)) != NULL)) {
 
-    case  7:
+    memset(cold[i].strings,0,sizeof(struct id_strings));
+  }
 
-      height.u16 = (((uint16_t) v[0]) << 8) | (uint16_t) v[1];
-      break;
+  return cold[i].strings;
+}
 
-    case  8:
+const char *uav_op_id(int i) {
 
-      for (i = 0; i < 4; ++i) {
+  return (cold[i].strings) ? cold[i].strings->op_id: "";
+}
 
-        base_lat.u32 <<= 8;
-        base_lat.u32  |= v[i];
-      }
+const char *uav_uas_id(int i) {
 
-      break;
+  return (cold[i].strings) ? cold[i].strings->uav_id: "";
+}
 
-    case  9:
+/*
+ * Copy what rid_ie.cpp decoded to the track.
+ */
 
-      for (i = 0; i < 4; ++i) {
+void apply_rid(int uav,struct rid_fields *fields) {
 
-        base_long.u32 <<= 8;
-        base_long.u32  |= v[i];
-      }
+  struct id_strings *strings;
 
-      break;
+  uavs.flag[uav] = 1;
 
-    case 10:
+  if ((fields->has & RID_HAS_UAS_ID)&&(strings = uav_strings(uav))) {
 
-      UAV->speed = v[0];   
-      break;
+    strncpy(strings->uav_id,fields->uas_id,ODID_ID_SIZE);
+  }
 
-    case 11:
+  if ((fields->has & RID_HAS_OP_ID)&&(strings = uav_strings(uav))) {
 
-      UAV->heading = (((uint16_t) v[0]) << 8) | (uint16_t) v[1];
-      break;
+    strncpy(strings->op_id,fields->op_id,ODID_ID_SIZE);
+  }
 
-    default:
-    
-      break;
-    }
+  if (fields->has & RID_HAS_LOCATION) {
 
-    j += l + 2;
+    uavs.lat[uav]          = fields->lat;
+    uavs.lon[uav]          = fields->lon;
+    uavs.altitude_msl[uav] = fields->altitude_msl;
+    uavs.height_agl[uav]   = fields->height_agl;
+    uavs.speed[uav]        = fields->speed;
+    uavs.heading[uav]      = fields->heading;
   }
 
-  UAV->lat_d        = 1.0e-5 * (double) uav_lat.i32;
-  UAV->long_d       = 1.0e-5 * (double) uav_long.i32;
-  UAV->base_lat_d   = 1.0e-5 * (double) base_lat.i32;
-  UAV->base_long_d  = 1.0e-5 * (double) base_long.i32;
+  if (fields->has & RID_HAS_SYSTEM) {
 
-  UAV->altitude_msl = alt.i16;
-  UAV->height_agl   = height.i16;
+    uavs.base_lat[uav]     = fields->base_lat;
+    uavs.base_lon[uav]     = fields->base_lon;
+  }
 
   return;
 }
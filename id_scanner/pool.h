@@ -0,0 +1,110 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Fixed size block pool for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * The memory is given to pool_init() once, at boot. The free blocks are
+ * chained through their first word, so pool_alloc() and pool_free() are a
+ * couple of stores and never call malloc(). An empty pool returns NULL and
+ * counts it.
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct block_pool {
+
+  uint8_t  *base;
+  void     *free;
+  size_t    block_size;
+  uint16_t  blocks, in_use, high_water;
+  uint32_t  exhausted;
+};
+
+// Blocks are a multiple of 8 bytes, so that anything can go in them.
+
+inline size_t pool_block_size(size_t size) {
+
+  if (size < sizeof(void *)) {
+
+    size = sizeof(void *);
+  }
+
+  return (size + 7) & ~((size_t) 7);
+}
+
+inline size_t pool_bytes(size_t size,int blocks) {
+
+  return pool_block_size(size) * blocks;
+}
+
+// memory must be at least pool_bytes(size,blocks) and 8 byte aligned.
+
+inline void pool_init(struct block_pool *pool,void *memory,size_t size,int blocks) {
+
+  int i;
+
+  pool->base       = (uint8_t *) memory;
+  pool->free       = NULL;
+  pool->block_size = pool_block_size(size);
+  pool->blocks     = blocks;
+  pool->in_use     =
+  pool->high_water = 0;
+  pool->exhausted  = 0;
+
+  for (i = blocks - 1; i >= 0; --i) {
+
+    *(void **) &pool->base[i * pool->block_size] = pool->free;
+    pool->free = &pool->base[i * pool->block_size];
+  }
+
+  return;
+}
+
+inline void *pool_alloc(struct block_pool *pool) {
+
+  void *block;
+
+  if (!(block = pool->free)) {
+
+    ++pool->exhausted;
+    return NULL;
+  }
+
+  pool->free = *(void **) block;
+
+  if (++pool->in_use > pool->high_water) {
+
+    pool->high_water = pool->in_use;
+  }
+
+  return block;
+}
+
+inline void pool_free(struct block_pool *pool,void *block) {
+
+  if (block) {
+
+    *(void **) block = pool->free;
+    pool->free       = block;
+
+    --pool->in_use;
+  }
+
+  return;
+}
+
+#endif
+
+/*
+ *
+ */
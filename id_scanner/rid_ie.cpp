@@ -0,0 +1,283 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Remote ID decoding of WiFi beacons and NAN action frames for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * See rid_ie.h.
+ *
+ * Parrot's IEs are decoded as ODID whatever their type, as the scanner has
+ * always done.
+ *
+ */
+
+#include <string.h>
+
+#include "rid_ie.h"
+#include "uav_state.h"
+
+const struct vendor_ie vendor_ies[] = {
+
+  {VENDOR_KEY(0x6a,0x5c,0x35,0x01),VENDOR_TYPE_MASK,RID_FRENCH,rid_decode_french,"French"},
+  {VENDOR_KEY(0xfa,0x0b,0xbc,0x0d),VENDOR_TYPE_MASK,RID_ODID,  rid_decode_odid,  "ASD-STAN"},
+  {VENDOR_KEY(0x90,0x3a,0xe6,0x00),VENDOR_OUI_MASK, RID_ODID,  rid_decode_odid,  "Parrot"},
+  {0,0,0,NULL,NULL}
+};
+
+static ODID_UAS_Data UAS_data;
+
+/*
+ *
+ */
+
+const struct vendor_ie *vendor_ie_find(const struct ie *element) {
+
+  uint32_t                key;
+  const struct vendor_ie *vendor;
+
+  if ((element->id != 0xdd)||(element->length < 4)) {
+
+    return NULL;
+  }
+
+  key = VENDOR_KEY(element->body[0],element->body[1],element->body[2],element->body[3]);
+
+  for (vendor = vendor_ies; vendor->decode; ++vendor) {
+
+    if ((key & vendor->mask) == vendor->key) {
+
+      return vendor;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ *  The fixed part of a beacon is the 24 byte header, the timestamp, the
+ *  interval and the capabilities.
+ */
+
+int rid_decode_beacon(const uint8_t *frame,int length,struct rid_fields *fields,char *ssid) {
+
+  int                     i, decoded = 0;
+  struct ie_iter          iter;
+  struct ie               element;
+  const struct vendor_ie *vendor;
+
+  memset(fields,0,sizeof(struct rid_fields));
+
+  if (ssid) {
+
+    memset(ssid,0,RID_SSID_SIZE);
+  }
+
+  if ((length < 36)||(frame[0] != 0x80)) {
+
+    return 0;
+  }
+
+  ie_begin(&iter,&frame[36],length - 36);
+
+  while (ie_next(&iter,&element)) {
+
+    if ((vendor = vendor_ie_find(&element)) != NULL) {
+
+      if (vendor->decode(&element.body[4],element.length - 4,fields)) {
+
+        fields->formats |= vendor->format;
+        ++decoded;
+      }
+
+    } else if ((element.id == 0)&&(ssid)&&(!ssid[0])) {
+
+      for (i = 0; (i < (RID_SSID_SIZE - 1))&&(i < element.length); ++i) {
+
+        ssid[i] = (char) element.body[i];
+      }
+    }
+  }
+
+  return decoded;
+}
+
+/*
+ *
+ */
+
+int rid_decode_nan(const uint8_t *frame,int length,struct rid_fields *fields) {
+
+  char mac[6];
+
+  memset(fields,0,sizeof(struct rid_fields));
+  memset(&UAS_data,0,sizeof(UAS_data));
+
+  if (odid_wifi_receive_message_pack_nan_action_frame(&UAS_data,mac,(uint8_t *) frame,length) != 0) {
+
+    return 0;
+  }
+
+  if (!rid_from_odid(&UAS_data,fields)) {
+
+    return 0;
+  }
+
+  fields->formats = RID_ODID;
+
+  return 1;
+}
+
+/*
+ *  ODID, a message counter and then a message pack.
+ */
+
+int rid_decode_odid(const uint8_t *data,int length,struct rid_fields *fields) {
+
+  if (length < 2) {
+
+    return 0;
+  }
+
+  memset(&UAS_data,0,sizeof(UAS_data));
+
+  odid_message_process_pack(&UAS_data,(uint8_t *) &data[1],length - 1);
+
+  return rid_from_odid(&UAS_data,fields);
+}
+
+// Returns 0 if there was nothing valid.
+
+int rid_from_odid(ODID_UAS_Data *UAS_data2,struct rid_fields *fields) {
+
+  if (UAS_data2->BasicIDValid[0]) {
+
+    fields->has |= RID_HAS_UAS_ID;
+    memcpy(fields->uas_id,UAS_data2->BasicID[0].UASID,ODID_ID_SIZE);
+    fields->uas_id[ODID_ID_SIZE] = 0;
+  }
+
+  if (UAS_data2->OperatorIDValid) {
+
+    fields->has |= RID_HAS_OP_ID;
+    memcpy(fields->op_id,UAS_data2->OperatorID.OperatorId,ODID_ID_SIZE);
+    fields->op_id[ODID_ID_SIZE] = 0;
+  }
+
+  if (UAS_data2->LocationValid) {
+
+    fields->has         |= RID_HAS_LOCATION;
+    fields->lat          = uav_e7(UAS_data2->Location.Latitude);
+    fields->lon          = uav_e7(UAS_data2->Location.Longitude);
+    fields->altitude_msl = uav_i16(UAS_data2->Location.AltitudeGeo);
+    fields->height_agl   = uav_i16(UAS_data2->Location.Height);
+    fields->speed        = uav_i16(UAS_data2->Location.SpeedHorizontal);
+    fields->heading      = uav_i16(UAS_data2->Location.Direction);
+  }
+
+  if (UAS_data2->SystemValid) {
+
+    fields->has         |= RID_HAS_SYSTEM;
+    fields->base_lat     = uav_e7(UAS_data2->System.OperatorLatitude);
+    fields->base_lon     = uav_e7(UAS_data2->System.OperatorLongitude);
+  }
+
+  return UAS_data2->BasicIDValid[0] || UAS_data2->OperatorIDValid ||
+         UAS_data2->LocationValid   || UAS_data2->SystemValid;
+}
+
+/*
+ *  French, type, length, value. Positions are 1e-5 degrees.
+ */
+
+static uint32_t be32(const uint8_t *v) {
+
+  return (((uint32_t) v[0]) << 24) | (((uint32_t) v[1]) << 16) |
+         (((uint32_t) v[2]) <<  8) |   (uint32_t) v[3];
+}
+
+static uint16_t be16(const uint8_t *v) {
+
+  return (((uint16_t) v[0]) << 8) | (uint16_t) v[1];
+}
+
+int rid_decode_french(const uint8_t *data,int length,struct rid_fields *fields) {
+
+  int            i, j, l, t;
+  const uint8_t *v;
+  int32_t        uav_lat = 0, uav_long = 0, base_lat = 0, base_long = 0;
+
+  for (j = 0; (j + 2) <= length; j += l + 2) {
+
+    t =  data[j];
+    l =  data[j + 1];
+    v = &data[j + 2];
+
+    if ((j + 2 + l) > length) {
+
+      break;
+    }
+
+    switch (t) {
+
+    case  1:
+
+      if ((l < 1)||(v[0] != 1)) {
+
+        return 0;
+      }
+
+      break;
+
+    case  2:
+
+      for (i = 0; (i < (l - 6))&&(i < ODID_ID_SIZE); ++i) {
+
+        fields->op_id[i] = (char) v[i + 6];
+      }
+
+      fields->op_id[i] = 0;
+      fields->has     |= RID_HAS_OP_ID;
+      break;
+
+    case  3:
+
+      for (i = 0; (i < l)&&(i < ODID_ID_SIZE); ++i) {
+
+        fields->uas_id[i] = (char) v[i];
+      }
+
+      fields->uas_id[i] = 0;
+      fields->has      |= RID_HAS_UAS_ID;
+      break;
+
+    case  4: if (l >= 4) uav_lat   = (int32_t) be32(v); break;
+    case  5: if (l >= 4) uav_long  = (int32_t) be32(v); break;
+    case  6: if (l >= 2) fields->altitude_msl = (int16_t) be16(v); break;
+    case  7: if (l >= 2) fields->height_agl   = (int16_t) be16(v); break;
+    case  8: if (l >= 4) base_lat  = (int32_t) be32(v); break;
+    case  9: if (l >= 4) base_long = (int32_t) be32(v); break;
+    case 10: if (l >= 1) fields->speed        = v[0];  break;
+    case 11: if (l >= 2) fields->heading      = (int16_t) be16(v); break;
+
+    default:
+
+      break;
+    }
+  }
+
+  fields->lat       = uav_e7(1.0e-5 * (double) uav_lat);
+  fields->lon       = uav_e7(1.0e-5 * (double) uav_long);
+  fields->base_lat  = uav_e7(1.0e-5 * (double) base_lat);
+  fields->base_lon  = uav_e7(1.0e-5 * (double) base_long);
+  fields->has      |= RID_HAS_LOCATION | RID_HAS_SYSTEM;
+
+  return 1;
+}
+
+/*
+ *
+ */
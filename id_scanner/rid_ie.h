@@ -0,0 +1,139 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Remote ID decoding of WiFi beacons and NAN action frames for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * A beacon's IEs are walked once with ie_next(), which stops at the first IE
+ * that would run past the end of the frame, so nothing after it is read.
+ *
+ * Vendor specific IEs (0xdd) are looked up in vendor_ies[] by their OUI and
+ * type, and the decoder of the entry fills a struct rid_fields. A decoder is
+ * given the IE's body after the OUI and type, and its length, and mustn't
+ * read past it. Adding a national format is a decoder and a line in the
+ * table in rid_ie.cpp.
+ *
+ * The fields are in the units of uav_state.h, so the scanner can copy them
+ * to a track without knowing which format they came from.
+ *
+ * This doesn't need Arduino, see host/README.md.
+ *
+ */
+
+#ifndef RID_IE_H
+#define RID_IE_H
+
+#include <stdint.h>
+
+#include "opendroneid.h"
+
+#define RID_ID_SIZE      (ODID_ID_SIZE + 1)
+#define RID_SSID_SIZE    9
+
+// What a decoder found.
+
+#define RID_HAS_UAS_ID   0x01
+#define RID_HAS_OP_ID    0x02
+#define RID_HAS_LOCATION 0x04
+#define RID_HAS_SYSTEM   0x08
+
+// Which formats a frame had, one bit per entry of vendor_ies[].
+
+#define RID_FRENCH       0x01
+#define RID_ODID         0x02
+
+struct rid_fields {
+
+  uint8_t   has, formats;
+  char      uas_id[RID_ID_SIZE], op_id[RID_ID_SIZE];
+  int32_t   lat, lon, base_lat, base_lon;             // 1e-7 degrees
+  int16_t   altitude_msl, height_agl, speed, heading; // m, m, m/s, degrees
+};
+
+// IE iterator.
+
+struct ie_iter {
+
+  const uint8_t *next, *end;
+};
+
+struct ie {
+
+  uint8_t        id, length;
+  const uint8_t *body;
+};
+
+inline void ie_begin(struct ie_iter *iter,const uint8_t *ies,int length) {
+
+  iter->next = ies;
+  iter->end  = (length > 0) ? ies + length: ies;
+
+  return;
+}
+
+// Returns 0 at the end of the IEs, or at an IE that runs past it.
+
+inline int ie_next(struct ie_iter *iter,struct ie *element) {
+
+  if ((iter->end - iter->next) < 2) {
+
+    return 0;
+  }
+
+  element->id     =  iter->next[0];
+  element->length =  iter->next[1];
+  element->body   = &iter->next[2];
+
+  if ((iter->end - element->body) < element->length) {
+
+    iter->next = iter->end;
+    return 0;
+  }
+
+  iter->next = element->body + element->length;
+
+  return 1;
+}
+
+// Vendor IE dispatch.
+
+#define VENDOR_KEY(a,b,c,type) ((((uint32_t) (a)) << 24) | (((uint32_t) (b)) << 16) | \
+                                (((uint32_t) (c)) <<  8) |   (uint32_t) (type))
+#define VENDOR_OUI_MASK  0xffffff00
+#define VENDOR_TYPE_MASK 0xffffffff
+
+typedef int (*vendor_decoder)(const uint8_t *,int,struct rid_fields *);
+
+struct vendor_ie {
+
+  uint32_t        key, mask;
+  uint8_t         format;
+  vendor_decoder  decode;
+  const char     *name;
+};
+
+extern const struct vendor_ie vendor_ies[];
+
+const struct vendor_ie *vendor_ie_find(const struct ie *);
+
+// Frames. Both return the number of RID IEs or packs decoded into fields,
+// which is cleared first. ssid may be NULL.
+
+int  rid_decode_beacon(const uint8_t *,int,struct rid_fields *,char *ssid);
+int  rid_decode_nan(const uint8_t *,int,struct rid_fields *);
+
+// Decoders.
+
+int  rid_decode_french(const uint8_t *,int,struct rid_fields *);
+int  rid_decode_odid(const uint8_t *,int,struct rid_fields *);
+int  rid_from_odid(ODID_UAS_Data *,struct rid_fields *);
+
+#endif
+
+/*
+ *
+ */
@@ -0,0 +1,128 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Received frame ring for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * A single producer, single consumer ring of preallocated slots. The
+ * promiscuous callback (the WiFi driver's task) claims a slot, copies the
+ * frame and the rx_ctrl bits that are wanted into it and publishes it.
+ * loop() takes the slots in order, decodes them and releases them. Head is
+ * only written by the producer and tail by the consumer, so there are no
+ * locks and nothing is allocated once the ring exists.
+ *
+ * If the ring is full the frame is dropped and counted, the producer never
+ * waits.
+ *
+ */
+
+#ifndef RX_RING_H
+#define RX_RING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#if !defined(RX_SLOTS)
+#define RX_SLOTS         16        // Power of 2.
+#endif
+
+#define RX_FRAME_SIZE   512        // Longer frames are truncated.
+
+#define RX_WIFI           1
+#define RX_BLE            2
+
+struct rx_slot {
+
+  uint8_t  type, channel;
+  int8_t   rssi;
+  uint16_t length;                 // Bytes in frame.
+  uint32_t msecs, rx_usecs;        // When received, millis() and the radio's timestamp.
+  uint8_t  mac[6];                 // BLE, the advertiser's address.
+  uint8_t  frame[RX_FRAME_SIZE];
+};
+
+struct rx_ring {
+
+  std::atomic<uint32_t> head, tail;
+  uint32_t              dropped, depth_max;
+  struct rx_slot        slots[RX_SLOTS];
+};
+
+inline void rx_ring_init(struct rx_ring *ring) {
+
+  ring->head.store(0);
+  ring->tail.store(0);
+
+  ring->dropped   =
+  ring->depth_max = 0;
+
+  return;
+}
+
+// Producer. Returns a slot to fill, NULL (and counts a drop) if the ring is full.
+
+inline struct rx_slot *rx_ring_claim(struct rx_ring *ring) {
+
+  uint32_t head;
+
+  head = ring->head.load(std::memory_order_relaxed);
+
+  if ((head - ring->tail.load(std::memory_order_acquire)) >= RX_SLOTS) {
+
+    ++ring->dropped;
+    return NULL;
+  }
+
+  return &ring->slots[head & (RX_SLOTS - 1)];
+}
+
+inline void rx_ring_publish(struct rx_ring *ring) {
+
+  uint32_t head, depth;
+
+  head  = ring->head.load(std::memory_order_relaxed) + 1;
+  depth = head - ring->tail.load(std::memory_order_relaxed);
+
+  if (depth > ring->depth_max) {
+
+    ring->depth_max = depth;
+  }
+
+  ring->head.store(head,std::memory_order_release);
+
+  return;
+}
+
+// Consumer. The oldest published slot, NULL if there isn't one.
+
+inline struct rx_slot *rx_ring_peek(struct rx_ring *ring) {
+
+  uint32_t tail;
+
+  tail = ring->tail.load(std::memory_order_relaxed);
+
+  if (tail == ring->head.load(std::memory_order_acquire)) {
+
+    return NULL;
+  }
+
+  return &ring->slots[tail & (RX_SLOTS - 1)];
+}
+
+inline void rx_ring_release(struct rx_ring *ring) {
+
+  ring->tail.store(ring->tail.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+
+  return;
+}
+
+#endif
+
+/*
+ *
+ */
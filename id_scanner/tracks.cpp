@@ -0,0 +1,483 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Track table index for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * Every track is always on the last seen list, the unused ones at the old
+ * end. A new track takes the oldest entry, which is either unused or the
+ * least recently seen track, so allocation and eviction are both O(1).
+ *
+ * A UAS ID is only indexed for one track. If a second transmitter (e.g. the
+ * BLE and WiFi MACs of the same UAV) turns up with an ID that is already
+ * indexed, frames carrying that ID go to the first track.
+ *
+ */
+
+#pragma GCC diagnostic warning "-Wunused-variable"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tracks.h"
+
+static int      hash_size_for(int);
+static size_t   table_array(size_t);
+static uint32_t hash_mac(const uint8_t *);
+static uint32_t hash_id(const char *);
+static int      mac_slot(struct track_table *,const uint8_t *);
+static int      id_slot(struct track_table *,const char *);
+static void     hash_delete(struct track_table *,int16_t *,int,int);
+static void     set_id(struct track_table *,int,const char *);
+static void     unindex(struct track_table *,int);
+static void     unlink_track(struct track_table *,int);
+static void     make_newest(struct track_table *,int);
+static void     make_oldest(struct track_table *,int);
+
+/*
+ *
+ */
+
+int hash_size_for(int capacity) {
+
+  int hash_size;
+
+  for (hash_size = 4; hash_size < (2 * capacity); hash_size <<= 1) {;}
+
+  return hash_size;
+}
+
+size_t table_array(size_t bytes) {
+
+  return (bytes + 7) & ~((size_t) 7);
+}
+
+size_t track_table_bytes(int capacity) {
+
+  if ((capacity < 1)||(capacity > TRACK_MAX)) {
+
+    return 0;
+  }
+
+  return table_array(capacity * sizeof(struct track_key)) +
+         2 * table_array(hash_size_for(capacity) * sizeof(int16_t)) +
+         2 * table_array(capacity * sizeof(int16_t));
+}
+
+//
+
+int track_table_init(struct track_table *table,int capacity,void *memory) {
+
+  int      i, hash_size;
+  uint8_t *p;
+
+  memset(table,0,sizeof(struct track_table));
+
+  table->newest =
+  table->oldest = TRACK_NONE;
+
+  if ((capacity < 1)||(capacity > TRACK_MAX)) {
+
+    return -1;
+  }
+
+  hash_size = hash_size_for(capacity);
+
+  if ((!memory)&&
+      (!(memory = table->allocated = malloc(track_table_bytes(capacity))))) {
+
+    return -1;
+  }
+
+  p               = (uint8_t *) memory;
+  table->keys     = (struct track_key *) p; p += table_array(capacity  * sizeof(struct track_key));
+  table->mac_hash = (int16_t *)          p; p += table_array(hash_size * sizeof(int16_t));
+  table->id_hash  = (int16_t *)          p; p += table_array(hash_size * sizeof(int16_t));
+  table->newer    = (int16_t *)          p; p += table_array(capacity  * sizeof(int16_t));
+  table->older    = (int16_t *)          p;
+
+  memset(table->keys,0,capacity * sizeof(struct track_key));
+
+  table->capacity  = capacity;
+  table->hash_size = hash_size;
+
+  for (i = 0; i < hash_size; ++i) {
+
+    table->mac_hash[i] =
+    table->id_hash[i]  = TRACK_NONE;
+  }
+
+  for (i = 0; i < capacity; ++i) {
+
+    make_newest(table,i);
+  }
+
+  return 0;
+}
+
+/*
+ *
+ */
+
+void track_table_free(struct track_table *table) {
+
+  free(table->allocated);
+
+  memset(table,0,sizeof(struct track_table));
+
+  table->newest =
+  table->oldest = TRACK_NONE;
+
+  return;
+}
+
+/*
+ * Returns the track for a transmitter, creating one (and evicting the least
+ * recently seen track if the table is full) if necessary. id may be NULL or
+ * empty if the frame didn't carry a UAS ID. *outcome, if not NULL, is set to
+ * TRACK_FOUND, TRACK_NEW or TRACK_EVICTED; for the last two the caller should
+ * reset whatever it keeps for the track.
+ */
+
+int track_find(struct track_table *table,const uint8_t *mac,const char *id,int *outcome) {
+
+  int               i, slot, found = TRACK_FOUND;
+  struct track_key *key;
+
+  if (!table->capacity) {
+
+    return TRACK_NONE;
+  }
+
+  ++table->stats.lookups;
+
+  if ((id)&&(!id[0])) {
+
+    id = NULL;
+  }
+
+  i = TRACK_NONE;
+
+  if (id) {
+
+    slot = id_slot(table,id);
+
+    if ((i = table->id_hash[slot]) != TRACK_NONE) {
+
+      key = &table->keys[i];
+
+      if ((memcmp(key->mac,mac,6))&&
+          (table->mac_hash[mac_slot(table,mac)] == TRACK_NONE)) {
+
+        // The UAV has changed its MAC.
+
+        hash_delete(table,table->mac_hash,mac_slot(table,key->mac),i);
+        memcpy(key->mac,mac,6);
+        key->mac_hash = hash_mac(mac);
+        table->mac_hash[mac_slot(table,mac)] = i;
+      }
+    }
+  }
+
+  if (i == TRACK_NONE) {
+
+    slot = mac_slot(table,mac);
+
+    if ((i = table->mac_hash[slot]) != TRACK_NONE) {
+
+      if ((id)&&(strncmp(table->keys[i].id,id,TRACK_ID_SIZE - 1))) {
+
+        set_id(table,i,id);
+      }
+
+    } else {
+
+      i     = table->oldest;
+      key   = &table->keys[i];
+      found = TRACK_NEW;
+
+      if (key->used) {
+
+        unindex(table,i);
+        slot  = TRACK_NONE;        // The deletion may have moved the run.
+        found = TRACK_EVICTED;
+        ++table->stats.evicted;
+      } else if (++table->stats.in_use > table->stats.high_water) {
+
+        table->stats.high_water = table->stats.in_use;
+      }
+
+      memset(key,0,sizeof(struct track_key));
+
+      key->used     = 1;
+      key->mac_hash = hash_mac(mac);
+      memcpy(key->mac,mac,6);
+      table->mac_hash[(slot == TRACK_NONE) ? mac_slot(table,mac): slot] = i;
+
+      if (id) {
+
+        set_id(table,i,id);
+      }
+
+      ++table->stats.created;
+    }
+  }
+
+  if (i != table->newest) {
+
+    unlink_track(table,i);
+    make_newest(table,i);
+  }
+
+  if (outcome) {
+
+    *outcome = found;
+  }
+
+  return i;
+}
+
+/*
+ *
+ */
+
+void track_remove(struct track_table *table,int i) {
+
+  if (!track_used(table,i)) {
+
+    return;
+  }
+
+  unindex(table,i);
+  memset(&table->keys[i],0,sizeof(struct track_key));
+
+  unlink_track(table,i);
+  make_oldest(table,i);
+
+  --table->stats.in_use;
+  ++table->stats.removed;
+
+  return;
+}
+
+/*
+ * FNV-1a, with a final mix as its low bits are weak for short keys.
+ */
+
+static inline uint32_t mix(uint32_t h) {
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bUL;
+  h ^= h >> 13;
+
+  return h;
+}
+
+uint32_t hash_mac(const uint8_t *mac) {
+
+  int      i;
+  uint32_t h = 2166136261UL;
+
+  for (i = 0; i < 6; ++i) {
+
+    h = (h ^ mac[i]) * 16777619UL;
+  }
+
+  return mix(h);
+}
+
+uint32_t hash_id(const char *id) {
+
+  int      i;
+  uint32_t h = 2166136261UL;
+
+  for (i = 0; (i < (TRACK_ID_SIZE - 1))&&(id[i]); ++i) {
+
+    h = (h ^ (uint8_t) id[i]) * 16777619UL;
+  }
+
+  return mix(h);
+}
+
+/*
+ * The slot holding the key, or the empty slot that ends its probe sequence.
+ */
+
+int mac_slot(struct track_table *table,const uint8_t *mac) {
+
+  int i, mask = table->hash_size - 1;
+
+  for (i = hash_mac(mac) & mask;
+       (table->mac_hash[i] != TRACK_NONE)&&(memcmp(table->keys[table->mac_hash[i]].mac,mac,6));
+       i = (i + 1) & mask) {
+
+    ++table->stats.probes;
+  }
+
+  return i;
+}
+
+int id_slot(struct track_table *table,const char *id) {
+
+  int i, mask = table->hash_size - 1;
+
+  for (i = hash_id(id) & mask;
+       (table->id_hash[i] != TRACK_NONE)&&(strncmp(table->keys[table->id_hash[i]].id,id,TRACK_ID_SIZE - 1));
+       i = (i + 1) & mask) {
+
+    ++table->stats.probes;
+  }
+
+  return i;
+}
+
+/*
+ * Removes track from slot, if it is there, and moves up any entries in the
+ * run after it that would otherwise be unreachable.
+ */
+
+void hash_delete(struct track_table *table,int16_t *hash,int slot,int track) {
+
+  int      j, mask = table->hash_size - 1;
+  uint32_t home;
+
+  if (hash[slot] != track) {
+
+    return;
+  }
+
+  for (j = slot;;) {
+
+    j = (j + 1) & mask;
+
+    if (hash[j] == TRACK_NONE) {
+
+      break;
+    }
+
+    home = ((hash == table->mac_hash) ? table->keys[hash[j]].mac_hash:
+                                        table->keys[hash[j]].id_hash) & mask;
+
+    // Can the entry at j move to slot? Not if its home lies cyclically in (slot,j].
+
+    if (((j > slot)&&((home <= (uint32_t) slot)||(home > (uint32_t) j)))||
+        ((j < slot)&&((home <= (uint32_t) slot)&&(home > (uint32_t) j)))) {
+
+      hash[slot] = hash[j];
+      slot       = j;
+    }
+  }
+
+  hash[slot] = TRACK_NONE;
+
+  return;
+}
+
+/*
+ *
+ */
+
+void set_id(struct track_table *table,int i,const char *id) {
+
+  int               slot;
+  struct track_key *key = &table->keys[i];
+
+  if (key->id[0]) {
+
+    hash_delete(table,table->id_hash,id_slot(table,key->id),i);
+  }
+
+  strncpy(key->id,id,TRACK_ID_SIZE - 1);
+  key->id[TRACK_ID_SIZE - 1] = 0;
+  key->id_hash = hash_id(key->id);
+
+  if (table->id_hash[slot = id_slot(table,key->id)] == TRACK_NONE) {
+
+    table->id_hash[slot] = i;
+  }
+
+  return;
+}
+
+void unindex(struct track_table *table,int i) {
+
+  struct track_key *key = &table->keys[i];
+
+  hash_delete(table,table->mac_hash,mac_slot(table,key->mac),i);
+
+  if (key->id[0]) {
+
+    hash_delete(table,table->id_hash,id_slot(table,key->id),i);
+  }
+
+  return;
+}
+
+/*
+ * The last seen list.
+ */
+
+void unlink_track(struct track_table *table,int i) {
+
+  if (table->newer[i] != TRACK_NONE) {
+
+    table->older[table->newer[i]] = table->older[i];
+  } else {
+
+    table->newest = table->older[i];
+  }
+
+  if (table->older[i] != TRACK_NONE) {
+
+    table->newer[table->older[i]] = table->newer[i];
+  } else {
+
+    table->oldest = table->newer[i];
+  }
+
+  return;
+}
+
+void make_newest(struct track_table *table,int i) {
+
+  table->newer[i] = TRACK_NONE;
+  table->older[i] = table->newest;
+
+  if (table->newest != TRACK_NONE) {
+
+    table->newer[table->newest] = i;
+  } else {
+
+    table->oldest = i;
+  }
+
+  table->newest = i;
+
+  return;
+}
+
+void make_oldest(struct track_table *table,int i) {
+
+  table->older[i] = TRACK_NONE;
+  table->newer[i] = table->oldest;
+
+  if (table->oldest != TRACK_NONE) {
+
+    table->older[table->oldest] = i;
+  } else {
+
+    table->newest = i;
+  }
+
+  table->oldest = i;
+
+  return;
+}
+
+/*
+ *
+ */
@@ -0,0 +1,78 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Track table index for the scanner.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * Maps a transmitter's MAC address, and the UAS ID once one has been
+ * received, to an index into the scanner's track arrays. Two open
+ * addressing hash tables (linear probing, backward shift deletion, so no
+ * tombstones) give O(1) lookups. The tracks are kept on a list in the order
+ * in which they were last seen, so that a full table evicts the track that
+ * has been quiet for longest.
+ *
+ * The table is sized at init, there is no allocation after that. It can be
+ * given memory, track_table_bytes() for the capacity, so that it goes in the
+ * same block as the rest of the tracks, otherwise it mallocs one. Nothing
+ * here needs Arduino, so that it can be built on a host for benchmarking.
+ *
+ */
+
+#ifndef TRACKS_H
+#define TRACKS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRACK_ID_SIZE    21        // ODID_ID_SIZE + 1
+#define TRACK_NONE       -1
+#define TRACK_MAX     16383
+
+#define TRACK_FOUND       0        // track_find() outcomes.
+#define TRACK_NEW         1
+#define TRACK_EVICTED     2
+
+struct track_key {
+
+  uint8_t  used, mac[6];
+  char     id[TRACK_ID_SIZE];
+  uint32_t mac_hash, id_hash;      // Kept for moving entries when one is deleted.
+};
+
+struct track_stats {
+
+  uint32_t lookups, probes, created, evicted, removed;
+  uint16_t in_use, high_water;
+};
+
+struct track_table {
+
+  int                 capacity, hash_size;  // hash_size, a power of 2, at least twice capacity.
+  int                 newest, oldest;       // The last seen list.
+  int16_t            *mac_hash, *id_hash;   // Track indices, TRACK_NONE for empty.
+  int16_t            *newer, *older;
+  struct track_key   *keys;
+  void               *allocated;            // If init malloced the memory.
+  struct track_stats  stats;
+};
+
+size_t track_table_bytes(int);
+int  track_table_init(struct track_table *,int,void * = NULL);  // Memory 8 byte aligned.
+void track_table_free(struct track_table *);
+int  track_find(struct track_table *,const uint8_t *,const char *,int *);
+void track_remove(struct track_table *,int);
+
+inline int track_used(const struct track_table *table,int index) {
+
+  return ((index >= 0)&&(index < table->capacity)) ? table->keys[index].used: 0;
+}
+
+#endif
+
+/*
+ *
+ */
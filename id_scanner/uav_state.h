@@ -0,0 +1,130 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * Track state for the scanner, as a structure of arrays.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * loop() looks at every track on every pass, for the expiry and the flag
+ * that says that there is something new to print. With one struct per
+ * track that pulled the whole struct (doubles, strings) through the cache
+ * for the sake of eight bytes. Here each field is its own array, so that
+ * scan reads last_seen[] and flag[], a few cache lines, and only the
+ * flagged tracks go on to their positions.
+ *
+ * Positions are int32 in 1e-7 degrees, as ODID sends them, and the
+ * altitudes, speed and heading are int16, in metres, m/s and degrees. The
+ * MAC is the track table's key and the strings are in a separate pool.
+ *
+ * The arrays are carved from one block given to uav_state_init(), at
+ * uav_state_bytes() for the count. Each is padded to a multiple of 8 bytes,
+ * so flag[] can be read 8 at a time.
+ *
+ */
+
+#ifndef UAV_STATE_H
+#define UAV_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define UAV_DEG_E7     1.0e7
+
+struct uav_state {
+
+  int        count;
+  // Hot, every pass of loop().
+  uint32_t  *last_seen;
+  uint8_t   *flag;
+  // Warm, when a track is flagged or displayed.
+  int32_t   *lat, *lon, *base_lat, *base_lon;
+  int16_t   *altitude_msl, *height_agl, *speed, *heading;
+  int8_t    *rssi;
+};
+
+inline size_t uav_state_array(size_t bytes) {
+
+  return (bytes + 7) & ~((size_t) 7);
+}
+
+inline size_t uav_state_bytes(int count) {
+
+  return uav_state_array(count * sizeof(uint32_t)) +
+         uav_state_array(count * sizeof(uint8_t))  +
+         4 * uav_state_array(count * sizeof(int32_t)) +
+         4 * uav_state_array(count * sizeof(int16_t)) +
+         uav_state_array(count * sizeof(int8_t));
+}
+
+// memory must be at least uav_state_bytes(count), zeroed and 8 byte aligned.
+
+inline void uav_state_init(struct uav_state *uavs,void *memory,int count) {
+
+  uint8_t *p = (uint8_t *) memory;
+
+  uavs->count        = count;
+
+  uavs->last_seen    = (uint32_t *) p; p += uav_state_array(count * sizeof(uint32_t));
+  uavs->flag         = (uint8_t *)  p; p += uav_state_array(count * sizeof(uint8_t));
+  uavs->lat          = (int32_t *)  p; p += uav_state_array(count * sizeof(int32_t));
+  uavs->lon          = (int32_t *)  p; p += uav_state_array(count * sizeof(int32_t));
+  uavs->base_lat     = (int32_t *)  p; p += uav_state_array(count * sizeof(int32_t));
+  uavs->base_lon     = (int32_t *)  p; p += uav_state_array(count * sizeof(int32_t));
+  uavs->altitude_msl = (int16_t *)  p; p += uav_state_array(count * sizeof(int16_t));
+  uavs->height_agl   = (int16_t *)  p; p += uav_state_array(count * sizeof(int16_t));
+  uavs->speed        = (int16_t *)  p; p += uav_state_array(count * sizeof(int16_t));
+  uavs->heading      = (int16_t *)  p; p += uav_state_array(count * sizeof(int16_t));
+  uavs->rssi         = (int8_t *)   p;
+
+  return;
+}
+
+inline void uav_state_clear(struct uav_state *uavs,int i) {
+
+  uavs->last_seen[i]    = 0;
+  uavs->flag[i]         = 0;
+  uavs->lat[i]          =
+  uavs->lon[i]          =
+  uavs->base_lat[i]     =
+  uavs->base_lon[i]     = 0;
+  uavs->altitude_msl[i] =
+  uavs->height_agl[i]   =
+  uavs->speed[i]        =
+  uavs->heading[i]      = 0;
+  uavs->rssi[i]         = 0;
+
+  return;
+}
+
+// Conversions.
+
+inline int32_t uav_e7(double degrees) {
+
+  if (fabs(degrees) > 214.0) {        // Out of range for any use, and int32.
+
+    degrees = (degrees > 0.0) ? 214.0: -214.0;
+  }
+
+  return (int32_t) lround(degrees * UAV_DEG_E7);
+}
+
+inline double uav_deg(int32_t e7) {
+
+  return (double) e7 / UAV_DEG_E7;
+}
+
+inline int16_t uav_i16(double value) {
+
+  return (value > 32767.0) ? 32767: (value < -32768.0) ? -32768: (int16_t) value;
+}
+
+#endif
+
+/*
+ *
+ */
@@ -0,0 +1,143 @@
+/* -*- tab-width: 2; mode: c; -*-
+ *
+ * WiFi information elements built at compile time.
+ *
+ * Copyright (c) 2026, Steve Jack.
+ *
+ * MIT licence.
+ *
+ * NOTES
+ *
+ * An IE is a WiFi_bytes<> type holding its bytes as a constexpr array. The
+ * length byte is counted by the compiler, so it can't disagree with the
+ * data, and WiFi_cat<> joins a list of IEs into one array that can be
+ * memcpy()'d into a frame, e.g.
+ *
+ *   typedef WiFi_cat<WiFi_IE_DS<6>,WiFi_IE_TIM>::type ies;
+ *
+ *   offset = ies::copy(frame,offset);
+ *
+ * C++11, for the ESP8266's compiler.
+ *
+ */
+
+#ifndef WIFI_IE_H
+#define WIFI_IE_H
+
+#include <stdint.h>
+#include <string.h>
+
+template <uint8_t... B> struct WiFi_bytes {
+
+  static constexpr int     size = sizeof...(B);
+  static constexpr uint8_t bytes[(sizeof...(B)) ? sizeof...(B): 1] = {B...};
+
+  // Returns the offset after the bytes.
+
+  static int copy(uint8_t *frame,int offset) {
+
+    memcpy(&frame[offset],bytes,size);
+
+    return offset + size;
+  }
+};
+
+template <uint8_t... B> constexpr int     WiFi_bytes<B...>::size;
+template <uint8_t... B> constexpr uint8_t WiFi_bytes<B...>::bytes[];
+
+// Concatenation.
+
+template <class... L> struct WiFi_cat;
+
+template <> struct WiFi_cat<> {
+
+  typedef WiFi_bytes<> type;
+};
+
+template <uint8_t... A> struct WiFi_cat<WiFi_bytes<A...>> {
+
+  typedef WiFi_bytes<A...> type;
+};
+
+template <uint8_t... A,uint8_t... B,class... L> struct WiFi_cat<WiFi_bytes<A...>,WiFi_bytes<B...>,L...> {
+
+  typedef typename WiFi_cat<WiFi_bytes<A...,B...>,L...>::type type;
+};
+
+// An IE, element ID, length and data.
+
+template <uint8_t ID,uint8_t... B> struct WiFi_IE_t {
+
+  static_assert(sizeof...(B) <= 255,"IE longer than 255 bytes");
+
+  typedef WiFi_bytes<ID,(uint8_t) sizeof...(B),B...> type;
+};
+
+template <uint8_t ID,uint8_t... B> using WiFi_IE = typename WiFi_IE_t<ID,B...>::type;
+
+// Rates in 500 kbit/s, 0x80 set for a basic rate.
+
+template <uint8_t... R> struct WiFi_IE_rates_t {
+
+  static_assert(sizeof...(R) <= 8,"More than 8 rates, the rest go in the extended rates IE");
+
+  typedef WiFi_IE<0x01,R...> type;
+};
+
+template <uint8_t... R> using WiFi_IE_rates     = typename WiFi_IE_rates_t<R...>::type;
+template <uint8_t... R> using WiFi_IE_ext_rates = WiFi_IE<0x32,R...>;
+
+// DS parameter set, TIM (DTIM count 0, period 2, no bitmap) and country
+// (any environment, channels 1 to n).
+
+template <uint8_t CHANNEL> using WiFi_IE_DS = WiFi_IE<0x03,CHANNEL>;
+
+typedef WiFi_IE<0x05,0x00,0x02,0x00,0x00> WiFi_IE_TIM;
+
+template <char C0,char C1,uint8_t CHANNELS,uint8_t MAX_DBM>
+using WiFi_IE_country = WiFi_IE<0x07,(uint8_t) C0,(uint8_t) C1,0x20,0x01,CHANNELS,MAX_DBM>;
+
+// Vendor specific.
+
+template <uint32_t OUI,uint8_t TYPE,uint8_t... B>
+using WiFi_IE_vendor = WiFi_IE<0xdd,(uint8_t) (OUI >> 16),(uint8_t) (OUI >> 8),(uint8_t) OUI,TYPE,B...>;
+
+// The start of a vendor IE whose data is filled in at run time.
+
+template <uint8_t LENGTH,uint32_t OUI,uint8_t TYPE>
+using WiFi_IE_vendor_head = WiFi_bytes<0xdd,LENGTH,(uint8_t) (OUI >> 16),(uint8_t) (OUI >> 8),(uint8_t) OUI,TYPE>;
+
+// Some that have been tried in beacons and left out.
+
+typedef WiFi_IE<0x20,0x00>      WiFi_IE_power_constraint;
+typedef WiFi_IE<0x23,0x11,0x00> WiFi_IE_TPC_report;
+typedef WiFi_IE<0x2a,0x00>      WiFi_IE_ERP;
+
+typedef WiFi_IE_vendor<0x0050f2,0x01,                  // Microsoft WPA
+                       0x01,0x00,                      // version
+                       0x00,0x50,0xf2,0x02,            // group cipher
+                       0x02,0x00,                      // pairwise ciphers
+                       0x00,0x50,0xf2,0x04,
+                       0x00,0x50,0xf2,0x02,
+                       0x01,0x00,                      // AKM suites
+                       0x00,0x50,0xf2,0x02> WiFi_IE_WPA;
+
+// The lowest basic rate in a rates IE, 0x7f if there isn't one.
+
+constexpr uint8_t wifi_lowest_basic_rate(const uint8_t *rates,int n,uint8_t lowest) {
+
+  return (n <= 0) ? lowest:
+         wifi_lowest_basic_rate(rates + 1,n - 1,
+                                ((rates[0] & 0x80)&&((rates[0] & 0x7f) < lowest)) ? rates[0] & 0x7f: lowest);
+}
+
+template <class IE> constexpr uint8_t wifi_lowest_basic_rate() {
+
+  return (IE::size > 2) ? wifi_lowest_basic_rate(IE::bytes + 2,IE::size - 2,0x7f): 0x7f;
+}
+
+#endif
+
+/*
+ *
+ */